@@ -45,9 +45,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
 #include <pthread.h>
 #include <signal.h>
 #include <sys/time.h>
+#include <sys/mman.h>
+#include <time.h>
 
 #include "system.h"
 
@@ -60,6 +64,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //------------------------------------------------------------------------------
 #define SET_CPU_AFFINITY
 #define MAIN_THREAD_PRIORITY            20
+#define PCI_DEVICE_DIR                  "/sys/bus/pci/devices"
 
 //------------------------------------------------------------------------------
 // module global vars
@@ -100,7 +105,12 @@ static tSyncThreadInstance      syncThreadInstance_l;
 //------------------------------------------------------------------------------
 // local function prototypes
 //------------------------------------------------------------------------------
+static void registerTermSignals(void);
 static void handleTermSignal(int signum);
+static int  readPciId(const char* pszDevice_p, const char* pszFile_p);
+static volatile UINT32* mapPciMemory(UINT16 vendorId_p, UINT16 deviceId_p, UINT bar_p,
+                                     size_t offset_p, size_t size_p, BOOL fWrite_p,
+                                     void** ppMap_p, size_t* pMapSize_p);
 
 #if defined(CONFIG_USE_SYNCTHREAD)
 static void* powerlinkSyncThread(void* arg);
@@ -139,16 +149,7 @@ int system_init(void)
                               __func__, schedParam.sched_priority);
     }
 
-    // Register termination handler for signals with termination semantics
-    struct sigaction new_action;
-
-    new_action.sa_handler = handleTermSignal;
-    (void)sigemptyset(&new_action.sa_mask);
-    new_action.sa_flags = 0;
-
-    (void)sigaction(SIGINT,  &new_action, NULL);    // Sent via CTRL-C
-    (void)sigaction(SIGTERM, &new_action, NULL);    // Generic signal used to cause program termination.
-    (void)sigaction(SIGQUIT, &new_action, NULL);    // Terminate because of abnormal condition
+    registerTermSignals();
 
 #ifdef SET_CPU_AFFINITY
     {
@@ -164,6 +165,29 @@ int system_init(void)
     return 0;
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Initialize system for service tools
+
+The function initializes the system for tools which only use the service
+interface of the kernel stack, e.g. for a firmware update. In contrast to
+system_init() the scheduling policy, priority and CPU affinity of the process
+are not changed, thus the tool does not compete with a running control
+application.
+
+\return The function returns 0 if the initialization has been successful,
+        otherwise -1.
+
+\ingroup module_app_common
+*/
+//------------------------------------------------------------------------------
+int system_initService(void)
+{
+    registerTermSignals();
+
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 /**
 \brief  Shutdown system
@@ -240,6 +264,112 @@ void system_msleep(unsigned int milliSeconds_p)
     }
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief Get monotonic time
+
+The function returns the time of a monotonic clock. It is used to measure
+durations, the start of the clock is undefined.
+
+\return The function returns the time in microseconds.
+
+\ingroup module_app_common
+*/
+//------------------------------------------------------------------------------
+UINT64 system_getTimeUs(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return ((UINT64)now.tv_sec * 1000000U) + ((UINT64)now.tv_nsec / 1000U);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read PCI device memory
+
+The function reads memory of the first PCI device with the given IDs through
+the resource file of the BAR in sysfs. The memory is read in 32 bit words,
+thus offset and size must be multiples of 4. Root permissions are required.
+
+\param  vendorId_p          PCI vendor ID of the device
+\param  deviceId_p          PCI device ID of the device
+\param  bar_p               BAR to read from
+\param  offset_p            Offset in the BAR
+\param  pData_p             Pointer to store the read data
+\param  size_p              Number of bytes to read
+
+\return The function returns 0 if the memory has been read, otherwise -1.
+
+\ingroup module_app_common
+*/
+//------------------------------------------------------------------------------
+int system_readPciMemory(UINT16 vendorId_p, UINT16 deviceId_p, UINT bar_p,
+                         size_t offset_p, void* pData_p, size_t size_p)
+{
+    void*               pMap;
+    size_t              mapSize;
+    volatile UINT32*    pSrc;
+    UINT32*             pDst = (UINT32*)pData_p;
+    size_t              i;
+
+    pSrc = mapPciMemory(vendorId_p, deviceId_p, bar_p, offset_p, size_p, FALSE,
+                        &pMap, &mapSize);
+    if (pSrc == NULL)
+        return -1;
+
+    // The BAR is read word by word, PCIe memory must not be read by memcpy()
+    for (i = 0; i < (size_p / sizeof(UINT32)); i++)
+        pDst[i] = pSrc[i];
+
+    munmap(pMap, mapSize);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write PCI device memory
+
+The function writes memory of the first PCI device with the given IDs through
+the resource file of the BAR in sysfs. The memory is written in 32 bit words,
+thus offset and size must be multiples of 4. Root permissions are required.
+
+\param  vendorId_p          PCI vendor ID of the device
+\param  deviceId_p          PCI device ID of the device
+\param  bar_p               BAR to write to
+\param  offset_p            Offset in the BAR
+\param  pData_p             Pointer to the data to write
+\param  size_p              Number of bytes to write
+
+\return The function returns 0 if the memory has been written, otherwise -1.
+
+\ingroup module_app_common
+*/
+//------------------------------------------------------------------------------
+int system_writePciMemory(UINT16 vendorId_p, UINT16 deviceId_p, UINT bar_p,
+                          size_t offset_p, const void* pData_p, size_t size_p)
+{
+    void*               pMap;
+    size_t              mapSize;
+    volatile UINT32*    pDst;
+    const UINT32*       pSrc = (const UINT32*)pData_p;
+    size_t              i;
+
+    pDst = mapPciMemory(vendorId_p, deviceId_p, bar_p, offset_p, size_p, TRUE,
+                        &pMap, &mapSize);
+    if (pDst == NULL)
+        return -1;
+
+    for (i = 0; i < (size_p / sizeof(UINT32)); i++)
+        pDst[i] = pSrc[i];
+
+    munmap(pMap, mapSize);
+
+    return 0;
+}
+
 #if defined(CONFIG_USE_SYNCTHREAD)
 //------------------------------------------------------------------------------
 /**
@@ -293,6 +423,27 @@ void system_stopSyncThread(void)
 /// \name Private Functions
 /// \{
 
+//------------------------------------------------------------------------------
+/**
+\brief  Register termination handler
+
+The function registers the termination handler for signals with termination
+semantics.
+*/
+//------------------------------------------------------------------------------
+static void registerTermSignals(void)
+{
+    struct sigaction new_action;
+
+    new_action.sa_handler = handleTermSignal;
+    (void)sigemptyset(&new_action.sa_mask);
+    new_action.sa_flags = 0;
+
+    (void)sigaction(SIGINT,  &new_action, NULL);    // Sent via CTRL-C
+    (void)sigaction(SIGTERM, &new_action, NULL);    // Generic signal used to cause program termination.
+    (void)sigaction(SIGQUIT, &new_action, NULL);    // Terminate because of abnormal condition
+}
+
 //------------------------------------------------------------------------------
 /**
 \brief  Handle termination requests
@@ -317,6 +468,108 @@ static void handleTermSignal(int signum)
     }
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Read PCI ID
+
+The function reads an ID file of a PCI device in sysfs.
+
+\param  pszDevice_p         Name of the device directory
+\param  pszFile_p           Name of the ID file
+
+\return The function returns the ID or -1 if it cannot be read.
+*/
+//------------------------------------------------------------------------------
+static int readPciId(const char* pszDevice_p, const char* pszFile_p)
+{
+    FILE*           pFile;
+    char            szPath[512];
+    unsigned int    id;
+    int             ret = -1;
+
+    snprintf(szPath, sizeof(szPath), PCI_DEVICE_DIR "/%s/%s", pszDevice_p, pszFile_p);
+
+    pFile = fopen(szPath, "r");
+    if (pFile == NULL)
+        return -1;
+
+    if (fscanf(pFile, "%x", &id) == 1)
+        ret = (int)id;
+
+    fclose(pFile);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Map PCI device memory
+
+The function maps memory of the first PCI device with the given IDs through
+the resource file of the BAR in sysfs.
+
+\param  vendorId_p          PCI vendor ID of the device
+\param  deviceId_p          PCI device ID of the device
+\param  bar_p               BAR to map
+\param  offset_p            Offset in the BAR, multiple of 4
+\param  size_p              Number of bytes to map, multiple of 4
+\param  fWrite_p            Map for writing
+\param  ppMap_p             Pointer to store the mapping to be passed to munmap()
+\param  pMapSize_p          Pointer to store the size of the mapping
+
+\return The function returns the address of offset_p in the mapping, or NULL
+        if the memory could not be mapped.
+*/
+//------------------------------------------------------------------------------
+static volatile UINT32* mapPciMemory(UINT16 vendorId_p, UINT16 deviceId_p, UINT bar_p,
+                                     size_t offset_p, size_t size_p, BOOL fWrite_p,
+                                     void** ppMap_p, size_t* pMapSize_p)
+{
+    DIR*                pDir;
+    struct dirent*      pEntry;
+    char                szPath[512];
+    int                 fd = -1;
+    size_t              pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t              mapOffset = offset_p & ~(pageSize - 1);
+    size_t              mapSize = (offset_p - mapOffset) + size_p;
+    void*               pMap;
+
+    if (((offset_p | size_p) & (sizeof(UINT32) - 1)) != 0)
+        return NULL;
+
+    pDir = opendir(PCI_DEVICE_DIR);
+    if (pDir == NULL)
+        return NULL;
+
+    while ((pEntry = readdir(pDir)) != NULL)
+    {
+        if ((readPciId(pEntry->d_name, "vendor") != vendorId_p) ||
+            (readPciId(pEntry->d_name, "device") != deviceId_p))
+            continue;
+
+        snprintf(szPath, sizeof(szPath), PCI_DEVICE_DIR "/%s/resource%u", pEntry->d_name, bar_p);
+        fd = open(szPath, (fWrite_p ? O_RDWR : O_RDONLY) | O_SYNC);
+        break;
+    }
+
+    closedir(pDir);
+
+    if (fd < 0)
+        return NULL;
+
+    pMap = mmap(NULL, mapSize, fWrite_p ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED,
+                fd, (off_t)mapOffset);
+    close(fd);
+
+    if (pMap == MAP_FAILED)
+        return NULL;
+
+    *ppMap_p = pMap;
+    *pMapSize_p = mapSize;
+
+    return (volatile UINT32*)((UINT8*)pMap + (offset_p - mapOffset));
+}
+
 #if defined(CONFIG_USE_SYNCTHREAD)
 //------------------------------------------------------------------------------
 /**
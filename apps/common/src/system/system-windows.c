@@ -135,6 +135,30 @@ int system_init(void)
     return 0;
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Initialize system for service tools
+
+The function initializes the system for tools which only use the service
+interface of the kernel stack, e.g. for a firmware update. In contrast to
+system_init() the priority class of the process is not changed, thus the tool
+does not compete with a running control application.
+
+\return The function returns 0 if the initialization has been successful,
+        otherwise -1.
+
+\ingroup module_app_common
+*/
+//------------------------------------------------------------------------------
+int system_initService(void)
+{
+#if defined(CONFIG_USE_SYNCTHREAD)
+    syncThreadInstance_l.fThreadExit = FALSE;
+#endif
+
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 /**
 \brief  Shutdown system
@@ -183,6 +207,96 @@ void system_msleep(unsigned int milliSeconds_p)
     Sleep(milliSeconds_p);
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief Get monotonic time
+
+The function returns the time of the performance counter. It is used to
+measure durations, the start of the counter is undefined.
+
+\return The function returns the time in microseconds.
+
+\ingroup module_app_common
+*/
+//------------------------------------------------------------------------------
+UINT64 system_getTimeUs(void)
+{
+    LARGE_INTEGER   frequency;
+    LARGE_INTEGER   counter;
+
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+
+    return ((UINT64)(counter.QuadPart / frequency.QuadPart) * 1000000U) +
+           (((UINT64)(counter.QuadPart % frequency.QuadPart) * 1000000U) /
+            (UINT64)frequency.QuadPart);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read PCI device memory
+
+The function reads memory of a PCI device. On Windows, the device is owned by
+the NDIS driver which does not map its BARs to applications, thus this function
+is only implemented as a stub.
+
+\param  vendorId_p          PCI vendor ID of the device
+\param  deviceId_p          PCI device ID of the device
+\param  bar_p               BAR to read from
+\param  offset_p            Offset in the BAR
+\param  pData_p             Pointer to store the read data
+\param  size_p              Number of bytes to read
+
+\return The function always returns -1.
+
+\ingroup module_app_common
+*/
+//------------------------------------------------------------------------------
+int system_readPciMemory(UINT16 vendorId_p, UINT16 deviceId_p, UINT bar_p,
+                         size_t offset_p, void* pData_p, size_t size_p)
+{
+    UNUSED_PARAMETER(vendorId_p);
+    UNUSED_PARAMETER(deviceId_p);
+    UNUSED_PARAMETER(bar_p);
+    UNUSED_PARAMETER(offset_p);
+    UNUSED_PARAMETER(pData_p);
+    UNUSED_PARAMETER(size_p);
+
+    return -1;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write PCI device memory
+
+The function writes memory of a PCI device. Like system_readPciMemory(), it is
+only implemented as a stub on Windows.
+
+\param  vendorId_p          PCI vendor ID of the device
+\param  deviceId_p          PCI device ID of the device
+\param  bar_p               BAR to write to
+\param  offset_p            Offset in the BAR
+\param  pData_p             Pointer to the data to write
+\param  size_p              Number of bytes to write
+
+\return The function always returns -1.
+
+\ingroup module_app_common
+*/
+//------------------------------------------------------------------------------
+int system_writePciMemory(UINT16 vendorId_p, UINT16 deviceId_p, UINT bar_p,
+                          size_t offset_p, const void* pData_p, size_t size_p)
+{
+    UNUSED_PARAMETER(vendorId_p);
+    UNUSED_PARAMETER(deviceId_p);
+    UNUSED_PARAMETER(bar_p);
+    UNUSED_PARAMETER(offset_p);
+    UNUSED_PARAMETER(pData_p);
+    UNUSED_PARAMETER(size_p);
+
+    return -1;
+}
+
 #if defined(CONFIG_USE_SYNCTHREAD)
 //------------------------------------------------------------------------------
 /**
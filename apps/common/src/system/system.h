@@ -63,9 +63,15 @@ extern "C"
 #endif
 
 int  system_init(void);
+int  system_initService(void);
 void system_exit(void);
 BOOL system_getTermSignalState();
 void system_msleep(unsigned int milliSeconds_p);
+UINT64 system_getTimeUs(void);
+int  system_readPciMemory(UINT16 vendorId_p, UINT16 deviceId_p, UINT bar_p,
+                          size_t offset_p, void* pData_p, size_t size_p);
+int  system_writePciMemory(UINT16 vendorId_p, UINT16 deviceId_p, UINT bar_p,
+                           size_t offset_p, const void* pData_p, size_t size_p);
 
 #if defined(CONFIG_USE_SYNCTHREAD)
 void system_startSyncThread(tSyncCb pfnSync_p);
@@ -34,6 +34,9 @@
 
 ADD_DEFINITIONS(-D_GNU_SOURCE -D_POSIX_C_SOURCE=200112L)
 
+SET(CFG_FIRMWARE_TUNING_FILE "/etc/firmware_update.tune" CACHE STRING
+    "File of tuned chunk sizes per card")
+
 ################################################################################
 # Set architecture specific sources and include directories
 
@@ -50,6 +50,11 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <system/system.h>
 #include <getopt/getopt.h>
 #include <console/console.h>
+#include <fwcompress/fwcompress.h>
+#include <fwdelta/fwdelta.h>
+#include <fwimage/fwimage.h>
+#include <pcpstatus/pcpstatus.h>
+#include <crc32/crc32.h>
 
 //============================================================================//
 //            G L O B A L   D E F I N I T I O N S                             //
@@ -75,6 +80,18 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // const defines
 //------------------------------------------------------------------------------
 #define FIRMWARE_HEADER_SIZE        32
+#define FIRMWARE_CHUNK_RETRIES      3       ///< Retransmissions of a damaged file chunk
+#define FIRMWARE_BUSY_POLL_MS       2       ///< Interval of resends while the card programs flash
+#define FIRMWARE_BUSY_TIMEOUT_MS    10000   ///< Time a file chunk may be rejected as busy
+#define FIRMWARE_READY_TIMEOUT_MS   60000   ///< Time to wait for the card after reconfiguration
+#define FIRMWARE_READY_POLL_MS      100     ///< Interval of ready checks after reconfiguration
+#define FIRMWARE_STATE_POLL_MS      10      ///< Interval of kernel stack state checks
+#ifndef FIRMWARE_TUNING_FILE
+#define FIRMWARE_TUNING_FILE        "/etc/firmware_update.tune" ///< Tuned chunk sizes per card
+#endif
+
+#define FIRMWARE_TUNING_PROBE_SIZE  (128 * 1024) ///< Bytes transferred per probed chunk size
+#define FIRMWARE_TUNING_MIN_CHUNK   1024    ///< Smallest probed chunk size
 
 //------------------------------------------------------------------------------
 // local types
@@ -86,19 +103,127 @@ typedef struct
     BOOL    fInvalidateUpdateImage;
     BOOL    fFactoryReset;
     BOOL    fUpdateReset;
+    BOOL    fCompress;
+    BOOL    fApplicationOnly;
+    BOOL    fChunkCrc;
+    BOOL    fWaitReady;
+    BOOL    fTuneChunkSize;
+    BOOL    fPrintStatus;
+    UINT    rateLimit;
+    char    reportFile[256];
+    char    tuningFile[256];
 } tOptions;
 
+/**
+\brief Update phases
+
+The enum lists the phases of a firmware update which are timed for the report.
+*/
+typedef enum
+{
+    kUpdatePhaseAttach      = 0,    ///< Attach to the kernel stack and read the stack info
+    kUpdatePhaseLoad        = 1,    ///< Read the image file
+    kUpdatePhaseCheck       = 2,    ///< Check header and CRC of the image
+    kUpdatePhasePrepare     = 3,    ///< Compress, create section stream or find resume offset
+    kUpdatePhaseTransfer    = 4,    ///< Write file chunks (includes programming on the card)
+    kUpdatePhaseReconfig    = 5,    ///< Reconfiguration command (includes image check on the card)
+    kUpdatePhaseReady       = 6,    ///< Card ready again after reconfiguration
+    kUpdatePhaseCount       = 7,
+} eUpdatePhase;
+
+/**
+\brief Update report
+
+The struct collects the telemetry of a firmware update. It is printed as
+summary and written as JSON report.
+*/
+typedef struct
+{
+    UINT64      aPhaseTime[kUpdatePhaseCount];  ///< Duration per phase [us]
+    UINT32      validMask;                      ///< Measured phases (bit per phase)
+    const char* pszMode;                        ///< Download mode
+    size_t      imageSize;                      ///< Size of the image file
+    size_t      transferSize;                   ///< Bytes transferred in file chunks
+    UINT        resumeOffset;                   ///< Offset of a resumed download
+    size_t      chunkSize;                      ///< Data size per file chunk
+    UINT        chunkCount;                     ///< Number of transferred file chunks
+    UINT        retryCount;                     ///< Number of retransmitted file chunks
+    UINT        busyCount;                      ///< Number of file chunks rejected as busy
+    UINT        rateLimit;                      ///< Transfer rate limit [KB/s], 0 if unlimited
+    UINT32*     pRtt;                           ///< Round trip time per chunk write [us]
+    UINT        rttCount;                       ///< Number of round trip times
+    UINT        rttSize;                        ///< Size of the round trip time array
+    tPcpStatusFlash flash;                      ///< Flash statistics of the card
+    BOOL        fFlashValid;                    ///< Flash statistics belong to the transfer
+    tOplkError  result;                         ///< Result of the update
+} tUpdateReport;
+
 //------------------------------------------------------------------------------
 // local vars
 //------------------------------------------------------------------------------
+static BOOL fChunkTrailer_l = FALSE;
+static size_t tunedChunkSize_l = 0;
+static UINT rateLimit_l = 0;
+static const char* pszTuningFile_l = FIRMWARE_TUNING_FILE;
+static tUpdateReport report_l;
+
+static const char* const aUpdatePhaseName_l[kUpdatePhaseCount] =
+{
+    "attach",
+    "load",
+    "check",
+    "prepare",
+    "transfer",
+    "reconfig",
+    "ready",
+};
+
+static const char* const aBootPhaseName_l[kPcpStatusBootPhaseCount] =
+{
+    "main",
+    "flash_init",
+    "firmware_init",
+    "image check",
+    "prodtest_init",
+    "stack init",
+};
 
 //------------------------------------------------------------------------------
 // local function prototypes
 //------------------------------------------------------------------------------
 static int          getOptions(int argc_p, char** argv_p, tOptions* pOpts_p);
 static tOplkError   invalidateImage(void);
-static tOplkError   updateImage(char* pszFirmwareFile_p);
-static tOplkError   writeImageToKernel(UINT8* pImage_p, UINT length_p);
+static tOplkError   updateImage(char* pszFirmwareFile_p, BOOL fCompress_p,
+                                BOOL fApplicationOnly_p);
+static tOplkError   checkImage(const UINT8* pImage_p, size_t imageSize_p);
+static UINT8*       createSectionUpdate(const UINT8* pImage_p, size_t imageSize_p,
+                                        UINT32 sectionIndex_p, size_t* pStreamSize_p);
+static UINT         findResumeOffset(const UINT8* pImage_p, UINT length_p);
+static tOplkError   writeResumeRequest(const UINT8* pImage_p, UINT offset_p);
+static tOplkError   writeImageToKernel(UINT8* pImage_p, UINT length_p, UINT offset_p);
+static size_t       getChunkDataSize(void);
+static void         limitRate(UINT64 startTime_p, UINT64 length_p);
+static tOplkError   tuneChunkSize(const tOplkApiStackInfo* pStackInfo_p);
+static size_t       loadChunkSize(const tOplkApiStackInfo* pStackInfo_p);
+static int          saveChunkSize(const tOplkApiStackInfo* pStackInfo_p, size_t chunkSize_p,
+                                  UINT throughput_p);
+static tOplkError   waitForReady(void);
+static void         acknowledgeDetach(void);
+static int          readCardStatus(tPcpStatus* pStatus_p);
+static void         printBootTimeline(void);
+static void         printLoopStatistics(void);
+static void         printMempoolStatistics(void);
+static UINT32       readFlashTransferCount(void);
+static void         readFlashStatistics(UINT32 transferCount_p);
+static UINT32       readFlashErrorCount(void);
+static void         printFlashError(UINT32 errorCount_p);
+static void         printTimingModel(FILE* pFile_p);
+static void         recordPhase(eUpdatePhase phase_p, UINT64 startTime_p);
+static void         addRtt(UINT32 rtt_p);
+static void         printTransferSummary(void);
+static int          writeReport(const char* pszFile_p, const char* pszFirmwareFile_p);
+static void         writeJsonString(FILE* pFile_p, const char* pszString_p);
+static int          compareRtt(const void* pA_p, const void* pB_p);
 
 //============================================================================//
 //            P U B L I C   F U N C T I O N S                                 //
@@ -123,15 +248,23 @@ int main(int argc, char** argv)
     tOplkError          ret;
     tOptions            opts;
     tOplkApiStackInfo   stackInfo;
+    UINT64              startTime;
+    UINT32              transferCount;
+    UINT32              errorCount;
+    BOOL                fStackInitialized = FALSE;
 
     memset(&opts, 0, sizeof(tOptions));
+    memset(&report_l, 0, sizeof(tUpdateReport));
 
     if (getOptions(argc, argv, &opts) == -1)
     {
         return -1;
     }
 
-    if (system_init() != 0)
+    // The tool only uses the service interface of the kernel stack. It keeps
+    // the default scheduling to stay out of the way of a control application.
+    startTime = system_getTimeUs();
+    if (system_initService() != 0)
     {
         fprintf(stderr, "Error initializing system!");
         return 0;
@@ -142,6 +275,15 @@ int main(int argc, char** argv)
     printf("for openPOWERLINK Stack: %s\n", oplk_getVersionString());
     printf("----------------------------------------------------\n");
 
+    // The status area is read from the card directly, thus the boot timeline is
+    // also available if the kernel stack does not come up.
+    if (opts.fPrintStatus)
+    {
+        printBootTimeline();
+        printLoopStatistics();
+        printMempoolStatistics();
+    }
+
     ret = oplk_initialize();
     if (ret != kErrorOk)
     {
@@ -149,6 +291,8 @@ int main(int argc, char** argv)
         goto Exit;
     }
 
+    fStackInitialized = TRUE;
+
     ret = oplk_getStackInfo(&stackInfo);
     if (ret != kErrorOk)
     {
@@ -161,13 +305,40 @@ int main(int argc, char** argv)
     printf("Kernel stack version:   0x%08X\n", stackInfo.kernelVersion);
     printf("Kernel stack feature:   0x%08X\n", stackInfo.kernelFeature);
 
+    recordPhase(kUpdatePhaseAttach, startTime);
+    printf("Attached in %lu ms\n",
+           (unsigned long)(report_l.aPhaseTime[kUpdatePhaseAttach] / 1000U));
+
+    fChunkTrailer_l = opts.fChunkCrc;
+
+    if (opts.tuningFile[0] != '\0')
+        pszTuningFile_l = opts.tuningFile;
+
+    if (opts.fTuneChunkSize)
+    {
+        ret = tuneChunkSize(&stackInfo);
+        if (ret != kErrorOk)
+        {
+            printf("Failed to tune file chunk size (ret = 0x%X)!\n", ret);
+            goto Exit;
+        }
+    }
+
+    tunedChunkSize_l = loadChunkSize(&stackInfo);
+    if (tunedChunkSize_l != 0)
+        printf("Tuned file chunk size:  %lu\n", (unsigned long)tunedChunkSize_l);
+
+    // The tuning probe runs at full rate, the limit applies to the update only
+    rateLimit_l = opts.rateLimit;
+    report_l.rateLimit = opts.rateLimit;
+
     if (opts.fInvalidateUpdateImage)
     {
+        report_l.pszMode = "invalidate";
         ret = invalidateImage();
         if (ret != kErrorOk)
         {
             printf("Failed to invalidate image (ret = 0x%X)!\n", ret);
-            oplk_exit();
             goto Exit;
         }
 
@@ -176,13 +347,19 @@ int main(int argc, char** argv)
 
     if (opts.fUpdateImage)
     {
-        ret = updateImage(opts.firmwareFile);
+        transferCount = readFlashTransferCount();
+        errorCount = readFlashErrorCount();
+
+        ret = updateImage(opts.firmwareFile, opts.fCompress, opts.fApplicationOnly);
         if (ret != kErrorOk)
         {
             printf("Failed to update image (ret = 0x%X)!\n", ret);
-            oplk_exit();
+            printFlashError(errorCount);
             goto Exit;
         }
+
+        readFlashStatistics(transferCount);
+        printTransferSummary();
     }
 
     if (opts.fFactoryReset || opts.fUpdateReset)
@@ -190,20 +367,56 @@ int main(int argc, char** argv)
         printf("\nIssue firmware reconfiguration to %s image...\n",
                 opts.fFactoryReset ? "FACTORY" : "UPDATE");
 
+        startTime = system_getTimeUs();
         ret = oplk_serviceExecFirmwareReconfig(opts.fFactoryReset);
+        recordPhase(kUpdatePhaseReconfig, startTime);
         if (ret != kErrorOk)
         {
             printf("Failed to execute firmware reconfiguration (ret = 0x%X)!\n", ret);
-            oplk_exit();
             goto Exit;
         }
 
         printf("Done\n");
-    }
 
-    oplk_exit();
+        if (opts.fWaitReady)
+        {
+            // The card restarts with the new image, the stack is attached again
+            oplk_exit();
+            acknowledgeDetach();
+            fStackInitialized = FALSE;
+
+            printf("Wait for card to be ready...\n");
+
+            startTime = system_getTimeUs();
+            ret = waitForReady();
+            if (ret != kErrorOk)
+            {
+                printf("Card is not ready after %u ms!\n", FIRMWARE_READY_TIMEOUT_MS);
+                goto Exit;
+            }
+
+            recordPhase(kUpdatePhaseReady, startTime);
+            fStackInitialized = TRUE;
+
+            printf("Card ready after %lu ms\n",
+                   (unsigned long)(report_l.aPhaseTime[kUpdatePhaseReady] / 1000U));
+        }
+    }
 
 Exit:
+    if (fStackInitialized)
+    {
+        oplk_exit();
+        acknowledgeDetach();
+    }
+
+    report_l.result = ret;
+
+    if ((opts.reportFile[0] != '\0') && (writeReport(opts.reportFile, opts.firmwareFile) != 0))
+        printf("Unable to write report file %s\n", opts.reportFile);
+
+    free(report_l.pRtt);
+
     system_exit();
 
     return 0;
@@ -244,10 +457,18 @@ static int getOptions(int argc_p, char** argv_p, tOptions* pOpts_p)
     }
 
     /* get command line parameters */
-    while ((opt = getopt(argc_p, argv_p, "d:efuv")) != -1)
+    while ((opt = getopt(argc_p, argv_p, "bcd:efj:p:r:stuvwz")) != -1)
     {
         switch (opt)
         {
+            case 'b':
+                pOpts_p->fPrintStatus = TRUE;
+                break;
+
+            case 'c':
+                pOpts_p->fChunkCrc = TRUE;
+                break;
+
             case 'd':
                 strncpy(pOpts_p->firmwareFile, optarg, 256);
                 pOpts_p->fUpdateImage = TRUE;
@@ -257,6 +478,26 @@ static int getOptions(int argc_p, char** argv_p, tOptions* pOpts_p)
                 pOpts_p->fInvalidateUpdateImage = TRUE;
                 break;
 
+            case 'j':
+                strncpy(pOpts_p->reportFile, optarg, 256);
+                break;
+
+            case 'p':
+                strncpy(pOpts_p->tuningFile, optarg, 256);
+                break;
+
+            case 'r':
+                pOpts_p->rateLimit = (UINT)strtoul(optarg, NULL, 0);
+                break;
+
+            case 's':
+                pOpts_p->fApplicationOnly = TRUE;
+                break;
+
+            case 't':
+                pOpts_p->fTuneChunkSize = TRUE;
+                break;
+
             case 'f':
                 pOpts_p->fFactoryReset = TRUE;
                 pOpts_p->fUpdateReset = FALSE; // falsify if also -u is given
@@ -272,13 +513,30 @@ static int getOptions(int argc_p, char** argv_p, tOptions* pOpts_p)
                 // performing any firmware update or invalidation.
                 break;
 
+            case 'w':
+                pOpts_p->fWaitReady = TRUE;
+                break;
+
+            case 'z':
+                pOpts_p->fCompress = TRUE;
+                break;
+
             default: /* '?' */
                 printf("Usage: %s [COMMAND] \n"
-                       "-d <UPDATE_IMAGE>: Download update image to IF card\n"
+                       "-b : Print the boot timeline, loop and memory pool statistics of the IF card\n"
+                       "-c : Protect each file chunk by a CRC and retransmit damaged chunks\n"
+                       "-d <UPDATE_IMAGE>: Download update image or delta to IF card\n"
                        "-e : Invalidate the existing update image\n"
                        "-f : Reset to factory image\n"
-                       "-u : Reset to update image\n",
-                       "-v : View kernel stack information\n",
+                       "-j <REPORT_FILE>: Write timing, throughput and retries as JSON report\n"
+                       "-p <TUNING_FILE>: File of tuned chunk sizes (default " FIRMWARE_TUNING_FILE ")\n"
+                       "-r <KB_PER_S>: Limit the transfer rate, e.g. while the network is running\n"
+                       "-s : Download only the application section of update image\n"
+                       "-t : Tune file chunk size for this card (stored in the tuning file)\n"
+                       "-u : Reset to update image\n"
+                       "-v : View kernel stack information\n"
+                       "-w : Wait for the card to be ready after reset\n"
+                       "-z : Compress update image for download\n",
                        argv_p[0]);
                 return -1;
         }
@@ -303,7 +561,7 @@ static tOplkError invalidateImage(void)
 
     memset(aInvalidHeader, 0xFF, sizeof(aInvalidHeader));
 
-    ret = writeImageToKernel(aInvalidHeader, sizeof(aInvalidHeader));
+    ret = writeImageToKernel(aInvalidHeader, sizeof(aInvalidHeader), 0);
 
     return ret;
 }
@@ -312,20 +570,31 @@ static tOplkError invalidateImage(void)
 /**
 \brief  Update the firmware image
 
-The function updates the firmware image.
+The function updates the firmware image. The image is validated before any
+chunk is sent. If requested, the image is compressed before the download and
+decompressed by the driver. If only the application
+section is requested, the bitstream stored on the IF card is kept. An
+interrupted download of the same uncompressed image is resumed.
 
 \param  pszFirmwareFile_p       Firmware update image file
+\param  fCompress_p             Compress the image for the download
+\param  fApplicationOnly_p      Download only the application section
 
 \return The function returns a tOplkError code.
 */
 //------------------------------------------------------------------------------
-static tOplkError updateImage(char* pszFirmwareFile_p)
+static tOplkError updateImage(char* pszFirmwareFile_p, BOOL fCompress_p,
+                              BOOL fApplicationOnly_p)
 {
     tOplkError  ret = kErrorOk;
     FILE*       pFile;
     int         fileSize;
     size_t      readSize;
-    UINT8*      pImage;
+    UINT8*      pImage = NULL;
+    UINT8*      pStream = NULL;
+    size_t      streamSize;
+    UINT        resumeOffset;
+    UINT64      startTime = system_getTimeUs();
 
     pFile = fopen(pszFirmwareFile_p, "rb");
     if (pFile == NULL)
@@ -360,9 +629,92 @@ static tOplkError updateImage(char* pszFirmwareFile_p)
         goto Exit;
     }
 
-    ret = writeImageToKernel(pImage, fileSize);
+    recordPhase(kUpdatePhaseLoad, startTime);
+    report_l.imageSize = (size_t)fileSize;
+
+    // A delta is checked by the driver against the stored update image
+    if (!fwdelta_isDelta(pImage, fileSize))
+    {
+        startTime = system_getTimeUs();
+        ret = checkImage(pImage, fileSize);
+        recordPhase(kUpdatePhaseCheck, startTime);
+        if (ret != kErrorOk)
+            goto Exit;
+    }
+
+    startTime = system_getTimeUs();
+
+    if (fApplicationOnly_p)
+    {
+        if (fCompress_p)
+        {
+            printf("Compression is not supported for application section download!\n");
+            ret = kErrorInvalidOperation;
+            goto Exit;
+        }
+
+        pStream = createSectionUpdate(pImage, fileSize, FWIMAGE_SECTION_APPLICATION, &streamSize);
+        if (pStream == NULL)
+        {
+            printf("Unable to get application section of file %s\n", pszFirmwareFile_p);
+            ret = kErrorInvalidOperation;
+            goto Exit;
+        }
+
+        recordPhase(kUpdatePhasePrepare, startTime);
+        report_l.pszMode = "section";
+
+        printf("Download application section with %lu of %d bytes\n",
+               (unsigned long)streamSize, fileSize);
+
+        ret = writeImageToKernel(pStream, (UINT)streamSize, 0);
+    }
+    else if (fCompress_p)
+    {
+        streamSize = fwcompress_getMaxCompressedSize(fileSize);
+        pStream = (UINT8*)malloc(streamSize);
+        if (pStream == NULL)
+        {
+            ret = kErrorNoResource;
+            goto Exit;
+        }
+
+        streamSize = fwcompress_compress(pImage, fileSize, pStream, streamSize);
+        if (streamSize == 0)
+        {
+            printf("Unable to compress file %s\n", pszFirmwareFile_p);
+            ret = kErrorGeneralError;
+            goto Exit;
+        }
+
+        recordPhase(kUpdatePhasePrepare, startTime);
+        report_l.pszMode = "compressed";
+
+        printf("Compressed image from %d to %lu bytes\n", fileSize, (unsigned long)streamSize);
+
+        ret = writeImageToKernel(pStream, (UINT)streamSize, 0);
+    }
+    else
+    {
+        resumeOffset = findResumeOffset(pImage, fileSize);
+        recordPhase(kUpdatePhasePrepare, startTime);
+        report_l.resumeOffset = resumeOffset;
+
+        if (fwdelta_isDelta(pImage, fileSize))
+            report_l.pszMode = "delta";
+        else
+            report_l.pszMode = (resumeOffset > 0) ? "resume" : "full";
+
+        if (resumeOffset > 0)
+            printf("Resume interrupted download at offset %u\n", resumeOffset);
+
+        ret = writeImageToKernel(pImage, fileSize, resumeOffset);
+    }
 
 Exit:
+    if (pStream != NULL)
+        free(pStream);
+
     if (pImage != NULL)
         free(pImage);
 
@@ -372,27 +724,232 @@ Exit:
     return ret;
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Check update image
+
+The function checks the firmware header and the image CRC of the given update
+image file and prints the image information. A wrong or truncated file is
+rejected before the download.
+
+\param  pImage_p        Pointer to the update image file
+\param  imageSize_p     Size of the update image file
+
+\return The function returns a tOplkError code.
+*/
+//------------------------------------------------------------------------------
+static tOplkError checkImage(const UINT8* pImage_p, size_t imageSize_p)
+{
+    tFwImageHeader  header;
+    UINT32          crc;
+
+    switch (fwimage_getHeader(pImage_p, imageSize_p, &header))
+    {
+        case FWIMAGE_OK:
+            break;
+
+        case FWIMAGE_ERR_CRC:
+            printf("Firmware header CRC is wrong!\n");
+            return kErrorInvalidOperation;
+
+        default:
+            printf("File is no firmware update image!\n");
+            return kErrorInvalidOperation;
+    }
+
+    printf("Firmware header:\n");
+    printf(" Time stamp     0x%08X\n", header.timeStamp);
+    printf(" Length         0x%08X\n", header.length);
+    printf(" CRC            0x%08X\n", header.crc);
+    printf(" OPLK Version   0x%08X\n", header.oplkVersion);
+    printf(" OPLK Feature   0x%08X\n", header.oplkFeature);
+
+    if (header.length != (imageSize_p - FIRMWARE_HEADER_SIZE))
+    {
+        printf("Image length does not match the file size (%lu of %lu bytes)!\n",
+               (unsigned long)(imageSize_p - FIRMWARE_HEADER_SIZE), (unsigned long)header.length);
+        return kErrorInvalidOperation;
+    }
+
+    crc = crc32_calc(CRC32_INIT, pImage_p + FIRMWARE_HEADER_SIZE, header.length);
+    if (crc != header.crc)
+    {
+        printf("Image CRC is wrong (0x%08X)!\n", crc);
+        return kErrorInvalidOperation;
+    }
+
+    printf("Image CRC verified (%s)\n", crc32_getImplementation());
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Create section update
+
+The function creates the download stream which replaces the given section and
+all following sections of the update image stored on the IF card. The stream
+consists of the section update prefix and the image data from the start of the
+section up to the end of the image.
+
+\param  pImage_p        Pointer to the update image file
+\param  imageSize_p     Size of the update image file
+\param  sectionIndex_p  Index of the first replaced section
+\param  pStreamSize_p   Pointer to store the size of the stream
+
+\return The function returns the allocated stream or NULL on error.
+*/
+//------------------------------------------------------------------------------
+static UINT8* createSectionUpdate(const UINT8* pImage_p, size_t imageSize_p,
+                                  UINT32 sectionIndex_p, size_t* pStreamSize_p)
+{
+    tFwImageSectionUpdate   update;
+    const UINT8*            pData;
+    size_t                  dataSize;
+    UINT8*                  pStream;
+
+    if (imageSize_p < FIRMWARE_HEADER_SIZE)
+        return NULL;
+
+    if (fwimage_getSectionTable(pImage_p + FIRMWARE_HEADER_SIZE,
+                                imageSize_p - FIRMWARE_HEADER_SIZE,
+                                &update.sectionTable) != FWIMAGE_OK)
+    {
+        printf("Image has no section table!\n");
+        return NULL;
+    }
+
+    update.magic = FWIMAGE_SECTION_UPDATE_MAGIC;
+    update.sectionIndex = sectionIndex_p;
+    memcpy(update.aHeader, pImage_p, FIRMWARE_HEADER_SIZE);
+
+    pData = pImage_p + FIRMWARE_HEADER_SIZE + update.sectionTable.aSection[sectionIndex_p].offset;
+    dataSize = imageSize_p - (size_t)(pData - pImage_p);
+
+    pStream = (UINT8*)malloc(sizeof(update) + dataSize);
+    if (pStream == NULL)
+        return NULL;
+
+    memcpy(pStream, &update, sizeof(update));
+    memcpy(pStream + sizeof(update), pData, dataSize);
+    *pStreamSize_p = sizeof(update) + dataSize;
+
+    return pStream;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Find resume offset
+
+The function determines the offset from which an interrupted download of the
+given image can be resumed. The driver accepts a resume request up to the last
+committed sector, thus the highest accepted chunk offset is searched. The driver
+is left prepared to continue at the returned offset.
+
+\param  pImage_p    Pointer to the image
+\param  length_p    Length of the image in bytes
+
+\return The function returns the resume offset or 0 to download the whole image.
+*/
+//------------------------------------------------------------------------------
+static UINT findResumeOffset(const UINT8* pImage_p, UINT length_p)
+{
+    size_t  chunkSize = getChunkDataSize();
+    UINT    low = 0;
+    UINT    high;
+    UINT    mid;
+
+    if ((chunkSize < sizeof(tFwImageResume)) || (length_p <= FIRMWARE_HEADER_SIZE))
+        return 0;
+
+    // At least the last chunk is transferred to complete the download
+    high = (length_p - 1) / (UINT)chunkSize;
+
+    while (low < high)
+    {
+        mid = (low + high + 1) / 2;
+
+        if (writeResumeRequest(pImage_p, mid * (UINT)chunkSize) == kErrorOk)
+            low = mid;
+        else
+            high = mid - 1;
+    }
+
+    // Issue the accepted request again, later requests may have been rejected
+    if ((low > 0) && (writeResumeRequest(pImage_p, low * (UINT)chunkSize) != kErrorOk))
+        return 0;
+
+    return low * (UINT)chunkSize;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write resume request
+
+The function writes a resume request for the given image to the kernel stack.
+
+\param  pImage_p    Pointer to the image
+\param  offset_p    Offset to continue the download
+
+\return The function returns kErrorOk if the driver accepted the request.
+*/
+//------------------------------------------------------------------------------
+static tOplkError writeResumeRequest(const UINT8* pImage_p, UINT offset_p)
+{
+    tOplkApiFileChunkDesc   desc;
+    tFwImageResume          resume;
+    UINT8                   aRequest[sizeof(tFwImageResume) + sizeof(tFwImageChunkTrailer)];
+
+    resume.magic = FWIMAGE_RESUME_MAGIC;
+    resume.offset = offset_p;
+    memcpy(resume.aHeader, pImage_p, FIRMWARE_HEADER_SIZE);
+    memcpy(aRequest, &resume, sizeof(resume));
+
+    memset(&desc, 0, sizeof(desc));
+    desc.fFirst = TRUE;
+    desc.offset = 0;
+    desc.length = sizeof(resume);
+
+    if (fChunkTrailer_l)
+        desc.length = (UINT32)fwimage_addChunkTrailer(aRequest, sizeof(resume), 0);
+
+    return oplk_serviceWriteFileChunk(&desc, aRequest);
+}
+
 //------------------------------------------------------------------------------
 /**
 \brief  Write image to kernel stack
 
 The function writes the given image to the kernel stack by creating chunks.
+A download resumed by findResumeOffset() starts at the given offset. If chunk
+protection is enabled, a chunk trailer is appended to each chunk and a chunk
+rejected as damaged by the driver is sent again. While the stack on the card is
+running, the card programs flash in the background and rejects chunks as busy
+meanwhile, these are sent again until FIRMWARE_BUSY_TIMEOUT_MS has elapsed. The
+transfer is paced to the rate limit given by the -r option.
 
 \param  pImage_p    Pointer to image to be written to kernel stack
 \param  length_p    Length of the image in bytes
+\param  offset_p    Offset to start the download
 
 \return The function returns a tOplkError code.
 */
 //------------------------------------------------------------------------------
-static tOplkError writeImageToKernel(UINT8* pImage_p, UINT length_p)
+static tOplkError writeImageToKernel(UINT8* pImage_p, UINT length_p, UINT offset_p)
 {
     tOplkError              ret = kErrorOk;
     tOplkApiFileChunkDesc   desc;
     UINT8*                  pChunk;
-    size_t                  chunkSize = oplk_serviceGetFileChunkSize();
-    float                   completePercentage = 0;
-    float                   completedLength;
-    float                   totalLength = (float)(length_p);
+    size_t                  chunkSize = getChunkDataSize();
+    UINT32                  length;
+    UINT                    retry;
+    UINT                    progress = 0;
+    UINT                    lastProgress = 101;
+    UINT64                  totalLength = length_p;
+    UINT64                  startTime = system_getTimeUs();
+    UINT64                  chunkTime;
+    UINT64                  busyTime;
+    UINT64                  transferred = 0;
 
     if (chunkSize == 0)
     {
@@ -400,50 +957,930 @@ static tOplkError writeImageToKernel(UINT8* pImage_p, UINT length_p)
         return kErrorNoResource;
     }
 
-    pChunk = (UINT8*)malloc(chunkSize);
+    pChunk = (UINT8*)malloc(chunkSize + sizeof(tFwImageChunkTrailer));
     if (pChunk == NULL)
         return kErrorNoResource;
 
+    report_l.chunkSize = chunkSize;
+
     memset(&desc, 0, sizeof(desc));
-    desc.fFirst = TRUE;
-    desc.offset = 0;
+    desc.fFirst = (offset_p == 0);
+    desc.offset = offset_p;
+    pImage_p += offset_p;
+    length_p -= offset_p;
 
     while (length_p)
     {
-        if (length_p < chunkSize)
+        if (length_p <= chunkSize)
         {
-            desc.length = length_p;
+            length = length_p;
             desc.fLast = TRUE;
         }
         else
-            desc.length = (UINT32)chunkSize;
+            length = (UINT32)chunkSize;
+
+        memcpy(pChunk, pImage_p, length);
+        desc.length = length;
+
+        if (fChunkTrailer_l)
+            desc.length = (UINT32)fwimage_addChunkTrailer(pChunk, length, desc.offset);
+
+        busyTime = system_getTimeUs();
+        for (retry = 0; ; )
+        {
+            chunkTime = system_getTimeUs();
+            ret = oplk_serviceWriteFileChunk(&desc, pChunk);
+
+            // The card is programming flash, the chunk is sent again later
+            if ((ret == kErrorReject) &&
+                ((chunkTime - busyTime) < (FIRMWARE_BUSY_TIMEOUT_MS * 1000ULL)))
+            {
+                report_l.busyCount++;
+                system_msleep(FIRMWARE_BUSY_POLL_MS);
+                continue;
+            }
+
+            addRtt((UINT32)(system_getTimeUs() - chunkTime));
+
+            if ((ret != kErrorRetry) || (retry >= FIRMWARE_CHUNK_RETRIES))
+                break;
 
-        memcpy(pChunk, pImage_p, desc.length);
+            retry++;
+            report_l.retryCount++;
+            printf("\nRetransmit file chunk at offset %u\n", desc.offset);
+        }
 
-        ret = oplk_serviceWriteFileChunk(&desc, pChunk);
         if (ret != kErrorOk)
         {
             printf("Writing file chunk failed (0x%X)!\n", ret);
+
+            // Compressed, delta and section downloads block the card for whole sectors
+            if ((ret == kErrorInvalidOperation) && desc.fFirst)
+                printf("The card accepts only plain images while its stack is initialized!\n");
+
             goto Exit;
         }
 
-        desc.offset += desc.length;
+        report_l.chunkCount++;
+        report_l.transferSize += length;
+        transferred += length;
+
+        if (rateLimit_l != 0)
+            limitRate(startTime, transferred);
+
+        desc.offset += length;
         desc.fFirst = FALSE;
-        pImage_p += desc.length;
-        length_p -= desc.length;
+        pImage_p += length;
+        length_p -= length;
 
-        // Display progress of download
-        completedLength = (float)length_p;
-        completePercentage = (((totalLength - completedLength) / totalLength) * 100.0);
-        printf("\rProgress [%.0f%%]", floor(completePercentage));
-        fflush(stdout);
+        // Display progress of download when it changes
+        progress = (UINT)(((totalLength - length_p) * 100U) / totalLength);
+        if (progress != lastProgress)
+        {
+            printf("\rProgress [%u%%]", progress);
+            fflush(stdout);
+            lastProgress = progress;
+        }
     }
 
 Exit:
+    recordPhase(kUpdatePhaseTransfer, startTime);
+
     if (pChunk != NULL)
         free(pChunk);
 
     return ret;
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Get chunk data size
+
+The function returns the size of the image data transferred per file chunk.
+If chunk protection is enabled, the chunk trailer is deducted from the file
+chunk size of the kernel stack. A tuned chunk size is used if it fits.
+
+\return The function returns the chunk data size or 0 if file chunk transfer
+        is not available.
+*/
+//------------------------------------------------------------------------------
+static size_t getChunkDataSize(void)
+{
+    size_t  chunkSize = oplk_serviceGetFileChunkSize();
+
+    if (fChunkTrailer_l)
+    {
+        if (chunkSize <= sizeof(tFwImageChunkTrailer))
+            return 0;
+
+        chunkSize -= sizeof(tFwImageChunkTrailer);
+    }
+
+    if ((tunedChunkSize_l != 0) && (tunedChunkSize_l < chunkSize))
+        return tunedChunkSize_l;
+
+    return chunkSize;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Limit transfer rate
+
+The function waits until the transfer of the given length has taken as long as
+the rate limit demands.
+
+\param  startTime_p     Start time of the transfer [us]
+\param  length_p        Bytes transferred since the start
+*/
+//------------------------------------------------------------------------------
+static void limitRate(UINT64 startTime_p, UINT64 length_p)
+{
+    UINT64  targetTime = startTime_p + ((length_p * 1000000U) / (rateLimit_l * 1024U));
+    UINT64  now = system_getTimeUs();
+
+    if (targetTime > now)
+        system_msleep((unsigned int)((targetTime - now + 999U) / 1000U));
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Tune file chunk size
+
+The function probes the download throughput for chunk sizes from the maximum
+size of the kernel stack down to FIRMWARE_TUNING_MIN_CHUNK, halving the size
+per step. Each probe transfers FIRMWARE_TUNING_PROBE_SIZE bytes which the
+driver programs to a scratch area behind the stored update image. The chunk
+size with the highest throughput is stored in the tuning file for the card.
+
+\param  pStackInfo_p    Stack information identifying the card
+
+\return The function returns a tOplkError code.
+*/
+//------------------------------------------------------------------------------
+static tOplkError tuneChunkSize(const tOplkApiStackInfo* pStackInfo_p)
+{
+    tOplkError      ret = kErrorOk;
+    tFwImageProbe   probe;
+    UINT8*          pProbe;
+    size_t          chunkSize;
+    size_t          bestChunkSize = 0;
+    UINT            throughput;
+    UINT            bestThroughput = 0;
+    UINT64          startTime;
+    UINT64          duration;
+    UINT64          attachTime;
+    UINT            i;
+
+    tunedChunkSize_l = 0;
+    chunkSize = getChunkDataSize();
+    if (chunkSize <= sizeof(probe))
+    {
+        printf("No file chunk transfer support available!\n");
+        return kErrorNoResource;
+    }
+
+    pProbe = (UINT8*)malloc(FIRMWARE_TUNING_PROBE_SIZE);
+    if (pProbe == NULL)
+        return kErrorNoResource;
+
+    probe.magic = FWIMAGE_PROBE_MAGIC;
+    probe.length = FIRMWARE_TUNING_PROBE_SIZE - sizeof(probe);
+    memcpy(pProbe, &probe, sizeof(probe));
+
+    // Pattern data which is programmed like image data
+    for (i = sizeof(probe); i < FIRMWARE_TUNING_PROBE_SIZE; i++)
+        pProbe[i] = (UINT8)(i ^ (i >> 8));
+
+    printf("\nTune file chunk size:\n");
+
+    for (; chunkSize >= FIRMWARE_TUNING_MIN_CHUNK; chunkSize /= 2)
+    {
+        tunedChunkSize_l = chunkSize;
+
+        startTime = system_getTimeUs();
+        ret = writeImageToKernel(pProbe, FIRMWARE_TUNING_PROBE_SIZE, 0);
+        if (ret != kErrorOk)
+            break;
+
+        duration = system_getTimeUs() - startTime;
+        if (duration == 0)
+            duration = 1;
+
+        throughput = (UINT)(((UINT64)FIRMWARE_TUNING_PROBE_SIZE * 1000000U) / (duration * 1024U));
+
+        printf("\r Chunk size %6lu: %u KB/s\n", (unsigned long)chunkSize, throughput);
+
+        if (throughput > bestThroughput)
+        {
+            bestThroughput = throughput;
+            bestChunkSize = chunkSize;
+        }
+    }
+
+    free(pProbe);
+    tunedChunkSize_l = 0;
+
+    // The probes are not part of the update report, the attach is
+    free(report_l.pRtt);
+    attachTime = report_l.aPhaseTime[kUpdatePhaseAttach];
+    memset(&report_l, 0, sizeof(tUpdateReport));
+    report_l.aPhaseTime[kUpdatePhaseAttach] = attachTime;
+    report_l.validMask = (1U << kUpdatePhaseAttach);
+
+    if (bestChunkSize == 0)
+        return (ret != kErrorOk) ? ret : kErrorGeneralError;
+
+    printf("Best chunk size %lu (%u KB/s)\n", (unsigned long)bestChunkSize, bestThroughput);
+
+    if (saveChunkSize(pStackInfo_p, bestChunkSize, bestThroughput) != 0)
+    {
+        printf("Unable to write %s\n", pszTuningFile_l);
+        return kErrorNoResource;
+    }
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Load tuned chunk size
+
+The function reads the tuned chunk size of the card from the tuning file. The
+card is identified by the version and feature flags of its kernel stack and
+the file chunk size it provides.
+
+\param  pStackInfo_p    Stack information identifying the card
+
+\return The function returns the tuned chunk size or 0 if the card is not tuned.
+*/
+//------------------------------------------------------------------------------
+static size_t loadChunkSize(const tOplkApiStackInfo* pStackInfo_p)
+{
+    FILE*           pFile;
+    char            aLine[128];
+    unsigned long   version;
+    unsigned long   feature;
+    unsigned long   maxChunkSize;
+    unsigned long   chunkSize;
+    size_t          tunedChunkSize = 0;
+
+    pFile = fopen(pszTuningFile_l, "r");
+    if (pFile == NULL)
+        return 0;
+
+    while (fgets(aLine, sizeof(aLine), pFile) != NULL)
+    {
+        if (sscanf(aLine, "%lx %lx %lu %lu", &version, &feature,
+                   &maxChunkSize, &chunkSize) != 4)
+            continue;
+
+        if ((version == pStackInfo_p->kernelVersion) &&
+            (feature == pStackInfo_p->kernelFeature) &&
+            (maxChunkSize == oplk_serviceGetFileChunkSize()))
+            tunedChunkSize = (size_t)chunkSize;
+    }
+
+    fclose(pFile);
+
+    return tunedChunkSize;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Save tuned chunk size
+
+The function stores the tuned chunk size of the card in the tuning file. An
+existing entry of the card is replaced, entries of other cards are kept.
+
+\param  pStackInfo_p    Stack information identifying the card
+\param  chunkSize_p     Tuned chunk size
+\param  throughput_p    Throughput with the tuned chunk size [KB/s]
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int saveChunkSize(const tOplkApiStackInfo* pStackInfo_p, size_t chunkSize_p,
+                         UINT throughput_p)
+{
+    FILE*           pFile;
+    char            aLine[128];
+    char*           pKept = NULL;
+    size_t          keptSize = 0;
+    size_t          lineLength;
+    unsigned long   version;
+    unsigned long   feature;
+    unsigned long   maxChunkSize;
+    char*           pNew;
+
+    // Keep the entries of other cards
+    pFile = fopen(pszTuningFile_l, "r");
+    if (pFile != NULL)
+    {
+        while (fgets(aLine, sizeof(aLine), pFile) != NULL)
+        {
+            if ((aLine[0] == '#') ||
+                ((sscanf(aLine, "%lx %lx %lu", &version, &feature, &maxChunkSize) == 3) &&
+                 (version == pStackInfo_p->kernelVersion) &&
+                 (feature == pStackInfo_p->kernelFeature) &&
+                 (maxChunkSize == oplk_serviceGetFileChunkSize())))
+                continue;
+
+            lineLength = strlen(aLine);
+            pNew = (char*)realloc(pKept, keptSize + lineLength + 1);
+            if (pNew == NULL)
+            {
+                fclose(pFile);
+                free(pKept);
+                return -1;
+            }
+
+            pKept = pNew;
+            memcpy(pKept + keptSize, aLine, lineLength + 1);
+            keptSize += lineLength;
+        }
+
+        fclose(pFile);
+    }
+
+    pFile = fopen(pszTuningFile_l, "w");
+    if (pFile == NULL)
+    {
+        free(pKept);
+        return -1;
+    }
+
+    fprintf(pFile, "# <kernel version> <kernel feature> <max chunk size> <chunk size> "
+                   "<throughput KB/s>\n");
+    if (pKept != NULL)
+        fputs(pKept, pFile);
+
+    fprintf(pFile, "0x%08X 0x%08X %lu %lu %u\n",
+            pStackInfo_p->kernelVersion, pStackInfo_p->kernelFeature,
+            (unsigned long)oplk_serviceGetFileChunkSize(), (unsigned long)chunkSize_p,
+            throughput_p);
+
+    free(pKept);
+
+    return (fclose(pFile) == 0) ? 0 : -1;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Wait for card to be ready
+
+The function attaches to the kernel stack again after a reconfiguration. While
+the status area of the card reports a kernel stack which is not ready, only
+the status area is polled. The stack is initialized as soon as it is ready, or
+by retries if the status area cannot be read, e.g. during the reconfiguration.
+
+\return The function returns kErrorOk if the card is ready, otherwise the error
+        of the last initialization attempt.
+*/
+//------------------------------------------------------------------------------
+static tOplkError waitForReady(void)
+{
+    tOplkError  ret = kErrorGeneralError;
+    tPcpStatus  status;
+    UINT64      startTime = system_getTimeUs();
+
+    do
+    {
+        if ((readCardStatus(&status) == 0) && (status.stack.state != kPcpStatusStackReady))
+        {
+            system_msleep(FIRMWARE_STATE_POLL_MS);
+            continue;
+        }
+
+        ret = oplk_initialize();
+        if (ret == kErrorOk)
+            break;
+
+        system_msleep(FIRMWARE_READY_POLL_MS);
+    } while ((system_getTimeUs() - startTime) < (FIRMWARE_READY_TIMEOUT_MS * 1000ULL));
+
+    if ((ret == kErrorOk) && (readCardStatus(&status) == 0))
+    {
+        printf("Kernel stack of the card ready after %lu ms (start #%lu)\n",
+               (unsigned long)status.stack.timeToReady,
+               (unsigned long)status.stack.readyCount);
+    }
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Acknowledge detach
+
+The function tells the driver daemon that this tool has detached from the
+kernel stack. The daemon then restarts or reconfigures without waiting for its
+guard time. Without a status area the daemon falls back to the guard time.
+*/
+//------------------------------------------------------------------------------
+static void acknowledgeDetach(void)
+{
+    tPcpStatus  status;
+    UINT32      readyCount;
+
+    if (readCardStatus(&status) != 0)
+        return;
+
+    readyCount = status.stack.readyCount;
+
+    system_writePciMemory(PCPSTATUS_PCI_VENDOR_ID, PCPSTATUS_PCI_DEVICE_ID, PCPSTATUS_PCI_BAR,
+                          PCPSTATUS_PCI_BAR_OFFSET + PCPSTATUS_OFFSET + PCPSTATUS_DETACH_OFFSET,
+                          &readyCount, sizeof(readyCount));
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read card status
+
+The function reads the status area which the driver daemon publishes in the
+common memory of the card.
+
+\param  pStatus_p   Pointer to store the status area
+
+\return The function returns 0 if a valid status area has been read,
+        otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int readCardStatus(tPcpStatus* pStatus_p)
+{
+    if (system_readPciMemory(PCPSTATUS_PCI_VENDOR_ID, PCPSTATUS_PCI_DEVICE_ID,
+                             PCPSTATUS_PCI_BAR, PCPSTATUS_PCI_BAR_OFFSET + PCPSTATUS_OFFSET,
+                             pStatus_p, sizeof(tPcpStatus)) != 0)
+        return -1;
+
+    if ((pStatus_p->magic != PCPSTATUS_MAGIC) || (pStatus_p->version != PCPSTATUS_VERSION) ||
+        (pStatus_p->length < sizeof(tPcpStatus)))
+        return -1;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print boot timeline
+
+The function prints the boot timeline of the card with the completion time of
+each boot phase and its duration.
+*/
+//------------------------------------------------------------------------------
+static void printBootTimeline(void)
+{
+    tPcpStatus  status;
+    UINT        phase;
+    UINT32      lastTimeStamp = 0;
+
+    if (readCardStatus(&status) != 0)
+    {
+        printf("Unable to read the status area of the card!\n");
+        return;
+    }
+
+    printf("Boot timeline of the card (since system timer start):\n");
+
+    for (phase = 0; phase < kPcpStatusBootPhaseCount; phase++)
+    {
+        if ((status.boot.validMask & (1U << phase)) == 0)
+            continue;
+
+        printf(" %-14s %6lu ms (+%lu ms)\n", aBootPhaseName_l[phase],
+               (unsigned long)status.boot.aTimeStamp[phase],
+               (unsigned long)(status.boot.aTimeStamp[phase] - lastTimeStamp));
+
+        lastTimeStamp = status.boot.aTimeStamp[phase];
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print background loop statistics
+
+The function prints the background loop statistics of the running kernel stack
+session of the card. The ctrl poll rate is the load the daemon puts on the
+shared memory.
+*/
+//------------------------------------------------------------------------------
+static void printLoopStatistics(void)
+{
+    tPcpStatus  status;
+
+    if ((readCardStatus(&status) != 0) || (status.loop.sessionCount == 0))
+        return;
+
+    printf("Background loop of the card (session %lu):\n",
+           (unsigned long)status.loop.sessionCount);
+    printf(" Duration       %lu ms\n", (unsigned long)status.loop.duration);
+    printf(" Iterations     %lu\n", (unsigned long)status.loop.loopCount);
+    printf(" Ctrl polls     %lu\n", (unsigned long)status.loop.ctrlPollCount);
+    printf(" Ctrl commands  %lu\n", (unsigned long)status.loop.ctrlCmdCount);
+    printf(" Heartbeats     %lu\n", (unsigned long)status.loop.heartbeatCount);
+
+    if (status.loop.duration > 0)
+    {
+        printf(" Ctrl poll rate %lu 1/s\n",
+               (unsigned long)(((UINT64)status.loop.ctrlPollCount * 1000U) /
+                               status.loop.duration));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print memory pool statistics
+
+The function prints the memory pool statistics of the card since power-on. The
+high-water marks show how far the pool classes and the heap can be reduced.
+*/
+//------------------------------------------------------------------------------
+static void printMempoolStatistics(void)
+{
+    tPcpStatus              status;
+    tPcpStatusMempoolClass* pClass;
+    UINT                    i;
+
+    if ((readCardStatus(&status) != 0) || (status.mempool.arenaSize == 0))
+        return;
+
+    printf("Memory pool of the card (%lu bytes arena):\n",
+           (unsigned long)status.mempool.arenaSize);
+    printf(" High-water     %lu bytes\n", (unsigned long)status.mempool.highWaterBytes);
+    printf(" Failed allocs  %lu\n", (unsigned long)status.mempool.failCount);
+    printf(" Invalid frees  %lu\n", (unsigned long)status.mempool.invalidFreeCount);
+
+    for (i = 0; i < PCPSTATUS_MEMPOOL_CLASS_COUNT; i++)
+    {
+        pClass = &status.mempool.aClass[i];
+
+        if (pClass->blockCount == 0)
+            continue;
+
+        printf(" Class %6lu B  %lu of %lu blocks, %lu spills, %lu bytes max. waste\n",
+               (unsigned long)pClass->blockSize, (unsigned long)pClass->highWaterCount,
+               (unsigned long)pClass->blockCount, (unsigned long)pClass->spillCount,
+               (unsigned long)pClass->maxWasteBytes);
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read flash transfer count
+
+The function reads the number of file transfers the card has completed. It is
+used to match the flash statistics of the status area to a transfer.
+
+\return The function returns the transfer count, 0 if the status area is not
+        available.
+*/
+//------------------------------------------------------------------------------
+static UINT32 readFlashTransferCount(void)
+{
+    tPcpStatus  status;
+
+    if (readCardStatus(&status) != 0)
+        return 0;
+
+    return status.flash.transferCount;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read flash statistics
+
+The function reads the flash statistics of the completed file transfer from
+the status area of the card. They are only taken if the card has completed a
+transfer since the given transfer count was read.
+
+\param  transferCount_p     Transfer count read before the transfer
+*/
+//------------------------------------------------------------------------------
+static void readFlashStatistics(UINT32 transferCount_p)
+{
+    tPcpStatus  status;
+
+    report_l.fFlashValid = FALSE;
+
+    if ((readCardStatus(&status) != 0) || (status.flash.transferCount == transferCount_p))
+        return;
+
+    report_l.flash = status.flash;
+    report_l.fFlashValid = TRUE;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read flash error count
+
+The function reads the number of flash verify errors of the card. It is used
+to match the failing flash offset of the status area to a transfer.
+
+\return The function returns the error count, 0 if the status area is not
+        available.
+*/
+//------------------------------------------------------------------------------
+static UINT32 readFlashErrorCount(void)
+{
+    tPcpStatus  status;
+
+    if (readCardStatus(&status) != 0)
+        return 0;
+
+    return status.flash.errorCount;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print flash error
+
+The function prints the flash offset at which verification failed on the card,
+if a verify error has occurred since the given error count was read. With the
+staging window, the failed file chunk is the one completing the window, thus
+the offset may lie in an earlier chunk.
+
+\param  errorCount_p    Error count read before the transfer
+*/
+//------------------------------------------------------------------------------
+static void printFlashError(UINT32 errorCount_p)
+{
+    tPcpStatus  status;
+
+    if ((readCardStatus(&status) != 0) || (status.flash.errorCount == errorCount_p))
+        return;
+
+    printf("Flash verify failed at offset 0x%08lX!\n",
+           (unsigned long)status.flash.errorOffset);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print timing model
+
+The function prints the flash statistics and the chunk size of the transfer as
+parameters of the fwimage timing model. The output can be passed to
+"fwimage calibrate" as it is. Rates below 1 KB are left out as they are too
+inaccurate with the millisecond time base of the card.
+
+\param  pFile_p     Output stream
+*/
+//------------------------------------------------------------------------------
+static void printTimingModel(FILE* pFile_p)
+{
+    const tPcpStatusFlash*  pFlash = &report_l.flash;
+
+    fprintf(pFile_p, "flash_size=%lu sector_size=%lu chunk_size=%lu",
+            (unsigned long)pFlash->flashSize, (unsigned long)pFlash->sectorSize,
+            (unsigned long)report_l.chunkSize);
+
+    if (pFlash->eraseCount > 0)
+        fprintf(pFile_p, " erase_ms=%lu", (unsigned long)(pFlash->eraseTime / pFlash->eraseCount));
+
+    if (pFlash->programLength >= 1024U)
+    {
+        fprintf(pFile_p, " program_us_per_kb=%lu",
+                (unsigned long)(((UINT64)pFlash->programTime * 1000U * 1024U) /
+                                pFlash->programLength));
+    }
+
+    if (pFlash->verifyLength >= 1024U)
+    {
+        fprintf(pFile_p, " verify_us_per_kb=%lu",
+                (unsigned long)(((UINT64)pFlash->verifyTime * 1000U * 1024U) /
+                                pFlash->verifyLength));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Record update phase
+
+The function adds the time elapsed since the given start time to the duration
+of an update phase.
+
+\param  phase_p         Update phase
+\param  startTime_p     Start time of the phase [us]
+*/
+//------------------------------------------------------------------------------
+static void recordPhase(eUpdatePhase phase_p, UINT64 startTime_p)
+{
+    report_l.aPhaseTime[phase_p] += system_getTimeUs() - startTime_p;
+    report_l.validMask |= (1U << phase_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Add chunk round trip time
+
+The function stores the round trip time of a file chunk write. If no memory is
+left, the time is dropped.
+
+\param  rtt_p           Round trip time [us]
+*/
+//------------------------------------------------------------------------------
+static void addRtt(UINT32 rtt_p)
+{
+    UINT32* pRtt;
+    UINT    size;
+
+    if (report_l.rttCount == report_l.rttSize)
+    {
+        size = (report_l.rttSize == 0) ? 256 : (report_l.rttSize * 2);
+        pRtt = (UINT32*)realloc(report_l.pRtt, size * sizeof(UINT32));
+        if (pRtt == NULL)
+            return;
+
+        report_l.pRtt = pRtt;
+        report_l.rttSize = size;
+    }
+
+    report_l.pRtt[report_l.rttCount++] = rtt_p;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print transfer summary
+
+The function prints duration, throughput and chunk round trip times of the
+file transfer.
+*/
+//------------------------------------------------------------------------------
+static void printTransferSummary(void)
+{
+    UINT64  transferTime = report_l.aPhaseTime[kUpdatePhaseTransfer];
+    UINT    count = report_l.rttCount;
+
+    if ((transferTime == 0) || (count == 0))
+        return;
+
+    qsort(report_l.pRtt, count, sizeof(UINT32), compareRtt);
+
+    printf("\nTransferred %lu bytes in %lu ms (%lu KB/s), %u chunks, %u retries, %u busy\n",
+           (unsigned long)report_l.transferSize, (unsigned long)(transferTime / 1000U),
+           (unsigned long)((report_l.transferSize * 1000000ULL) / (transferTime * 1024U)),
+           report_l.chunkCount, report_l.retryCount, report_l.busyCount);
+    printf("Chunk round trip: p50 %lu us, p99 %lu us, max %lu us\n",
+           (unsigned long)report_l.pRtt[(count - 1) / 2],
+           (unsigned long)report_l.pRtt[((count - 1) * 99U) / 100U],
+           (unsigned long)report_l.pRtt[count - 1]);
+
+    if (report_l.fFlashValid)
+    {
+        printf("Flash on card: %lu sectors erased in %lu ms, %lu bytes programmed in %lu ms\n",
+               (unsigned long)report_l.flash.eraseCount, (unsigned long)report_l.flash.eraseTime,
+               (unsigned long)report_l.flash.programLength,
+               (unsigned long)report_l.flash.programTime);
+        printf("Timing model: ");
+        printTimingModel(stdout);
+        printf("\n");
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write JSON report
+
+The function writes the telemetry of the update as JSON report. Durations of
+phases which were not executed are null.
+
+\param  pszFile_p           Report file
+\param  pszFirmwareFile_p   Firmware update image file
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int writeReport(const char* pszFile_p, const char* pszFirmwareFile_p)
+{
+    FILE*   pFile;
+    UINT    count = report_l.rttCount;
+    UINT64  transferTime = report_l.aPhaseTime[kUpdatePhaseTransfer];
+    UINT64  rttSum = 0;
+    UINT    i;
+
+    pFile = fopen(pszFile_p, "w");
+    if (pFile == NULL)
+        return -1;
+
+    qsort(report_l.pRtt, count, sizeof(UINT32), compareRtt);
+
+    fprintf(pFile, "{\n  \"file\": ");
+    writeJsonString(pFile, pszFirmwareFile_p);
+    fprintf(pFile, ",\n  \"mode\": ");
+    if (report_l.pszMode != NULL)
+        writeJsonString(pFile, report_l.pszMode);
+    else
+        fprintf(pFile, "null");
+
+    fprintf(pFile, ",\n  \"result\": \"%s\",\n", (report_l.result == kErrorOk) ? "ok" : "error");
+    fprintf(pFile, "  \"error\": %u,\n", (UINT)report_l.result);
+    fprintf(pFile, "  \"image_bytes\": %lu,\n", (unsigned long)report_l.imageSize);
+    fprintf(pFile, "  \"transfer_bytes\": %lu,\n", (unsigned long)report_l.transferSize);
+    fprintf(pFile, "  \"resume_offset\": %u,\n", report_l.resumeOffset);
+    fprintf(pFile, "  \"chunk_size\": %lu,\n", (unsigned long)report_l.chunkSize);
+    fprintf(pFile, "  \"chunks\": %u,\n", report_l.chunkCount);
+    fprintf(pFile, "  \"retries\": %u,\n", report_l.retryCount);
+    fprintf(pFile, "  \"busy\": %u,\n", report_l.busyCount);
+    fprintf(pFile, "  \"rate_limit_kbps\": ");
+    if (report_l.rateLimit != 0)
+        fprintf(pFile, "%u,\n", report_l.rateLimit);
+    else
+        fprintf(pFile, "null,\n");
+
+    fprintf(pFile, "  \"phases_ms\": {");
+    for (i = 0; i < kUpdatePhaseCount; i++)
+    {
+        fprintf(pFile, "%s\n    \"%s\": ", (i == 0) ? "" : ",", aUpdatePhaseName_l[i]);
+        if (report_l.validMask & (1U << i))
+            fprintf(pFile, "%.3f", (double)report_l.aPhaseTime[i] / 1000.0);
+        else
+            fprintf(pFile, "null");
+    }
+
+    fprintf(pFile, "\n  },\n  \"throughput_kbps\": ");
+    if (transferTime > 0)
+        fprintf(pFile, "%.1f", ((double)report_l.transferSize * 1000000.0) / (transferTime * 1024.0));
+    else
+        fprintf(pFile, "null");
+
+    fprintf(pFile, ",\n  \"chunk_rtt_us\": ");
+    if (count > 0)
+    {
+        for (i = 0; i < count; i++)
+            rttSum += report_l.pRtt[i];
+
+        fprintf(pFile, "{\n    \"count\": %u,\n", count);
+        fprintf(pFile, "    \"min\": %lu,\n", (unsigned long)report_l.pRtt[0]);
+        fprintf(pFile, "    \"mean\": %lu,\n", (unsigned long)(rttSum / count));
+        fprintf(pFile, "    \"p50\": %lu,\n", (unsigned long)report_l.pRtt[(count - 1) / 2]);
+        fprintf(pFile, "    \"p90\": %lu,\n",
+                (unsigned long)report_l.pRtt[((count - 1) * 90U) / 100U]);
+        fprintf(pFile, "    \"p99\": %lu,\n",
+                (unsigned long)report_l.pRtt[((count - 1) * 99U) / 100U]);
+        fprintf(pFile, "    \"max\": %lu\n  }", (unsigned long)report_l.pRtt[count - 1]);
+    }
+    else
+        fprintf(pFile, "null");
+
+    // Parameters for "fwimage calibrate"
+    fprintf(pFile, ",\n  \"timing_model\": ");
+    if (report_l.fFlashValid)
+    {
+        fprintf(pFile, "\"");
+        printTimingModel(pFile);
+        fprintf(pFile, "\"");
+    }
+    else
+        fprintf(pFile, "null");
+
+    fprintf(pFile, "\n}\n");
+
+    return (fclose(pFile) == 0) ? 0 : -1;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write JSON string
+
+The function writes a string as JSON string literal.
+
+\param  pFile_p         Output file
+\param  pszString_p     String to be written
+*/
+//------------------------------------------------------------------------------
+static void writeJsonString(FILE* pFile_p, const char* pszString_p)
+{
+    fputc('"', pFile_p);
+
+    for (; *pszString_p != '\0'; pszString_p++)
+    {
+        if ((*pszString_p == '"') || (*pszString_p == '\\'))
+            fprintf(pFile_p, "\\%c", *pszString_p);
+        else if ((unsigned char)*pszString_p < 0x20)
+            fprintf(pFile_p, "\\u%04X", (unsigned char)*pszString_p);
+        else
+            fputc(*pszString_p, pFile_p);
+    }
+
+    fputc('"', pFile_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Compare round trip times
+
+The function is the compare function for sorting round trip times.
+
+\param  pA_p            First round trip time
+\param  pB_p            Second round trip time
+
+\return The function returns the order of the round trip times.
+*/
+//------------------------------------------------------------------------------
+static int compareRtt(const void* pA_p, const void* pB_p)
+{
+    UINT32  a = *(const UINT32*)pA_p;
+    UINT32  b = *(const UINT32*)pB_p;
+
+    return (a > b) - (a < b);
+}
+
 /// \}
@@ -34,6 +34,9 @@
 
 ADD_DEFINITIONS(-D_CONSOLE -DWPCAP -DHAVE_REMOTE -D_CRT_SECURE_NO_WARNINGS)
 
+SET(CFG_FIRMWARE_TUNING_FILE "C:/ProgramData/firmware_update.tune" CACHE STRING
+    "File of tuned chunk sizes per card")
+
 ################################################################################
 # Set architecture specific sources and include directories
 
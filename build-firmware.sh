@@ -6,6 +6,7 @@
 # - Build Quartus project
 # - Build Nios II project
 # - Update SOF Bootloader
+# - Build the firmware image tool
 # - Update the firmware update image binary
 #
 # ./build-firmware.sh
@@ -19,6 +20,9 @@ NIOS2_PROJECT_PATH=drivers/altera-nios2/drv_daemon/build
 NIOS2_PROJECT_CREATEFILE=create-this-app
 NIOS2_PROJECT_MAKEFILE=Makefile
 
+FWIMAGE_TOOL_PATH=tools/fwimage
+FWIMAGE_BUILD_PATH=${FWIMAGE_TOOL_PATH}/build
+
 CREATE_UPDATE_IMAGE_PATH=tools/altera-nios2
 CREATE_UPDATE_IMAGE_FILE=create-update-image.sh
 UPDATE_FIRMWARE_IMAGE_FILE=image_hdr.bin
@@ -88,6 +92,29 @@ if [ $? -ne 0 ]; then
     exit 1
 fi
 
+# - Build the firmware image tool
+## A prebuilt tool can be given by FWIMAGE, otherwise it is built with CMake
+if [ -z "${FWIMAGE}" ]; then
+    echo "INFO: Run cmake and make in ${FWIMAGE_BUILD_PATH}..."
+
+    mkdir -p ${FWIMAGE_BUILD_PATH}
+    pushd ${FWIMAGE_BUILD_PATH} > /dev/null
+
+    cmake .. && make
+    if [ $? -ne 0 ]; then
+        echo "ERROR: Building firmware image tool failed!"
+        popd > /dev/null
+        exit 1
+    fi
+
+    popd > /dev/null
+
+    FWIMAGE=${BASE_DIR}/${FWIMAGE_BUILD_PATH}/fwimage
+fi
+
+## The image creator script takes the tool from FWIMAGE
+export FWIMAGE
+
 # - Update the firmware update image binary
 echo "INFO: Update firmware update image binary..."
 
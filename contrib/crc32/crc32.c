@@ -0,0 +1,434 @@
+/**
+********************************************************************************
+\file   crc32.c
+
+\brief  Fast CRC32 calculation
+
+This file implements the fast CRC32 calculation shared by the host tools and
+the PCP. On x86 processors with the PCLMULQDQ instruction, the data is folded
+by carry-less multiplication (Intel, "Fast CRC Computation for Generic
+Polynomials Using PCLMULQDQ Instruction"). Otherwise, and for the remaining
+bytes, a portable slicing-by-8 table implementation is used. Targets with
+little memory can reduce it to the byte-wise table by setting CRC32_SLICES
+to 1.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include "crc32.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CRC32_PCLMUL
+#define CRC32_PCLMUL_FUNC           __attribute__((target("pclmul,sse4.1")))
+#include <cpuid.h>
+#include <wmmintrin.h>
+#include <smmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define CRC32_PCLMUL
+#define CRC32_PCLMUL_FUNC
+#include <intrin.h>
+#endif
+
+//============================================================================//
+//            G L O B A L   D E F I N I T I O N S                             //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// module global vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// global function prototypes
+//------------------------------------------------------------------------------
+
+//============================================================================//
+//            P R I V A T E   D E F I N I T I O N S                           //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define CRC32_POLYNOMIAL            0xEDB88320  ///< Reflected CRC32 polynomial
+
+#ifndef CRC32_SLICES
+#define CRC32_SLICES                8           ///< Bytes processed per table step (1 or 8)
+#endif
+
+#if ((CRC32_SLICES != 1) && (CRC32_SLICES != 8))
+#error "CRC32_SLICES must be 1 or 8!"
+#endif
+
+#define CRC32_PCLMUL_MIN_LENGTH     64          ///< Minimum length for folding
+#define CRC32_PCLMUL_BLOCK_MASK     0x0F        ///< Folding works on 16 byte blocks
+
+#define CRC32_CPUID_ECX_PCLMUL      (1 << 1)    ///< CPUID.1:ECX PCLMULQDQ support
+#define CRC32_CPUID_ECX_SSE41       (1 << 19)   ///< CPUID.1:ECX SSE4.1 support
+
+//------------------------------------------------------------------------------
+// local types
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// local vars
+//------------------------------------------------------------------------------
+static uint32_t aaCrcTable_l[CRC32_SLICES][256];
+static int      fTableBuilt_l = 0;
+
+#ifdef CRC32_PCLMUL
+static int      pclmulSupport_l = -1;   // -1 until the CPU has been checked
+#endif
+
+//------------------------------------------------------------------------------
+// local function prototypes
+//------------------------------------------------------------------------------
+static void     buildTables(void);
+static uint32_t calcCrcTable(uint32_t crc_p, const uint8_t* pData_p, size_t length_p);
+
+#ifdef CRC32_PCLMUL
+static int      hasPclmul(void);
+static uint32_t calcCrcPclmul(uint32_t crc_p, const uint8_t* pData_p, size_t length_p);
+#endif
+
+//============================================================================//
+//            P U B L I C   F U N C T I O N S                                 //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+/**
+\brief  Calculate CRC
+
+The function calculates the CRC32 of the given data. The CRC is continued from
+the given value, thus the data can be processed chunk-wise.
+
+\param  crc_p       Start value (CRC32_INIT for a new CRC)
+\param  pData_p     Data
+\param  length_p    Length of data
+
+\return The function returns the updated CRC.
+*/
+//------------------------------------------------------------------------------
+uint32_t crc32_calc(uint32_t crc_p, const uint8_t* pData_p, size_t length_p)
+{
+#ifdef CRC32_PCLMUL
+    size_t  length;
+
+    if ((length_p >= CRC32_PCLMUL_MIN_LENGTH) && hasPclmul())
+    {
+        // Folding processes whole blocks, the rest is done by the tables
+        length = length_p & ~(size_t)CRC32_PCLMUL_BLOCK_MASK;
+        crc_p = calcCrcPclmul(crc_p, pData_p, length);
+        pData_p += length;
+        length_p -= length;
+    }
+#endif
+
+    return calcCrcTable(crc_p, pData_p, length_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get CRC implementation
+
+The function returns the name of the implementation used for long data on
+this machine.
+
+\return The function returns the name of the implementation.
+*/
+//------------------------------------------------------------------------------
+const char* crc32_getImplementation(void)
+{
+#ifdef CRC32_PCLMUL
+    if (hasPclmul())
+        return "pclmul";
+#endif
+
+    return (CRC32_SLICES == 8) ? "slicing-by-8" : "table";
+}
+
+//============================================================================//
+//            P R I V A T E   F U N C T I O N S                               //
+//============================================================================//
+/// \name Private Functions
+/// \{
+
+//------------------------------------------------------------------------------
+/**
+\brief  Build CRC tables
+
+The function builds the slicing tables. Table 0 is the byte-wise CRC table,
+table n continues the CRC of table n-1 by one zero byte.
+*/
+//------------------------------------------------------------------------------
+static void buildTables(void)
+{
+    uint32_t    crc;
+    unsigned    index;
+    unsigned    slice;
+    int         i;
+
+    for (index = 0; index < 256; index++)
+    {
+        crc = index;
+
+        for (i = 8; i; i--)
+            crc = (crc & 0x00000001) ? ((crc >> 1) ^ CRC32_POLYNOMIAL) : (crc >> 1);
+
+        aaCrcTable_l[0][index] = crc;
+    }
+
+    for (index = 0; index < 256; index++)
+    {
+        crc = aaCrcTable_l[0][index];
+
+        for (slice = 1; slice < CRC32_SLICES; slice++)
+        {
+            crc = aaCrcTable_l[0][crc & 0xFF] ^ (crc >> 8);
+            aaCrcTable_l[slice][index] = crc;
+        }
+    }
+
+    fTableBuilt_l = 1;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Calculate CRC by tables
+
+The function calculates the CRC by slicing-by-8, eight bytes are processed by
+one step of independent table lookups. With a single slice, the data is
+processed byte-wise.
+
+\param  crc_p       Start value
+\param  pData_p     Data
+\param  length_p    Length of data
+
+\return The function returns the updated CRC.
+*/
+//------------------------------------------------------------------------------
+static uint32_t calcCrcTable(uint32_t crc_p, const uint8_t* pData_p, size_t length_p)
+{
+#if (CRC32_SLICES == 8)
+    uint32_t    low;
+    uint32_t    high;
+#endif
+
+    if (!fTableBuilt_l)
+        buildTables();
+
+#if (CRC32_SLICES == 8)
+    while (length_p >= CRC32_SLICES)
+    {
+        low = crc_p ^ ((uint32_t)pData_p[0] | ((uint32_t)pData_p[1] << 8) |
+                       ((uint32_t)pData_p[2] << 16) | ((uint32_t)pData_p[3] << 24));
+        high = (uint32_t)pData_p[4] | ((uint32_t)pData_p[5] << 8) |
+               ((uint32_t)pData_p[6] << 16) | ((uint32_t)pData_p[7] << 24);
+
+        crc_p = aaCrcTable_l[7][low & 0xFF] ^
+                aaCrcTable_l[6][(low >> 8) & 0xFF] ^
+                aaCrcTable_l[5][(low >> 16) & 0xFF] ^
+                aaCrcTable_l[4][low >> 24] ^
+                aaCrcTable_l[3][high & 0xFF] ^
+                aaCrcTable_l[2][(high >> 8) & 0xFF] ^
+                aaCrcTable_l[1][(high >> 16) & 0xFF] ^
+                aaCrcTable_l[0][high >> 24];
+
+        pData_p += CRC32_SLICES;
+        length_p -= CRC32_SLICES;
+    }
+#endif
+
+    for (; length_p > 0; length_p--)
+        crc_p = aaCrcTable_l[0][(crc_p ^ *pData_p++) & 0xFF] ^ (crc_p >> 8);
+
+    return crc_p;
+}
+
+#ifdef CRC32_PCLMUL
+//------------------------------------------------------------------------------
+/**
+\brief  Check for PCLMULQDQ support
+
+The function checks once if the processor supports PCLMULQDQ and SSE4.1.
+
+\return The function returns 1 if the instructions are supported, otherwise 0.
+*/
+//------------------------------------------------------------------------------
+static int hasPclmul(void)
+{
+    unsigned int    ecx;
+
+    if (pclmulSupport_l >= 0)
+        return pclmulSupport_l;
+
+#if defined(_MSC_VER)
+    {
+        int aCpuInfo[4];
+
+        __cpuid(aCpuInfo, 1);
+        ecx = (unsigned int)aCpuInfo[2];
+    }
+#else
+    {
+        unsigned int eax;
+        unsigned int ebx;
+        unsigned int edx;
+
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+            ecx = 0;
+    }
+#endif
+
+    pclmulSupport_l = ((ecx & CRC32_CPUID_ECX_PCLMUL) && (ecx & CRC32_CPUID_ECX_SSE41)) ? 1 : 0;
+
+    return pclmulSupport_l;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Calculate CRC by carry-less multiplication
+
+The function folds the data in four parallel 128 bit lanes, reduces them to
+128 bit, folds the remaining 16 byte blocks and finally reduces the result by
+Barrett reduction. The constants are the bit-reflected ones of the paper.
+
+\param  crc_p       Start value
+\param  pData_p     Data, at least 64 bytes
+\param  length_p    Length of data, a multiple of 16 bytes
+
+\return The function returns the updated CRC.
+*/
+//------------------------------------------------------------------------------
+CRC32_PCLMUL_FUNC
+static uint32_t calcCrcPclmul(uint32_t crc_p, const uint8_t* pData_p, size_t length_p)
+{
+    static const uint64_t   aK1K2[2] = { 0x0154442BD4ULL, 0x01C6E41596ULL };
+    static const uint64_t   aK3K4[2] = { 0x01751997D0ULL, 0x00CCAA009EULL };
+    static const uint64_t   aK5K0[2] = { 0x0163CD6124ULL, 0x0000000000ULL };
+    static const uint64_t   aPoly[2] = { 0x01DB710641ULL, 0x01F7011641ULL };
+    __m128i                 x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+    x1 = _mm_loadu_si128((const __m128i*)(pData_p + 0x00));
+    x2 = _mm_loadu_si128((const __m128i*)(pData_p + 0x10));
+    x3 = _mm_loadu_si128((const __m128i*)(pData_p + 0x20));
+    x4 = _mm_loadu_si128((const __m128i*)(pData_p + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc_p));
+    x0 = _mm_loadu_si128((const __m128i*)aK1K2);
+
+    pData_p += 64;
+    length_p -= 64;
+
+    // Fold 64 byte blocks in parallel
+    while (length_p >= 64)
+    {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+                           _mm_loadu_si128((const __m128i*)(pData_p + 0x00)));
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+                           _mm_loadu_si128((const __m128i*)(pData_p + 0x10)));
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+                           _mm_loadu_si128((const __m128i*)(pData_p + 0x20)));
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+                           _mm_loadu_si128((const __m128i*)(pData_p + 0x30)));
+
+        pData_p += 64;
+        length_p -= 64;
+    }
+
+    // Fold the four lanes into one
+    x0 = _mm_loadu_si128((const __m128i*)aK3K4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Fold the remaining 16 byte blocks
+    while (length_p >= 16)
+    {
+        x2 = _mm_loadu_si128((const __m128i*)pData_p);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        pData_p += 16;
+        length_p -= 16;
+    }
+
+    // Reduce 128 bit to 64 bit
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i*)aK5K0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bit
+    x0 = _mm_loadu_si128((const __m128i*)aPoly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    return (uint32_t)_mm_extract_epi32(x1, 1);
+}
+#endif
+
+/// \}
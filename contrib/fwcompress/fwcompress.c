@@ -0,0 +1,641 @@
+/**
+********************************************************************************
+\file   fwcompress.c
+
+\brief  Firmware image compression
+
+This file implements the firmware image compression. The encoder is a greedy
+LZ4 block encoder with a single hash table, it is only used on the host. The
+streaming decoder accepts the stream in chunks of any size and forwards each
+decoded block to an output callback.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include "fwcompress.h"
+
+#include <string.h>
+
+//============================================================================//
+//            G L O B A L   D E F I N I T I O N S                             //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// module global vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// global function prototypes
+//------------------------------------------------------------------------------
+
+//============================================================================//
+//            P R I V A T E   D E F I N I T I O N S                           //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define FWCOMPRESS_MIN_MATCH        4
+#define FWCOMPRESS_MAX_OFFSET       0xFFFF
+#define FWCOMPRESS_HASH_BITS        12
+#define FWCOMPRESS_HASH_SIZE        (1 << FWCOMPRESS_HASH_BITS)
+
+//------------------------------------------------------------------------------
+// local types
+//------------------------------------------------------------------------------
+
+/**
+\brief Decoder states
+*/
+typedef enum
+{
+    kFwCompressStateStreamHeader    = 0,    ///< Receiving the stream header
+    kFwCompressStateBlockHeader     = 1,    ///< Receiving a block header
+    kFwCompressStateBlockData       = 2,    ///< Receiving the coded block
+    kFwCompressStateDone            = 3,    ///< Stream is complete
+
+} eFwCompressState;
+
+//------------------------------------------------------------------------------
+// local vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// local function prototypes
+//------------------------------------------------------------------------------
+static int      decodeBlock(tFwCompressDecoder* pDecoder_p, const uint8_t* pCoded_p,
+                            tFwCompressOutputCb pfnOutput_p, void* pArg_p);
+static size_t   compressBlock(const uint8_t* pSrc_p, size_t srcLength_p,
+                              uint8_t* pDst_p, size_t dstSize_p);
+static uint8_t* writeLength(uint8_t* pDst_p, uint8_t* pDstEnd_p, size_t length_p);
+static uint32_t readUint32(const uint8_t* pData_p);
+static void     writeUint32(uint8_t* pData_p, uint32_t value_p);
+
+//============================================================================//
+//            P U B L I C   F U N C T I O N S                                 //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check for compressed stream
+
+The function checks if the given data starts with a compressed stream header.
+
+\param  pData_p     Pointer to the start of the stream
+\param  length_p    Length of the given data
+
+\return The function returns 1 if the data is a compressed stream, otherwise 0.
+*/
+//------------------------------------------------------------------------------
+int fwcompress_isCompressed(const uint8_t* pData_p, size_t length_p)
+{
+    if ((pData_p == NULL) || (length_p < FWCOMPRESS_STREAM_HEADER_SIZE))
+        return 0;
+
+    return (readUint32(pData_p) == FWCOMPRESS_MAGIC);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Initialize decoder
+
+The function prepares the decoder for a new stream.
+
+\param  pDecoder_p      Pointer to the decoder
+\param  pInBuffer_p     Buffer for one coded block (FWCOMPRESS_BLOCK_SIZE)
+\param  pOutBuffer_p    Buffer for one decoded block (FWCOMPRESS_BLOCK_SIZE)
+*/
+//------------------------------------------------------------------------------
+void fwcompress_initDecoder(tFwCompressDecoder* pDecoder_p, uint8_t* pInBuffer_p,
+                            uint8_t* pOutBuffer_p)
+{
+    memset(pDecoder_p, 0, sizeof(tFwCompressDecoder));
+
+    pDecoder_p->pInBuffer = pInBuffer_p;
+    pDecoder_p->pOutBuffer = pOutBuffer_p;
+    pDecoder_p->state = kFwCompressStateStreamHeader;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Decode stream data
+
+The function decodes the next part of the stream. The data may be split at any
+position. Blocks which are completely contained in the given data are decoded
+in place, others are collected in the input buffer first.
+
+\param  pDecoder_p      Pointer to the decoder
+\param  pData_p         Stream data
+\param  length_p        Length of stream data
+\param  pfnOutput_p     Callback to forward the decoded data
+\param  pArg_p          Argument passed to the callback
+
+\return The function returns FWCOMPRESS_OK or a FWCOMPRESS_ERR_* code.
+*/
+//------------------------------------------------------------------------------
+int fwcompress_decode(tFwCompressDecoder* pDecoder_p, const uint8_t* pData_p,
+                      size_t length_p, tFwCompressOutputCb pfnOutput_p, void* pArg_p)
+{
+    size_t  copyLength;
+    size_t  headerSize;
+    int     ret;
+
+    while (length_p > 0)
+    {
+        switch (pDecoder_p->state)
+        {
+            case kFwCompressStateStreamHeader:
+            case kFwCompressStateBlockHeader:
+                headerSize = (pDecoder_p->state == kFwCompressStateStreamHeader) ?
+                             FWCOMPRESS_STREAM_HEADER_SIZE : FWCOMPRESS_BLOCK_HEADER_SIZE;
+
+                copyLength = headerSize - pDecoder_p->headerFill;
+                if (copyLength > length_p)
+                    copyLength = length_p;
+
+                memcpy(&pDecoder_p->aHeader[pDecoder_p->headerFill], pData_p, copyLength);
+                pDecoder_p->headerFill += copyLength;
+                pData_p += copyLength;
+                length_p -= copyLength;
+
+                if (pDecoder_p->headerFill < headerSize)
+                    break;
+
+                pDecoder_p->headerFill = 0;
+
+                if (pDecoder_p->state == kFwCompressStateStreamHeader)
+                {
+                    if (readUint32(pDecoder_p->aHeader) != FWCOMPRESS_MAGIC)
+                        return FWCOMPRESS_ERR_FORMAT;
+
+                    pDecoder_p->rawLength = readUint32(&pDecoder_p->aHeader[4]);
+                    pDecoder_p->state = (pDecoder_p->rawLength > 0) ?
+                                        kFwCompressStateBlockHeader : kFwCompressStateDone;
+                    break;
+                }
+
+                pDecoder_p->blockRawSize = pDecoder_p->aHeader[0] |
+                                           ((uint32_t)pDecoder_p->aHeader[1] << 8);
+                pDecoder_p->blockCodedSize = pDecoder_p->aHeader[2] |
+                                             ((uint32_t)pDecoder_p->aHeader[3] << 8);
+
+                if ((pDecoder_p->blockRawSize == 0) ||
+                    (pDecoder_p->blockRawSize > FWCOMPRESS_BLOCK_SIZE) ||
+                    (pDecoder_p->blockCodedSize == 0) ||
+                    (pDecoder_p->blockCodedSize > pDecoder_p->blockRawSize) ||
+                    (pDecoder_p->blockRawSize > (pDecoder_p->rawLength - pDecoder_p->decodedLength)))
+                    return FWCOMPRESS_ERR_FORMAT;
+
+                pDecoder_p->inFill = 0;
+                pDecoder_p->state = kFwCompressStateBlockData;
+                break;
+
+            case kFwCompressStateBlockData:
+                if ((pDecoder_p->inFill == 0) && (length_p >= pDecoder_p->blockCodedSize))
+                {
+                    // Complete block available, decode without copy
+                    ret = decodeBlock(pDecoder_p, pData_p, pfnOutput_p, pArg_p);
+                    pData_p += pDecoder_p->blockCodedSize;
+                    length_p -= pDecoder_p->blockCodedSize;
+                }
+                else
+                {
+                    copyLength = pDecoder_p->blockCodedSize - pDecoder_p->inFill;
+                    if (copyLength > length_p)
+                        copyLength = length_p;
+
+                    memcpy(&pDecoder_p->pInBuffer[pDecoder_p->inFill], pData_p, copyLength);
+                    pDecoder_p->inFill += copyLength;
+                    pData_p += copyLength;
+                    length_p -= copyLength;
+
+                    if (pDecoder_p->inFill < pDecoder_p->blockCodedSize)
+                        break;
+
+                    ret = decodeBlock(pDecoder_p, pDecoder_p->pInBuffer, pfnOutput_p, pArg_p);
+                }
+
+                if (ret != FWCOMPRESS_OK)
+                    return ret;
+
+                pDecoder_p->decodedLength += pDecoder_p->blockRawSize;
+                pDecoder_p->state = (pDecoder_p->decodedLength < pDecoder_p->rawLength) ?
+                                    kFwCompressStateBlockHeader : kFwCompressStateDone;
+                break;
+
+            case kFwCompressStateDone:
+            default:
+                return FWCOMPRESS_ERR_OVERFLOW;
+        }
+    }
+
+    return FWCOMPRESS_OK;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check if stream is complete
+
+\param  pDecoder_p      Pointer to the decoder
+
+\return The function returns 1 if the complete stream was decoded, otherwise 0.
+*/
+//------------------------------------------------------------------------------
+int fwcompress_isComplete(const tFwCompressDecoder* pDecoder_p)
+{
+    return (pDecoder_p->state == kFwCompressStateDone);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get maximum compressed size
+
+\param  rawLength_p     Uncompressed length
+
+\return The function returns the buffer size needed by fwcompress_compress().
+*/
+//------------------------------------------------------------------------------
+size_t fwcompress_getMaxCompressedSize(size_t rawLength_p)
+{
+    size_t blockCount = (rawLength_p + FWCOMPRESS_BLOCK_SIZE - 1) / FWCOMPRESS_BLOCK_SIZE;
+
+    return FWCOMPRESS_STREAM_HEADER_SIZE + (blockCount * FWCOMPRESS_BLOCK_HEADER_SIZE) +
+           rawLength_p;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Compress data
+
+The function compresses the given data into a stream. Blocks which do not
+shrink are stored.
+
+\param  pSrc_p          Data to be compressed
+\param  srcLength_p     Length of data
+\param  pDst_p          Buffer for the stream
+\param  dstSize_p       Size of buffer, see fwcompress_getMaxCompressedSize()
+
+\return The function returns the length of the stream, or 0 if the buffer is
+        too small.
+*/
+//------------------------------------------------------------------------------
+size_t fwcompress_compress(const uint8_t* pSrc_p, size_t srcLength_p,
+                           uint8_t* pDst_p, size_t dstSize_p)
+{
+    size_t  pos = FWCOMPRESS_STREAM_HEADER_SIZE;
+    size_t  blockSize;
+    size_t  codedSize;
+
+    if ((dstSize_p < fwcompress_getMaxCompressedSize(srcLength_p)) ||
+        (srcLength_p > UINT32_MAX))
+        return 0;
+
+    writeUint32(pDst_p, FWCOMPRESS_MAGIC);
+    writeUint32(pDst_p + 4, (uint32_t)srcLength_p);
+
+    while (srcLength_p > 0)
+    {
+        blockSize = (srcLength_p > FWCOMPRESS_BLOCK_SIZE) ? FWCOMPRESS_BLOCK_SIZE : srcLength_p;
+
+        // A coded block must be smaller than the raw block, otherwise store it
+        codedSize = compressBlock(pSrc_p, blockSize, pDst_p + pos + FWCOMPRESS_BLOCK_HEADER_SIZE,
+                                  blockSize - 1);
+        if (codedSize == 0)
+        {
+            memcpy(pDst_p + pos + FWCOMPRESS_BLOCK_HEADER_SIZE, pSrc_p, blockSize);
+            codedSize = blockSize;
+        }
+
+        pDst_p[pos + 0] = (uint8_t)blockSize;
+        pDst_p[pos + 1] = (uint8_t)(blockSize >> 8);
+        pDst_p[pos + 2] = (uint8_t)codedSize;
+        pDst_p[pos + 3] = (uint8_t)(codedSize >> 8);
+
+        pos += FWCOMPRESS_BLOCK_HEADER_SIZE + codedSize;
+        pSrc_p += blockSize;
+        srcLength_p -= blockSize;
+    }
+
+    return pos;
+}
+
+//============================================================================//
+//            P R I V A T E   F U N C T I O N S                               //
+//============================================================================//
+/// \name Private Functions
+/// \{
+
+//------------------------------------------------------------------------------
+/**
+\brief  Decode block
+
+The function decodes a complete coded block and forwards it to the output
+callback.
+
+\param  pDecoder_p      Pointer to the decoder
+\param  pCoded_p        Coded block
+\param  pfnOutput_p     Callback to forward the decoded data
+\param  pArg_p          Argument passed to the callback
+
+\return The function returns FWCOMPRESS_OK or a FWCOMPRESS_ERR_* code.
+*/
+//------------------------------------------------------------------------------
+static int decodeBlock(tFwCompressDecoder* pDecoder_p, const uint8_t* pCoded_p,
+                       tFwCompressOutputCb pfnOutput_p, void* pArg_p)
+{
+    const uint8_t*  pIn = pCoded_p;
+    const uint8_t*  pInEnd = pCoded_p + pDecoder_p->blockCodedSize;
+    uint8_t*        pOut = pDecoder_p->pOutBuffer;
+    uint8_t*        pOutEnd = pDecoder_p->pOutBuffer + pDecoder_p->blockRawSize;
+    const uint8_t*  pMatch;
+    size_t          length;
+    size_t          offset;
+    uint8_t         token;
+    uint8_t         value;
+
+    if (pDecoder_p->blockCodedSize == pDecoder_p->blockRawSize)
+    {
+        // Stored block
+        pOut = (uint8_t*)pCoded_p;
+        goto Exit;
+    }
+
+    while (pIn < pInEnd)
+    {
+        token = *pIn++;
+
+        // Literals
+        length = token >> 4;
+        if (length == 15)
+        {
+            do
+            {
+                if (pIn >= pInEnd)
+                    return FWCOMPRESS_ERR_FORMAT;
+                value = *pIn++;
+                length += value;
+            } while (value == 255);
+        }
+
+        if ((length > (size_t)(pInEnd - pIn)) || (length > (size_t)(pOutEnd - pOut)))
+            return FWCOMPRESS_ERR_FORMAT;
+
+        memcpy(pOut, pIn, length);
+        pIn += length;
+        pOut += length;
+
+        // The last sequence only consists of literals
+        if (pIn == pInEnd)
+            break;
+
+        // Match
+        if ((pInEnd - pIn) < 2)
+            return FWCOMPRESS_ERR_FORMAT;
+
+        offset = pIn[0] | ((size_t)pIn[1] << 8);
+        pIn += 2;
+
+        if ((offset == 0) || (offset > (size_t)(pOut - pDecoder_p->pOutBuffer)))
+            return FWCOMPRESS_ERR_FORMAT;
+
+        length = token & 0x0F;
+        if (length == 15)
+        {
+            do
+            {
+                if (pIn >= pInEnd)
+                    return FWCOMPRESS_ERR_FORMAT;
+                value = *pIn++;
+                length += value;
+            } while (value == 255);
+        }
+
+        length += FWCOMPRESS_MIN_MATCH;
+        if (length > (size_t)(pOutEnd - pOut))
+            return FWCOMPRESS_ERR_FORMAT;
+
+        // Matches may overlap the output, thus copy bytewise
+        pMatch = pOut - offset;
+        while (length-- > 0)
+            *pOut++ = *pMatch++;
+    }
+
+    if (pOut != pOutEnd)
+        return FWCOMPRESS_ERR_FORMAT;
+
+    pOut = pDecoder_p->pOutBuffer;
+
+Exit:
+    if (pfnOutput_p(pArg_p, pOut, pDecoder_p->blockRawSize) != 0)
+        return FWCOMPRESS_ERR_OUTPUT;
+
+    return FWCOMPRESS_OK;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Compress block
+
+The function codes a single block with LZ4 sequences.
+
+\param  pSrc_p          Block to be compressed
+\param  srcLength_p     Length of block
+\param  pDst_p          Buffer for the coded block
+\param  dstSize_p       Size of buffer
+
+\return The function returns the coded size, or 0 if it exceeds the buffer.
+*/
+//------------------------------------------------------------------------------
+static size_t compressBlock(const uint8_t* pSrc_p, size_t srcLength_p,
+                            uint8_t* pDst_p, size_t dstSize_p)
+{
+    int32_t         aHashTable[FWCOMPRESS_HASH_SIZE];
+    uint8_t*        pOut = pDst_p;
+    uint8_t*        pOutEnd = pDst_p + dstSize_p;
+    size_t          anchor = 0;
+    size_t          pos = 0;
+    size_t          matchLength;
+    size_t          literalLength;
+    uint32_t        hash;
+    int32_t         ref;
+    uint8_t*        pToken;
+
+    memset(aHashTable, 0xFF, sizeof(aHashTable));
+
+    while ((pos + FWCOMPRESS_MIN_MATCH) <= srcLength_p)
+    {
+        hash = (readUint32(pSrc_p + pos) * 2654435761U) >> (32 - FWCOMPRESS_HASH_BITS);
+        ref = aHashTable[hash];
+        aHashTable[hash] = (int32_t)pos;
+
+        if ((ref < 0) || ((pos - (size_t)ref) > FWCOMPRESS_MAX_OFFSET) ||
+            (memcmp(pSrc_p + ref, pSrc_p + pos, FWCOMPRESS_MIN_MATCH) != 0))
+        {
+            pos++;
+            continue;
+        }
+
+        matchLength = FWCOMPRESS_MIN_MATCH;
+        while (((pos + matchLength) < srcLength_p) &&
+               (pSrc_p[ref + matchLength] == pSrc_p[pos + matchLength]))
+            matchLength++;
+
+        // Token, literals and offset
+        literalLength = pos - anchor;
+        if (pOut >= pOutEnd)
+            return 0;
+        pToken = pOut++;
+        *pToken = (uint8_t)(((literalLength < 15) ? literalLength : 15) << 4);
+
+        if (literalLength >= 15)
+        {
+            pOut = writeLength(pOut, pOutEnd, literalLength - 15);
+            if (pOut == NULL)
+                return 0;
+        }
+
+        if ((size_t)(pOutEnd - pOut) < (literalLength + 2))
+            return 0;
+
+        memcpy(pOut, pSrc_p + anchor, literalLength);
+        pOut += literalLength;
+        *pOut++ = (uint8_t)(pos - ref);
+        *pOut++ = (uint8_t)((pos - ref) >> 8);
+
+        // Match length
+        *pToken |= (uint8_t)(((matchLength - FWCOMPRESS_MIN_MATCH) < 15) ?
+                             (matchLength - FWCOMPRESS_MIN_MATCH) : 15);
+
+        if ((matchLength - FWCOMPRESS_MIN_MATCH) >= 15)
+        {
+            pOut = writeLength(pOut, pOutEnd, matchLength - FWCOMPRESS_MIN_MATCH - 15);
+            if (pOut == NULL)
+                return 0;
+        }
+
+        pos += matchLength;
+        anchor = pos;
+    }
+
+    // Last literals
+    literalLength = srcLength_p - anchor;
+    if (literalLength > 0)
+    {
+        if (pOut >= pOutEnd)
+            return 0;
+        pToken = pOut++;
+        *pToken = (uint8_t)(((literalLength < 15) ? literalLength : 15) << 4);
+
+        if (literalLength >= 15)
+        {
+            pOut = writeLength(pOut, pOutEnd, literalLength - 15);
+            if (pOut == NULL)
+                return 0;
+        }
+
+        if ((size_t)(pOutEnd - pOut) < literalLength)
+            return 0;
+
+        memcpy(pOut, pSrc_p + anchor, literalLength);
+        pOut += literalLength;
+    }
+
+    return (size_t)(pOut - pDst_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write length extension
+
+The function writes the extension bytes of a literal or match length.
+
+\param  pDst_p          Output position
+\param  pDstEnd_p       End of output buffer
+\param  length_p        Remaining length to be written
+
+\return The function returns the new output position, or NULL if the buffer is
+        too small.
+*/
+//------------------------------------------------------------------------------
+static uint8_t* writeLength(uint8_t* pDst_p, uint8_t* pDstEnd_p, size_t length_p)
+{
+    while (length_p >= 255)
+    {
+        if (pDst_p >= pDstEnd_p)
+            return NULL;
+        *pDst_p++ = 255;
+        length_p -= 255;
+    }
+
+    if (pDst_p >= pDstEnd_p)
+        return NULL;
+    *pDst_p++ = (uint8_t)length_p;
+
+    return pDst_p;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read little endian 32 bit value
+
+\param  pData_p     Pointer to the value
+
+\return The function returns the value.
+*/
+//------------------------------------------------------------------------------
+static uint32_t readUint32(const uint8_t* pData_p)
+{
+    return (uint32_t)pData_p[0] | ((uint32_t)pData_p[1] << 8) |
+           ((uint32_t)pData_p[2] << 16) | ((uint32_t)pData_p[3] << 24);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write little endian 32 bit value
+
+\param  pData_p     Pointer to the value
+\param  value_p     Value to be written
+*/
+//------------------------------------------------------------------------------
+static void writeUint32(uint8_t* pData_p, uint32_t value_p)
+{
+    pData_p[0] = (uint8_t)value_p;
+    pData_p[1] = (uint8_t)(value_p >> 8);
+    pData_p[2] = (uint8_t)(value_p >> 16);
+    pData_p[3] = (uint8_t)(value_p >> 24);
+}
+
+/// \}
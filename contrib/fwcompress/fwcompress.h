@@ -0,0 +1,130 @@
+/**
+********************************************************************************
+\file   fwcompress.h
+
+\brief  Firmware image compression
+
+This file contains the definitions of the firmware image compression. The
+codec is shared by the host tools and the PCP driver.
+
+A compressed stream starts with an 8 byte stream header (magic, uncompressed
+length) followed by independent blocks of up to FWCOMPRESS_BLOCK_SIZE bytes.
+Each block has a 4 byte header (uncompressed size, coded size) and is either
+stored (coded size equals uncompressed size) or coded with LZ4 block sequences.
+Matches never reach into a previous block, thus the decoder only needs one
+block of input and output buffer. All values are little endian.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+#ifndef _INC_fwcompress_H_
+#define _INC_fwcompress_H_
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define FWCOMPRESS_MAGIC                0x315A5746  ///< Stream magic "FWZ1"
+#define FWCOMPRESS_BLOCK_SIZE           4096        ///< Maximum uncompressed block size
+#define FWCOMPRESS_STREAM_HEADER_SIZE   8           ///< Size of stream header
+#define FWCOMPRESS_BLOCK_HEADER_SIZE    4           ///< Size of block header
+
+#define FWCOMPRESS_OK                   0           ///< No error
+#define FWCOMPRESS_ERR_FORMAT           -1          ///< Invalid stream format
+#define FWCOMPRESS_ERR_OUTPUT           -2          ///< Output callback failed
+#define FWCOMPRESS_ERR_OVERFLOW         -3          ///< Data beyond the end of the stream
+
+//------------------------------------------------------------------------------
+// typedef
+//------------------------------------------------------------------------------
+
+/**
+\brief Decoder output callback
+
+The callback is called by the decoder for each decoded block.
+
+\param  pArg_p      Argument passed to fwcompress_decode()
+\param  pData_p     Decoded data
+\param  length_p    Length of decoded data
+
+\return The callback returns 0 on success, otherwise the decoding is aborted.
+*/
+typedef int (*tFwCompressOutputCb)(void* pArg_p, const uint8_t* pData_p, size_t length_p);
+
+/**
+\brief Decoder state
+
+The struct holds the state of a streaming decoder. The input and output block
+buffers are provided by the user.
+*/
+typedef struct
+{
+    uint8_t*    pInBuffer;          ///< Coded block buffer (FWCOMPRESS_BLOCK_SIZE)
+    uint8_t*    pOutBuffer;         ///< Decoded block buffer (FWCOMPRESS_BLOCK_SIZE)
+    uint8_t     aHeader[FWCOMPRESS_STREAM_HEADER_SIZE]; ///< Header being received
+    size_t      headerFill;         ///< Received header bytes
+    size_t      inFill;             ///< Received coded block bytes
+    uint32_t    rawLength;          ///< Uncompressed length of the stream
+    uint32_t    decodedLength;      ///< Decoded bytes so far
+    uint32_t    blockRawSize;       ///< Uncompressed size of current block
+    uint32_t    blockCodedSize;     ///< Coded size of current block
+    int         state;              ///< Decoder state
+} tFwCompressDecoder;
+
+//------------------------------------------------------------------------------
+// function prototypes
+//------------------------------------------------------------------------------
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int     fwcompress_isCompressed(const uint8_t* pData_p, size_t length_p);
+
+void    fwcompress_initDecoder(tFwCompressDecoder* pDecoder_p, uint8_t* pInBuffer_p,
+                               uint8_t* pOutBuffer_p);
+int     fwcompress_decode(tFwCompressDecoder* pDecoder_p, const uint8_t* pData_p,
+                          size_t length_p, tFwCompressOutputCb pfnOutput_p, void* pArg_p);
+int     fwcompress_isComplete(const tFwCompressDecoder* pDecoder_p);
+
+size_t  fwcompress_getMaxCompressedSize(size_t rawLength_p);
+size_t  fwcompress_compress(const uint8_t* pSrc_p, size_t srcLength_p,
+                            uint8_t* pDst_p, size_t dstSize_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INC_fwcompress_H_ */
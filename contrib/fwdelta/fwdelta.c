@@ -0,0 +1,814 @@
+/**
+********************************************************************************
+\file   fwdelta.c
+
+\brief  Firmware image delta patches
+
+This file implements the creation and the in-place application of firmware
+image delta patches. The applier accepts the delta split at any position and
+writes the target image through the given flash access functions. The encoder
+is only used on the host.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include "fwdelta.h"
+
+#include <crc32.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+//============================================================================//
+//            G L O B A L   D E F I N I T I O N S                             //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// module global vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// global function prototypes
+//------------------------------------------------------------------------------
+
+//============================================================================//
+//            P R I V A T E   D E F I N I T I O N S                           //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define FWDELTA_LITERAL_HEADER_SIZE     5
+#define FWDELTA_COPY_HEADER_SIZE        9
+
+#define FWDELTA_HASH_BITS               16
+#define FWDELTA_HASH_SIZE               (1 << FWDELTA_HASH_BITS)
+#define FWDELTA_HASH_LENGTH             8
+#define FWDELTA_MAX_CANDIDATES          32
+
+//------------------------------------------------------------------------------
+// local types
+//------------------------------------------------------------------------------
+
+/**
+\brief Applier states
+*/
+typedef enum
+{
+    kFwDeltaStateHeader         = 0,    ///< Receiving the delta header
+    kFwDeltaStateOpHeader       = 1,    ///< Receiving an operation header
+    kFwDeltaStateLiteral        = 2,    ///< Receiving literal data
+    kFwDeltaStateDone           = 3,    ///< Target image is complete
+    kFwDeltaStateError          = 4,    ///< Applying the delta failed
+
+} eFwDeltaState;
+
+/**
+\brief Encoder output
+*/
+typedef struct
+{
+    uint8_t*    pData;                  ///< Output buffer
+    size_t      size;                   ///< Size of output buffer
+    size_t      pos;                    ///< Current output position
+    int         fOverflow;              ///< Output buffer too small
+} tFwDeltaOutput;
+
+//------------------------------------------------------------------------------
+// local vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// local function prototypes
+//------------------------------------------------------------------------------
+static int      parseHeader(tFwDeltaApplier* pApplier_p);
+static int      parseOpHeader(tFwDeltaApplier* pApplier_p);
+static int      prepareSector(tFwDeltaApplier* pApplier_p);
+static int      writeTarget(tFwDeltaApplier* pApplier_p, const uint8_t* pData_p, size_t length_p);
+static int      copyFromBase(tFwDeltaApplier* pApplier_p, uint32_t offset_p, uint32_t length_p);
+static size_t   getMatchLength(const uint8_t* pA_p, const uint8_t* pB_p, size_t maxLength_p);
+static uint32_t hashBytes(const uint8_t* pData_p);
+static void     emitLiteral(tFwDeltaOutput* pOut_p, const uint8_t* pData_p, size_t length_p);
+static void     emitCopy(tFwDeltaOutput* pOut_p, uint32_t offset_p, uint32_t length_p);
+static void     emitBytes(tFwDeltaOutput* pOut_p, const void* pData_p, size_t length_p);
+static void     emitUint32(tFwDeltaOutput* pOut_p, uint32_t value_p);
+static uint32_t readUint32(const uint8_t* pData_p);
+
+//============================================================================//
+//            P U B L I C   F U N C T I O N S                                 //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check for delta
+
+The function checks if the given data starts with a delta header.
+
+\param  pData_p     Pointer to the start of the data
+\param  length_p    Length of the given data
+
+\return The function returns 1 if the data is a delta, otherwise 0.
+*/
+//------------------------------------------------------------------------------
+int fwdelta_isDelta(const uint8_t* pData_p, size_t length_p)
+{
+    if ((pData_p == NULL) || (length_p < FWDELTA_HEADER_SIZE))
+        return 0;
+
+    return (readUint32(pData_p) == FWDELTA_MAGIC);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Initialize applier
+
+The function prepares the applier for a new delta.
+
+\param  pApplier_p      Pointer to the applier
+\param  pFlashOps_p     Functions to access the update region
+\param  pSectorBuffer_p Buffer for the old content of one sector
+\param  sectorSize_p    Flash sector size
+*/
+//------------------------------------------------------------------------------
+void fwdelta_initApplier(tFwDeltaApplier* pApplier_p, const tFwDeltaFlashOps* pFlashOps_p,
+                         uint8_t* pSectorBuffer_p, uint32_t sectorSize_p)
+{
+    memset(pApplier_p, 0, sizeof(tFwDeltaApplier));
+
+    pApplier_p->flashOps = *pFlashOps_p;
+    pApplier_p->pSectorBuffer = pSectorBuffer_p;
+    pApplier_p->sectorSize = sectorSize_p;
+    pApplier_p->targetCrc = CRC32_INIT;
+    pApplier_p->state = kFwDeltaStateHeader;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Apply delta data
+
+The function applies the next part of the delta. The base image is checked
+against the header before the first sector is erased.
+
+\param  pApplier_p      Pointer to the applier
+\param  pData_p         Delta data
+\param  length_p        Length of delta data
+
+\return The function returns FWDELTA_OK or a FWDELTA_ERR_* code.
+*/
+//------------------------------------------------------------------------------
+int fwdelta_apply(tFwDeltaApplier* pApplier_p, const uint8_t* pData_p, size_t length_p)
+{
+    size_t  headerSize;
+    size_t  copyLength;
+    int     ret = FWDELTA_OK;
+
+    while ((length_p > 0) && (ret == FWDELTA_OK))
+    {
+        switch (pApplier_p->state)
+        {
+            case kFwDeltaStateHeader:
+            case kFwDeltaStateOpHeader:
+                if (pApplier_p->state == kFwDeltaStateHeader)
+                    headerSize = FWDELTA_HEADER_SIZE;
+                else if (pApplier_p->opHeaderFill > 0)
+                    headerSize = (pApplier_p->aOpHeader[0] == FWDELTA_OP_COPY) ?
+                                 FWDELTA_COPY_HEADER_SIZE : FWDELTA_LITERAL_HEADER_SIZE;
+                else
+                    headerSize = (pData_p[0] == FWDELTA_OP_COPY) ?
+                                 FWDELTA_COPY_HEADER_SIZE : FWDELTA_LITERAL_HEADER_SIZE;
+
+                copyLength = headerSize - pApplier_p->opHeaderFill;
+                if (copyLength > length_p)
+                    copyLength = length_p;
+
+                memcpy(&pApplier_p->aOpHeader[pApplier_p->opHeaderFill], pData_p, copyLength);
+                pApplier_p->opHeaderFill += copyLength;
+                pData_p += copyLength;
+                length_p -= copyLength;
+
+                if (pApplier_p->opHeaderFill < headerSize)
+                    break;
+
+                pApplier_p->opHeaderFill = 0;
+
+                if (pApplier_p->state == kFwDeltaStateHeader)
+                    ret = parseHeader(pApplier_p);
+                else
+                    ret = parseOpHeader(pApplier_p);
+                break;
+
+            case kFwDeltaStateLiteral:
+                copyLength = pApplier_p->opLength;
+                if (copyLength > length_p)
+                    copyLength = length_p;
+
+                ret = writeTarget(pApplier_p, pData_p, copyLength);
+                pData_p += copyLength;
+                length_p -= copyLength;
+                pApplier_p->opLength -= (uint32_t)copyLength;
+
+                if (pApplier_p->opLength == 0)
+                {
+                    pApplier_p->state = (pApplier_p->outOffset < pApplier_p->header.targetLength) ?
+                                        kFwDeltaStateOpHeader : kFwDeltaStateDone;
+                }
+                break;
+
+            case kFwDeltaStateDone:
+            case kFwDeltaStateError:
+            default:
+                ret = FWDELTA_ERR_FORMAT;
+                break;
+        }
+    }
+
+    if (ret != FWDELTA_OK)
+        pApplier_p->state = kFwDeltaStateError;
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Finish delta
+
+The function checks that the complete target image was written and that its
+CRC matches the header.
+
+\param  pApplier_p      Pointer to the applier
+
+\return The function returns FWDELTA_OK or a FWDELTA_ERR_* code.
+*/
+//------------------------------------------------------------------------------
+int fwdelta_finish(tFwDeltaApplier* pApplier_p)
+{
+    if (pApplier_p->state != kFwDeltaStateDone)
+        return FWDELTA_ERR_FORMAT;
+
+    if (pApplier_p->targetCrc != pApplier_p->header.targetCrc)
+        return FWDELTA_ERR_TARGET;
+
+    return FWDELTA_OK;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Create delta
+
+The function creates a delta which transforms the base image into the target
+image. Copies are searched at the same offset first, then with a hash table of
+the base image. A copy never reads from a sector before the sector of its
+target offset and never crosses a target sector boundary.
+
+\param  pBase_p         Base image
+\param  baseLength_p    Length of base image
+\param  pTarget_p       Target image
+\param  targetLength_p  Length of target image
+\param  sectorSize_p    Sector size of the flash
+\param  pDelta_p        Buffer for the delta
+\param  deltaSize_p     Size of buffer
+
+\return The function returns the length of the delta, or 0 on error.
+*/
+//------------------------------------------------------------------------------
+size_t fwdelta_create(const uint8_t* pBase_p, size_t baseLength_p,
+                      const uint8_t* pTarget_p, size_t targetLength_p,
+                      uint32_t sectorSize_p, uint8_t* pDelta_p, size_t deltaSize_p)
+{
+    tFwDeltaOutput  out;
+    int32_t*        pHead;
+    int32_t*        pNext = NULL;
+    size_t          pos = 0;
+    size_t          literalStart = 0;
+    size_t          sectorStart;
+    size_t          maxLength;
+    size_t          bestLength;
+    size_t          bestOffset = 0;
+    size_t          length;
+    size_t          i;
+    int32_t         candidate;
+    int             tries;
+
+    if ((sectorSize_p == 0) || (baseLength_p > INT32_MAX) || (targetLength_p > UINT32_MAX))
+        return 0;
+
+    pHead = (int32_t*)malloc(FWDELTA_HASH_SIZE * sizeof(int32_t));
+    if (baseLength_p > 0)
+        pNext = (int32_t*)malloc(baseLength_p * sizeof(int32_t));
+
+    if ((pHead == NULL) || ((baseLength_p > 0) && (pNext == NULL)))
+    {
+        free(pHead);
+        free(pNext);
+        return 0;
+    }
+
+    // Index the base image, the chains hold descending offsets
+    memset(pHead, 0xFF, FWDELTA_HASH_SIZE * sizeof(int32_t));
+    for (i = 0; (i + FWDELTA_HASH_LENGTH) <= baseLength_p; i++)
+    {
+        uint32_t hash = hashBytes(pBase_p + i);
+
+        pNext[i] = pHead[hash];
+        pHead[hash] = (int32_t)i;
+    }
+
+    out.pData = pDelta_p;
+    out.size = deltaSize_p;
+    out.pos = 0;
+    out.fOverflow = 0;
+
+    emitUint32(&out, FWDELTA_MAGIC);
+    emitUint32(&out, (uint32_t)baseLength_p);
+    emitUint32(&out, crc32_calc(CRC32_INIT, pBase_p, baseLength_p));
+    emitUint32(&out, (uint32_t)targetLength_p);
+    emitUint32(&out, crc32_calc(CRC32_INIT, pTarget_p, targetLength_p));
+    emitUint32(&out, sectorSize_p);
+
+    while (pos < targetLength_p)
+    {
+        sectorStart = (pos / sectorSize_p) * sectorSize_p;
+        maxLength = sectorStart + sectorSize_p - pos;
+        if (maxLength > (targetLength_p - pos))
+            maxLength = targetLength_p - pos;
+
+        // Unchanged data at the same offset is the most likely match
+        bestLength = 0;
+        if (pos < baseLength_p)
+        {
+            length = (maxLength < (baseLength_p - pos)) ? maxLength : (baseLength_p - pos);
+            bestLength = getMatchLength(pBase_p + pos, pTarget_p + pos, length);
+            bestOffset = pos;
+        }
+
+        if ((bestLength < maxLength) && ((pos + FWDELTA_HASH_LENGTH) <= targetLength_p))
+        {
+            candidate = pHead[hashBytes(pTarget_p + pos)];
+
+            for (tries = 0; (candidate >= 0) && (tries < FWDELTA_MAX_CANDIDATES); tries++)
+            {
+                // Sectors before the current one are already erased
+                if ((size_t)candidate < sectorStart)
+                    break;
+
+                length = baseLength_p - (size_t)candidate;
+                if (length > maxLength)
+                    length = maxLength;
+
+                length = getMatchLength(pBase_p + candidate, pTarget_p + pos, length);
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestOffset = (size_t)candidate;
+                }
+
+                candidate = pNext[candidate];
+            }
+        }
+
+        if (bestLength >= FWDELTA_MIN_COPY)
+        {
+            emitLiteral(&out, pTarget_p + literalStart, pos - literalStart);
+            emitCopy(&out, (uint32_t)bestOffset, (uint32_t)bestLength);
+            pos += bestLength;
+            literalStart = pos;
+        }
+        else
+            pos++;
+    }
+
+    emitLiteral(&out, pTarget_p + literalStart, pos - literalStart);
+
+    free(pHead);
+    free(pNext);
+
+    return out.fOverflow ? 0 : out.pos;
+}
+
+//============================================================================//
+//            P R I V A T E   F U N C T I O N S                               //
+//============================================================================//
+/// \name Private Functions
+/// \{
+
+//------------------------------------------------------------------------------
+/**
+\brief  Parse delta header
+
+The function parses the received delta header and checks the base image in the
+update region.
+
+\param  pApplier_p      Pointer to the applier
+
+\return The function returns FWDELTA_OK or a FWDELTA_ERR_* code.
+*/
+//------------------------------------------------------------------------------
+static int parseHeader(tFwDeltaApplier* pApplier_p)
+{
+    tFwDeltaHeader* pHeader = &pApplier_p->header;
+    const uint8_t*  pData = pApplier_p->aOpHeader;
+    uint32_t        crc = CRC32_INIT;
+    uint32_t        offset;
+    size_t          length;
+
+    pHeader->magic = readUint32(pData);
+    pHeader->baseLength = readUint32(pData + 4);
+    pHeader->baseCrc = readUint32(pData + 8);
+    pHeader->targetLength = readUint32(pData + 12);
+    pHeader->targetCrc = readUint32(pData + 16);
+    pHeader->sectorSize = readUint32(pData + 20);
+
+    if ((pHeader->magic != FWDELTA_MAGIC) || (pHeader->sectorSize != pApplier_p->sectorSize))
+        return FWDELTA_ERR_FORMAT;
+
+    // The delta only fits to the base it was created from
+    for (offset = 0; offset < pHeader->baseLength; offset += (uint32_t)length)
+    {
+        length = pHeader->baseLength - offset;
+        if (length > sizeof(pApplier_p->aCopyBuffer))
+            length = sizeof(pApplier_p->aCopyBuffer);
+
+        if (pApplier_p->flashOps.pfnRead(pApplier_p->flashOps.pArg, offset,
+                                         pApplier_p->aCopyBuffer, length) != 0)
+            return FWDELTA_ERR_FLASH;
+
+        crc = crc32_calc(crc, pApplier_p->aCopyBuffer, length);
+    }
+
+    if (crc != pHeader->baseCrc)
+        return FWDELTA_ERR_BASE;
+
+    pApplier_p->state = (pHeader->targetLength > 0) ? kFwDeltaStateOpHeader : kFwDeltaStateDone;
+
+    return FWDELTA_OK;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Parse operation header
+
+The function parses the received operation header. Copies are executed
+immediately.
+
+\param  pApplier_p      Pointer to the applier
+
+\return The function returns FWDELTA_OK or a FWDELTA_ERR_* code.
+*/
+//------------------------------------------------------------------------------
+static int parseOpHeader(tFwDeltaApplier* pApplier_p)
+{
+    const uint8_t*  pData = pApplier_p->aOpHeader;
+    uint32_t        remaining = pApplier_p->header.targetLength - pApplier_p->outOffset;
+    uint32_t        offset;
+    uint32_t        length;
+    int             ret;
+
+    switch (pData[0])
+    {
+        case FWDELTA_OP_LITERAL:
+            length = readUint32(pData + 1);
+            if ((length == 0) || (length > remaining))
+                return FWDELTA_ERR_FORMAT;
+
+            pApplier_p->opLength = length;
+            pApplier_p->state = kFwDeltaStateLiteral;
+            return FWDELTA_OK;
+
+        case FWDELTA_OP_COPY:
+            offset = readUint32(pData + 1);
+            length = readUint32(pData + 5);
+            if ((length == 0) || (length > remaining) ||
+                (offset > pApplier_p->header.baseLength) ||
+                (length > (pApplier_p->header.baseLength - offset)))
+                return FWDELTA_ERR_FORMAT;
+
+            ret = copyFromBase(pApplier_p, offset, length);
+            if (ret != FWDELTA_OK)
+                return ret;
+
+            if (pApplier_p->outOffset == pApplier_p->header.targetLength)
+                pApplier_p->state = kFwDeltaStateDone;
+            return FWDELTA_OK;
+
+        default:
+            return FWDELTA_ERR_FORMAT;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Prepare sector
+
+The function erases the sector of the next target byte if it is not erased yet.
+The old content of the sector is kept in the sector buffer before.
+
+\param  pApplier_p      Pointer to the applier
+
+\return The function returns FWDELTA_OK or a FWDELTA_ERR_* code.
+*/
+//------------------------------------------------------------------------------
+static int prepareSector(tFwDeltaApplier* pApplier_p)
+{
+    uint32_t    offset = pApplier_p->erasedEnd;
+    size_t      length;
+
+    if (pApplier_p->outOffset < offset)
+        return FWDELTA_OK;
+
+    // Only keep the part which belongs to the base image
+    if (offset < pApplier_p->header.baseLength)
+    {
+        length = pApplier_p->header.baseLength - offset;
+        if (length > pApplier_p->sectorSize)
+            length = pApplier_p->sectorSize;
+
+        if (pApplier_p->flashOps.pfnRead(pApplier_p->flashOps.pArg, offset,
+                                         pApplier_p->pSectorBuffer, length) != 0)
+            return FWDELTA_ERR_FLASH;
+    }
+
+    if (pApplier_p->flashOps.pfnErase(pApplier_p->flashOps.pArg, offset) != 0)
+        return FWDELTA_ERR_FLASH;
+
+    pApplier_p->bufferOffset = offset;
+    pApplier_p->erasedEnd = offset + pApplier_p->sectorSize;
+
+    return FWDELTA_OK;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write target data
+
+The function writes data at the current target offset.
+
+\param  pApplier_p      Pointer to the applier
+\param  pData_p         Data to be written
+\param  length_p        Length of data
+
+\return The function returns FWDELTA_OK or a FWDELTA_ERR_* code.
+*/
+//------------------------------------------------------------------------------
+static int writeTarget(tFwDeltaApplier* pApplier_p, const uint8_t* pData_p, size_t length_p)
+{
+    size_t  length;
+    int     ret;
+
+    while (length_p > 0)
+    {
+        ret = prepareSector(pApplier_p);
+        if (ret != FWDELTA_OK)
+            return ret;
+
+        length = pApplier_p->erasedEnd - pApplier_p->outOffset;
+        if (length > length_p)
+            length = length_p;
+
+        if (pApplier_p->flashOps.pfnWrite(pApplier_p->flashOps.pArg, pApplier_p->outOffset,
+                                          pData_p, length) != 0)
+            return FWDELTA_ERR_FLASH;
+
+        pApplier_p->targetCrc = crc32_calc(pApplier_p->targetCrc, pData_p, length);
+        pApplier_p->outOffset += (uint32_t)length;
+        pData_p += length;
+        length_p -= length;
+    }
+
+    return FWDELTA_OK;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Copy from base image
+
+The function copies data of the base image to the current target offset. Data
+of the current sector is taken from the sector buffer, data of the following
+sectors is still in flash.
+
+\param  pApplier_p      Pointer to the applier
+\param  offset_p        Offset of the data in the base image
+\param  length_p        Length of data
+
+\return The function returns FWDELTA_OK or a FWDELTA_ERR_* code.
+*/
+//------------------------------------------------------------------------------
+static int copyFromBase(tFwDeltaApplier* pApplier_p, uint32_t offset_p, uint32_t length_p)
+{
+    uint32_t    bufferEnd;
+    size_t      length;
+    int         ret;
+
+    while (length_p > 0)
+    {
+        ret = prepareSector(pApplier_p);
+        if (ret != FWDELTA_OK)
+            return ret;
+
+        bufferEnd = pApplier_p->bufferOffset + pApplier_p->sectorSize;
+
+        // Sectors before the current one are gone
+        if (offset_p < pApplier_p->bufferOffset)
+            return FWDELTA_ERR_FORMAT;
+
+        length = pApplier_p->erasedEnd - pApplier_p->outOffset;
+        if (length > length_p)
+            length = length_p;
+
+        if (offset_p < bufferEnd)
+        {
+            if (length > (bufferEnd - offset_p))
+                length = bufferEnd - offset_p;
+
+            ret = writeTarget(pApplier_p, &pApplier_p->pSectorBuffer[offset_p - pApplier_p->bufferOffset],
+                              length);
+        }
+        else
+        {
+            if (length > sizeof(pApplier_p->aCopyBuffer))
+                length = sizeof(pApplier_p->aCopyBuffer);
+
+            if (pApplier_p->flashOps.pfnRead(pApplier_p->flashOps.pArg, offset_p,
+                                             pApplier_p->aCopyBuffer, length) != 0)
+                return FWDELTA_ERR_FLASH;
+
+            ret = writeTarget(pApplier_p, pApplier_p->aCopyBuffer, length);
+        }
+
+        if (ret != FWDELTA_OK)
+            return ret;
+
+        offset_p += (uint32_t)length;
+        length_p -= (uint32_t)length;
+    }
+
+    return FWDELTA_OK;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get match length
+
+\param  pA_p            First data
+\param  pB_p            Second data
+\param  maxLength_p     Maximum length to be compared
+
+\return The function returns the number of equal bytes at the start.
+*/
+//------------------------------------------------------------------------------
+static size_t getMatchLength(const uint8_t* pA_p, const uint8_t* pB_p, size_t maxLength_p)
+{
+    size_t length = 0;
+
+    while ((length < maxLength_p) && (pA_p[length] == pB_p[length]))
+        length++;
+
+    return length;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Hash bytes
+
+\param  pData_p     Pointer to FWDELTA_HASH_LENGTH bytes
+
+\return The function returns the hash table index.
+*/
+//------------------------------------------------------------------------------
+static uint32_t hashBytes(const uint8_t* pData_p)
+{
+    uint32_t hash = readUint32(pData_p) * 2654435761U;
+
+    hash ^= readUint32(pData_p + 4) * 2246822519U;
+
+    return hash >> (32 - FWDELTA_HASH_BITS);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Emit literal operation
+
+\param  pOut_p      Encoder output
+\param  pData_p     Literal data
+\param  length_p    Length of literal data, nothing is emitted for 0
+*/
+//------------------------------------------------------------------------------
+static void emitLiteral(tFwDeltaOutput* pOut_p, const uint8_t* pData_p, size_t length_p)
+{
+    uint8_t opcode = FWDELTA_OP_LITERAL;
+
+    if (length_p == 0)
+        return;
+
+    emitBytes(pOut_p, &opcode, 1);
+    emitUint32(pOut_p, (uint32_t)length_p);
+    emitBytes(pOut_p, pData_p, length_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Emit copy operation
+
+\param  pOut_p      Encoder output
+\param  offset_p    Offset in base image
+\param  length_p    Length of copy
+*/
+//------------------------------------------------------------------------------
+static void emitCopy(tFwDeltaOutput* pOut_p, uint32_t offset_p, uint32_t length_p)
+{
+    uint8_t opcode = FWDELTA_OP_COPY;
+
+    emitBytes(pOut_p, &opcode, 1);
+    emitUint32(pOut_p, offset_p);
+    emitUint32(pOut_p, length_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Emit bytes
+
+\param  pOut_p      Encoder output
+\param  pData_p     Data
+\param  length_p    Length of data
+*/
+//------------------------------------------------------------------------------
+static void emitBytes(tFwDeltaOutput* pOut_p, const void* pData_p, size_t length_p)
+{
+    if (pOut_p->fOverflow || (length_p > (pOut_p->size - pOut_p->pos)))
+    {
+        pOut_p->fOverflow = 1;
+        return;
+    }
+
+    memcpy(pOut_p->pData + pOut_p->pos, pData_p, length_p);
+    pOut_p->pos += length_p;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Emit little endian 32 bit value
+
+\param  pOut_p      Encoder output
+\param  value_p     Value
+*/
+//------------------------------------------------------------------------------
+static void emitUint32(tFwDeltaOutput* pOut_p, uint32_t value_p)
+{
+    uint8_t aData[4];
+
+    aData[0] = (uint8_t)value_p;
+    aData[1] = (uint8_t)(value_p >> 8);
+    aData[2] = (uint8_t)(value_p >> 16);
+    aData[3] = (uint8_t)(value_p >> 24);
+
+    emitBytes(pOut_p, aData, sizeof(aData));
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read little endian 32 bit value
+
+\param  pData_p     Pointer to the value
+
+\return The function returns the value.
+*/
+//------------------------------------------------------------------------------
+static uint32_t readUint32(const uint8_t* pData_p)
+{
+    return (uint32_t)pData_p[0] | ((uint32_t)pData_p[1] << 8) |
+           ((uint32_t)pData_p[2] << 16) | ((uint32_t)pData_p[3] << 24);
+}
+
+/// \}
@@ -0,0 +1,155 @@
+/**
+********************************************************************************
+\file   fwdelta.h
+
+\brief  Firmware image delta patches
+
+This file contains the definitions of the firmware image delta patches. A delta
+describes a new update image (target) with operations on the update image which
+is already stored in the update region of the flash (base). It is applied in
+place, thus the base is overwritten sector by sector while the delta is
+received.
+
+A delta starts with a header (magic, base length and CRC, target length and
+CRC, sector size) followed by operations:
+ - literal: opcode, length, data
+ - copy: opcode, base offset, length
+All values are little endian.
+
+Before a sector is erased, its old content is kept in a sector buffer. A copy
+must not read from sectors before the sector currently written, which is
+guaranteed by the encoder for the sector size given in the header.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+#ifndef _INC_fwdelta_H_
+#define _INC_fwdelta_H_
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define FWDELTA_MAGIC                   0x31445746  ///< Delta magic "FWD1"
+#define FWDELTA_HEADER_SIZE             24          ///< Size of delta header
+#define FWDELTA_OP_LITERAL              0x01        ///< Literal operation
+#define FWDELTA_OP_COPY                 0x02        ///< Copy operation
+#define FWDELTA_MIN_COPY                16          ///< Minimum length of a copy
+
+#define FWDELTA_OK                      0           ///< No error
+#define FWDELTA_ERR_FORMAT              -1          ///< Invalid delta format
+#define FWDELTA_ERR_BASE                -2          ///< Base image does not match
+#define FWDELTA_ERR_FLASH               -3          ///< Flash access failed
+#define FWDELTA_ERR_TARGET              -4          ///< Target image CRC mismatch
+#define FWDELTA_ERR_SIZE                -5          ///< Buffer too small
+
+//------------------------------------------------------------------------------
+// typedef
+//------------------------------------------------------------------------------
+
+/**
+\brief Flash access functions
+
+The struct holds the functions used to access the update region. All offsets
+are relative to the start of the update region.
+*/
+typedef struct
+{
+    int     (*pfnRead)(void* pArg_p, uint32_t offset_p, uint8_t* pDst_p, size_t length_p);
+    int     (*pfnErase)(void* pArg_p, uint32_t offset_p);
+    int     (*pfnWrite)(void* pArg_p, uint32_t offset_p, const uint8_t* pSrc_p, size_t length_p);
+    void*   pArg;                   ///< Argument passed to the functions
+} tFwDeltaFlashOps;
+
+/**
+\brief Delta header
+*/
+typedef struct
+{
+    uint32_t    magic;              ///< Delta magic
+    uint32_t    baseLength;         ///< Length of the base image
+    uint32_t    baseCrc;            ///< CRC of the base image
+    uint32_t    targetLength;       ///< Length of the target image
+    uint32_t    targetCrc;          ///< CRC of the target image
+    uint32_t    sectorSize;         ///< Sector size the delta was created for
+} tFwDeltaHeader;
+
+/**
+\brief Applier state
+
+The struct holds the state of a delta being applied. The sector buffer is
+provided by the user.
+*/
+typedef struct
+{
+    tFwDeltaFlashOps    flashOps;           ///< Flash access functions
+    uint8_t*            pSectorBuffer;      ///< Old content of the current sector
+    uint32_t            sectorSize;         ///< Flash sector size
+    tFwDeltaHeader      header;             ///< Delta header
+    uint8_t             aOpHeader[FWDELTA_HEADER_SIZE]; ///< Header being received
+    size_t              opHeaderFill;       ///< Received header bytes
+    uint32_t            opLength;           ///< Remaining length of current literal
+    uint32_t            outOffset;          ///< Offset of the next target byte
+    uint32_t            erasedEnd;          ///< End of the erased sectors
+    uint32_t            bufferOffset;       ///< Offset of the buffered sector
+    uint32_t            targetCrc;          ///< CRC of the written target bytes
+    uint8_t             aCopyBuffer[256];   ///< Buffer for copies from flash
+    int                 state;              ///< Applier state
+} tFwDeltaApplier;
+
+//------------------------------------------------------------------------------
+// function prototypes
+//------------------------------------------------------------------------------
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int     fwdelta_isDelta(const uint8_t* pData_p, size_t length_p);
+
+void    fwdelta_initApplier(tFwDeltaApplier* pApplier_p, const tFwDeltaFlashOps* pFlashOps_p,
+                            uint8_t* pSectorBuffer_p, uint32_t sectorSize_p);
+int     fwdelta_apply(tFwDeltaApplier* pApplier_p, const uint8_t* pData_p, size_t length_p);
+int     fwdelta_finish(tFwDeltaApplier* pApplier_p);
+
+size_t  fwdelta_create(const uint8_t* pBase_p, size_t baseLength_p,
+                       const uint8_t* pTarget_p, size_t targetLength_p,
+                       uint32_t sectorSize_p, uint8_t* pDelta_p, size_t deltaSize_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INC_fwdelta_H_ */
@@ -0,0 +1,357 @@
+/**
+********************************************************************************
+\file   fwimage.c
+
+\brief  Firmware update image sections
+
+This file implements the access to the header and the section table of firmware
+update images and the detection of section updates and resume requests. It is used by the
+driver and by the host tools.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include "fwimage.h"
+
+#include <crc32.h>
+
+#include <string.h>
+
+//============================================================================//
+//            G L O B A L   D E F I N I T I O N S                             //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// module global vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// global function prototypes
+//------------------------------------------------------------------------------
+
+//============================================================================//
+//            P R I V A T E   D E F I N I T I O N S                           //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// local types
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// local vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// local function prototypes
+//------------------------------------------------------------------------------
+
+//============================================================================//
+//            P U B L I C   F U N C T I O N S                                 //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get firmware header
+
+The function copies the firmware header from the start of the given image and
+checks its signature, version and header CRC. The image itself is not checked.
+
+\param  pImage_p    Pointer to the start of the image file
+\param  length_p    Length of the image file
+\param  pHeader_p   Pointer to store the firmware header
+
+\return The function returns FWIMAGE_OK if the header is valid, FWIMAGE_ERR_CRC
+        if its CRC is wrong, otherwise FWIMAGE_ERR_FORMAT.
+*/
+//------------------------------------------------------------------------------
+int fwimage_getHeader(const uint8_t* pImage_p, size_t length_p, tFwImageHeader* pHeader_p)
+{
+    uint32_t    crc;
+
+    if ((pImage_p == NULL) || (length_p < sizeof(tFwImageHeader)))
+        return FWIMAGE_ERR_FORMAT;
+
+    memcpy(pHeader_p, pImage_p, sizeof(tFwImageHeader));
+
+    if ((pHeader_p->signature != FWIMAGE_HEADER_SIGNATURE) ||
+        (pHeader_p->version != FWIMAGE_HEADER_VERSION))
+        return FWIMAGE_ERR_FORMAT;
+
+    crc = crc32_calc(CRC32_INIT, (const uint8_t*)pHeader_p,
+                     sizeof(tFwImageHeader) - sizeof(pHeader_p->headerCrc));
+    if (crc != pHeader_p->headerCrc)
+        return FWIMAGE_ERR_CRC;
+
+    return FWIMAGE_OK;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get section table
+
+The function reads the section table from the end of the given image and
+checks it.
+
+\param  pImage_p    Pointer to the image following the firmware header
+\param  length_p    Length of the image
+\param  pTable_p    Pointer to store the section table
+
+\return The function returns FWIMAGE_OK or FWIMAGE_ERR_FORMAT.
+*/
+//------------------------------------------------------------------------------
+int fwimage_getSectionTable(const uint8_t* pImage_p, size_t length_p,
+                            tFwImageSectionTable* pTable_p)
+{
+    if ((pImage_p == NULL) || (length_p < sizeof(tFwImageSectionTable)))
+        return FWIMAGE_ERR_FORMAT;
+
+    memcpy(pTable_p, pImage_p + length_p - sizeof(tFwImageSectionTable),
+           sizeof(tFwImageSectionTable));
+
+    return fwimage_checkSectionTable(pTable_p, (uint32_t)length_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check section table
+
+The function checks the magic and CRC of the given section table and that the
+sections cover the image up to the section table.
+
+\param  pTable_p        Pointer to the section table
+\param  imageLength_p   Length of the image following the firmware header
+
+\return The function returns FWIMAGE_OK or FWIMAGE_ERR_FORMAT.
+*/
+//------------------------------------------------------------------------------
+int fwimage_checkSectionTable(const tFwImageSectionTable* pTable_p, uint32_t imageLength_p)
+{
+    uint32_t    crc;
+    uint32_t    offset = 0;
+    uint32_t    i;
+
+    if ((pTable_p->magic != FWIMAGE_SECTION_TABLE_MAGIC) ||
+        (pTable_p->sectionCount != FWIMAGE_SECTION_COUNT))
+        return FWIMAGE_ERR_FORMAT;
+
+    crc = crc32_calc(CRC32_INIT, (const uint8_t*)pTable_p,
+                     sizeof(tFwImageSectionTable) - sizeof(uint32_t));
+    if (crc != pTable_p->tableCrc)
+        return FWIMAGE_ERR_FORMAT;
+
+    for (i = 0; i < pTable_p->sectionCount; i++)
+    {
+        if ((pTable_p->aSection[i].offset != offset) ||
+            (pTable_p->aSection[i].length > (imageLength_p - offset)))
+            return FWIMAGE_ERR_FORMAT;
+
+        offset += pTable_p->aSection[i].length;
+    }
+
+    if ((imageLength_p - offset) != sizeof(tFwImageSectionTable))
+        return FWIMAGE_ERR_FORMAT;
+
+    return FWIMAGE_OK;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check for section update
+
+The function checks if the given data starts with a section update prefix.
+
+\param  pData_p     Pointer to the start of the data
+\param  length_p    Length of the given data
+
+\return The function returns 1 if the data is a section update, otherwise 0.
+*/
+//------------------------------------------------------------------------------
+int fwimage_isSectionUpdate(const uint8_t* pData_p, size_t length_p)
+{
+    uint32_t    magic;
+
+    if ((pData_p == NULL) || (length_p < sizeof(tFwImageSectionUpdate)))
+        return 0;
+
+    memcpy(&magic, pData_p, sizeof(magic));
+
+    return (magic == FWIMAGE_SECTION_UPDATE_MAGIC);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check for resume request
+
+The function checks if the given data is a resume request.
+
+\param  pData_p     Pointer to the start of the data
+\param  length_p    Length of the given data
+
+\return The function returns 1 if the data is a resume request, otherwise 0.
+*/
+//------------------------------------------------------------------------------
+int fwimage_isResume(const uint8_t* pData_p, size_t length_p)
+{
+    uint32_t    magic;
+
+    if ((pData_p == NULL) || (length_p != sizeof(tFwImageResume)))
+        return 0;
+
+    memcpy(&magic, pData_p, sizeof(magic));
+
+    return (magic == FWIMAGE_RESUME_MAGIC);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check for probe transfer
+
+The function checks if the given data starts a probe transfer.
+
+\param  pData_p     Pointer to the start of the data
+\param  length_p    Length of the given data
+
+\return The function returns 1 if the data starts a probe transfer, otherwise 0.
+*/
+//------------------------------------------------------------------------------
+int fwimage_isProbe(const uint8_t* pData_p, size_t length_p)
+{
+    uint32_t    magic;
+
+    if ((pData_p == NULL) || (length_p < sizeof(tFwImageProbe)))
+        return 0;
+
+    memcpy(&magic, pData_p, sizeof(magic));
+
+    return (magic == FWIMAGE_PROBE_MAGIC);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check for chunk trailer
+
+The function checks if the given file chunk ends with a chunk trailer.
+
+\param  pChunk_p    Pointer to the file chunk
+\param  length_p    Length of the file chunk including the trailer
+
+\return The function returns 1 if the chunk has a trailer, otherwise 0.
+*/
+//------------------------------------------------------------------------------
+int fwimage_hasChunkTrailer(const uint8_t* pChunk_p, size_t length_p)
+{
+    tFwImageChunkTrailer    trailer;
+
+    if ((pChunk_p == NULL) || (length_p < sizeof(tFwImageChunkTrailer)))
+        return 0;
+
+    memcpy(&trailer, pChunk_p + length_p - sizeof(tFwImageChunkTrailer), sizeof(trailer));
+
+    return (trailer.magic == FWIMAGE_CHUNK_TRAILER_MAGIC);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Add chunk trailer
+
+The function appends the chunk trailer to the given chunk data. The buffer
+must provide space for the trailer behind the data.
+
+\param  pChunk_p        Pointer to the chunk data
+\param  dataLength_p    Length of the chunk data
+\param  offset_p        Stream offset of the chunk
+
+\return The function returns the length of the chunk including the trailer.
+*/
+//------------------------------------------------------------------------------
+size_t fwimage_addChunkTrailer(uint8_t* pChunk_p, size_t dataLength_p, uint32_t offset_p)
+{
+    tFwImageChunkTrailer    trailer;
+
+    trailer.crc = crc32_calc(CRC32_INIT, pChunk_p, dataLength_p);
+    trailer.crc = crc32_calc(trailer.crc, (const uint8_t*)&offset_p, sizeof(offset_p));
+    trailer.magic = FWIMAGE_CHUNK_TRAILER_MAGIC;
+
+    memcpy(pChunk_p + dataLength_p, &trailer, sizeof(trailer));
+
+    return dataLength_p + sizeof(trailer);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check chunk trailer
+
+The function verifies the chunk trailer of the given file chunk.
+
+\param  pChunk_p    Pointer to the file chunk
+\param  length_p    Length of the file chunk including the trailer
+\param  offset_p    Stream offset of the chunk
+
+\return The function returns FWIMAGE_OK if the chunk is valid, FWIMAGE_ERR_FORMAT
+        if it has no trailer or FWIMAGE_ERR_CRC if the CRC does not match.
+*/
+//------------------------------------------------------------------------------
+int fwimage_checkChunkTrailer(const uint8_t* pChunk_p, size_t length_p, uint32_t offset_p)
+{
+    tFwImageChunkTrailer    trailer;
+    size_t                  dataLength;
+    uint32_t                crc;
+
+    if (!fwimage_hasChunkTrailer(pChunk_p, length_p))
+        return FWIMAGE_ERR_FORMAT;
+
+    dataLength = length_p - sizeof(tFwImageChunkTrailer);
+    memcpy(&trailer, pChunk_p + dataLength, sizeof(trailer));
+
+    crc = crc32_calc(CRC32_INIT, pChunk_p, dataLength);
+    crc = crc32_calc(crc, (const uint8_t*)&offset_p, sizeof(offset_p));
+    if (crc != trailer.crc)
+        return FWIMAGE_ERR_CRC;
+
+    return FWIMAGE_OK;
+}
+
+//============================================================================//
+//            P R I V A T E   F U N C T I O N S                               //
+//============================================================================//
+/// \name Private Functions
+/// \{
+
+/// \}
@@ -0,0 +1,201 @@
+/**
+********************************************************************************
+\file   fwimage.h
+
+\brief  Firmware update image sections
+
+This file contains the definitions of the section table of firmware update
+images. The update image (following the firmware header) consists of the FPGA
+bitstream, the PCP application and the section table. The section table is
+placed at the end of the image, thus it is covered by the image length and CRC
+of the firmware header and ignored by firmware which does not know it.
+
+The section table allows to replace single sections of the stored update image.
+Such a section update starts with a prefix (magic, index of the first replaced
+section, new firmware header, new section table) followed by the image data
+from the first replaced section up to the end of the image.
+
+An interrupted download of a plain update image is continued with a resume
+request (magic, offset, firmware header). It is accepted if the download of the
+same image has been committed up to the offset, the following file chunks then
+continue at the offset.
+
+A probe transfer (magic, length) followed by arbitrary data measures the
+download throughput. The data is programmed to a scratch area at the end of the
+update region, the stored update image is not changed.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+#ifndef _INC_fwimage_H_
+#define _INC_fwimage_H_
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define FWIMAGE_HEADER_SIZE             32          ///< Size of the firmware header
+#define FWIMAGE_HEADER_SIGNATURE        0x46575550  ///< Firmware header signature
+#define FWIMAGE_HEADER_VERSION          0x00000001  ///< Firmware header version
+#define FWIMAGE_SECTION_TABLE_MAGIC     0x54535746  ///< Section table magic "FWST"
+#define FWIMAGE_SECTION_UPDATE_MAGIC    0x55535746  ///< Section update magic "FWSU"
+#define FWIMAGE_RESUME_MAGIC            0x52535746  ///< Resume request magic "FWRS"
+#define FWIMAGE_CHUNK_TRAILER_MAGIC     0x4B435746  ///< Chunk trailer magic "FWCK"
+#define FWIMAGE_PROBE_MAGIC             0x42505746  ///< Probe transfer magic "FWPB"
+
+#define FWIMAGE_SECTION_BITSTREAM       0           ///< FPGA bitstream section
+#define FWIMAGE_SECTION_APPLICATION     1           ///< PCP application section
+#define FWIMAGE_SECTION_COUNT           2           ///< Number of sections
+
+#define FWIMAGE_OK                      0           ///< No error
+#define FWIMAGE_ERR_FORMAT              -1          ///< Invalid section table
+#define FWIMAGE_ERR_CRC                 -2          ///< Chunk CRC mismatch
+
+//------------------------------------------------------------------------------
+// typedef
+//------------------------------------------------------------------------------
+
+/**
+\brief Firmware header
+
+The header precedes the update image, it is the host side copy of the driver's
+tFirmwareHeader. The image CRC covers the image following the header, the
+header CRC all header fields before it.
+*/
+typedef struct
+{
+    uint32_t    signature;          ///< Firmware header signature
+    uint32_t    version;            ///< Firmware header version
+    uint32_t    timeStamp;          ///< Firmware image time stamp
+    uint32_t    length;             ///< Firmware image length
+    uint32_t    crc;                ///< Firmware image CRC
+    uint32_t    oplkVersion;        ///< openPOWERLINK version
+    uint32_t    oplkFeature;        ///< openPOWERLINK feature
+    uint32_t    headerCrc;          ///< Firmware header CRC
+} tFwImageHeader;
+
+/**
+\brief Image section
+
+The offset is relative to the start of the image following the firmware header.
+*/
+typedef struct
+{
+    uint32_t    offset;             ///< Offset of the section
+    uint32_t    length;             ///< Length of the section
+    uint32_t    crc;                ///< CRC of the section
+} tFwImageSection;
+
+/**
+\brief Section table
+
+The sections are contiguous, the first one starts at offset 0 and the last one
+ends directly before the section table.
+*/
+typedef struct
+{
+    uint32_t        magic;                          ///< Section table magic
+    uint32_t        sectionCount;                   ///< Number of sections
+    tFwImageSection aSection[FWIMAGE_SECTION_COUNT];///< Sections
+    uint32_t        tableCrc;                       ///< CRC of the table
+} tFwImageSectionTable;
+
+/**
+\brief Section update prefix
+*/
+typedef struct
+{
+    uint32_t                magic;                  ///< Section update magic
+    uint32_t                sectionIndex;           ///< First replaced section
+    uint8_t                 aHeader[FWIMAGE_HEADER_SIZE]; ///< New firmware header
+    tFwImageSectionTable    sectionTable;           ///< New section table
+} tFwImageSectionUpdate;
+
+/**
+\brief Resume request
+*/
+typedef struct
+{
+    uint32_t                magic;                  ///< Resume request magic
+    uint32_t                offset;                 ///< Offset to continue the download
+    uint8_t                 aHeader[FWIMAGE_HEADER_SIZE]; ///< Firmware header of the image
+} tFwImageResume;
+
+/**
+\brief Probe transfer prefix
+*/
+typedef struct
+{
+    uint32_t                magic;                  ///< Probe transfer magic
+    uint32_t                length;                 ///< Length of the probe data
+} tFwImageProbe;
+
+/**
+\brief Chunk trailer
+
+The trailer is appended to the data of each file chunk if the transfer is
+protected per chunk. The CRC covers the chunk data followed by the 32 bit
+stream offset of the chunk, thus a chunk at a wrong offset is detected too.
+*/
+typedef struct
+{
+    uint32_t                crc;                    ///< CRC of data and offset
+    uint32_t                magic;                  ///< Chunk trailer magic
+} tFwImageChunkTrailer;
+
+//------------------------------------------------------------------------------
+// function prototypes
+//------------------------------------------------------------------------------
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+int     fwimage_getHeader(const uint8_t* pImage_p, size_t length_p, tFwImageHeader* pHeader_p);
+int     fwimage_getSectionTable(const uint8_t* pImage_p, size_t length_p,
+                                tFwImageSectionTable* pTable_p);
+int     fwimage_checkSectionTable(const tFwImageSectionTable* pTable_p, uint32_t imageLength_p);
+int     fwimage_isSectionUpdate(const uint8_t* pData_p, size_t length_p);
+int     fwimage_isResume(const uint8_t* pData_p, size_t length_p);
+int     fwimage_isProbe(const uint8_t* pData_p, size_t length_p);
+int     fwimage_hasChunkTrailer(const uint8_t* pChunk_p, size_t length_p);
+size_t  fwimage_addChunkTrailer(uint8_t* pChunk_p, size_t dataLength_p, uint32_t offset_p);
+int     fwimage_checkChunkTrailer(const uint8_t* pChunk_p, size_t length_p, uint32_t offset_p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INC_fwimage_H_ */
@@ -0,0 +1,406 @@
+/**
+********************************************************************************
+\file   mempool.c
+
+\brief  Static memory pool
+
+This file implements a memory pool with a fixed number of blocks per size
+class. The blocks are placed in a static arena, thus the buffers of the driver
+do not depend on the heap. Allocation and release take constant time, each
+class keeps its free blocks in a singly linked list.
+
+The memory pool is not protected against concurrent access, it shall only be
+used from the background loop.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include "mempool.h"
+
+#include <common/oplkinc.h>
+
+//============================================================================//
+//            G L O B A L   D E F I N I T I O N S                             //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// module global vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// global function prototypes
+//------------------------------------------------------------------------------
+
+//============================================================================//
+//            P R I V A T E   D E F I N I T I O N S                           //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+#define MEMPOOL_ARENA_SIZE      ((CONFIG_MEMPOOL_CLASS0_SIZE * CONFIG_MEMPOOL_CLASS0_COUNT) + \
+                                 (CONFIG_MEMPOOL_CLASS1_SIZE * CONFIG_MEMPOOL_CLASS1_COUNT) + \
+                                 (CONFIG_MEMPOOL_CLASS2_SIZE * CONFIG_MEMPOOL_CLASS2_COUNT) + \
+                                 (CONFIG_MEMPOOL_CLASS3_SIZE * CONFIG_MEMPOOL_CLASS3_COUNT))
+
+#define MEMPOOL_BLOCK_COUNT     (CONFIG_MEMPOOL_CLASS0_COUNT + CONFIG_MEMPOOL_CLASS1_COUNT + \
+                                 CONFIG_MEMPOOL_CLASS2_COUNT + CONFIG_MEMPOOL_CLASS3_COUNT)
+
+#if ((CONFIG_MEMPOOL_CLASS0_SIZE % 4) != 0) || ((CONFIG_MEMPOOL_CLASS1_SIZE % 4) != 0) || \
+    ((CONFIG_MEMPOOL_CLASS2_SIZE % 4) != 0) || ((CONFIG_MEMPOOL_CLASS3_SIZE % 4) != 0)
+#error "Memory pool block sizes must be a multiple of 4 bytes!"
+#endif
+
+#if (CONFIG_MEMPOOL_CLASS0_SIZE >= CONFIG_MEMPOOL_CLASS1_SIZE) || \
+    (CONFIG_MEMPOOL_CLASS1_SIZE >= CONFIG_MEMPOOL_CLASS2_SIZE) || \
+    (CONFIG_MEMPOOL_CLASS2_SIZE >= CONFIG_MEMPOOL_CLASS3_SIZE)
+#error "Memory pool block sizes must be ascending!"
+#endif
+
+//------------------------------------------------------------------------------
+// local types
+//------------------------------------------------------------------------------
+
+/**
+\brief Free block
+
+The struct is placed at the start of a free block to link it to the free list
+of its class.
+*/
+typedef struct sMempoolBlock
+{
+    struct sMempoolBlock*   pNext;          ///< Next free block of the class
+} tMempoolBlock;
+
+/**
+\brief Block size class
+
+The struct describes the blocks of a size class within the arena.
+*/
+typedef struct
+{
+    UINT8*              pBase;              ///< First block of the class
+    UINT8*              pEnd;               ///< End of the last block of the class
+    UINT                firstIndex;         ///< Index of the first block in aRequested
+    tMempoolBlock*      pFreeList;          ///< Free blocks of the class
+} tMempoolClass;
+
+/**
+\brief Memory pool instance
+*/
+typedef struct
+{
+    BOOL                fInitialized;                       ///< Pool is initialized
+    tMempoolClass       aClass[MEMPOOL_CLASS_COUNT];        ///< Size classes
+    UINT                aRequested[MEMPOOL_BLOCK_COUNT];    ///< Requested size per block
+    tMempoolStatistics  statistics;                         ///< Pool statistics
+} tMempoolInstance;
+
+//------------------------------------------------------------------------------
+// local vars
+//------------------------------------------------------------------------------
+static tMempoolInstance mempoolInstance_l;
+static UINT32           aArena_l[MEMPOOL_ARENA_SIZE / sizeof(UINT32)];
+
+static const UINT       aClassSize_l[MEMPOOL_CLASS_COUNT] =
+{
+    CONFIG_MEMPOOL_CLASS0_SIZE,
+    CONFIG_MEMPOOL_CLASS1_SIZE,
+    CONFIG_MEMPOOL_CLASS2_SIZE,
+    CONFIG_MEMPOOL_CLASS3_SIZE,
+};
+
+static const UINT       aClassCount_l[MEMPOOL_CLASS_COUNT] =
+{
+    CONFIG_MEMPOOL_CLASS0_COUNT,
+    CONFIG_MEMPOOL_CLASS1_COUNT,
+    CONFIG_MEMPOOL_CLASS2_COUNT,
+    CONFIG_MEMPOOL_CLASS3_COUNT,
+};
+
+//------------------------------------------------------------------------------
+// local function prototypes
+//------------------------------------------------------------------------------
+static void updateWaste(UINT class_p);
+
+//============================================================================//
+//            P U B L I C   F U N C T I O N S                                 //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+/**
+\brief  Initialize memory pool
+
+The function splits the arena into the blocks of the size classes and resets
+the statistics. All blocks allocated before are released.
+*/
+//------------------------------------------------------------------------------
+void mempool_init(void)
+{
+    UINT8*          pBlock = (UINT8*)aArena_l;
+    UINT            index = 0;
+    UINT            i;
+    UINT            j;
+    tMempoolClass*  pClass;
+
+    OPLK_MEMSET(&mempoolInstance_l, 0, sizeof(tMempoolInstance));
+
+    mempoolInstance_l.statistics.arenaSize = MEMPOOL_ARENA_SIZE;
+
+    for (i = 0; i < MEMPOOL_CLASS_COUNT; i++)
+    {
+        pClass = &mempoolInstance_l.aClass[i];
+        pClass->pBase = pBlock;
+        pClass->firstIndex = index;
+
+        // Link the blocks in ascending order
+        for (j = aClassCount_l[i]; j > 0; j--)
+        {
+            tMempoolBlock* pFree = (tMempoolBlock*)(pBlock + ((j - 1) * aClassSize_l[i]));
+
+            pFree->pNext = pClass->pFreeList;
+            pClass->pFreeList = pFree;
+        }
+
+        pBlock += aClassSize_l[i] * aClassCount_l[i];
+        index += aClassCount_l[i];
+        pClass->pEnd = pBlock;
+
+        mempoolInstance_l.statistics.aClass[i].blockSize = aClassSize_l[i];
+        mempoolInstance_l.statistics.aClass[i].blockCount = aClassCount_l[i];
+    }
+
+    mempoolInstance_l.fInitialized = TRUE;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Allocate block
+
+The function allocates a block from the smallest class fitting the requested
+size. If this class is exhausted, the block is taken from the next larger class.
+
+\param  size_p      Requested size in bytes
+
+\return The function returns a pointer to the block, or NULL if no block is
+        available.
+*/
+//------------------------------------------------------------------------------
+void* mempool_alloc(UINT size_p)
+{
+    tMempoolStatistics*         pStats = &mempoolInstance_l.statistics;
+    tMempoolClassStatistics*    pClassStats;
+    tMempoolClass*              pClass;
+    tMempoolBlock*              pBlock;
+    BOOL                        fSpill = FALSE;
+    UINT                        i;
+
+    if (!mempoolInstance_l.fInitialized || (size_p == 0))
+        goto Fail;
+
+    for (i = 0; i < MEMPOOL_CLASS_COUNT; i++)
+    {
+        if (aClassSize_l[i] < size_p)
+            continue;
+
+        pClass = &mempoolInstance_l.aClass[i];
+        if (pClass->pFreeList == NULL)
+        {
+            fSpill = TRUE;
+            continue;
+        }
+
+        pBlock = pClass->pFreeList;
+        pClass->pFreeList = pBlock->pNext;
+
+        pClassStats = &pStats->aClass[i];
+        pClassStats->usedCount++;
+        pClassStats->allocCount++;
+        pClassStats->requestedBytes += size_p;
+        if (fSpill)
+            pClassStats->spillCount++;
+        if (pClassStats->usedCount > pClassStats->highWaterCount)
+            pClassStats->highWaterCount = pClassStats->usedCount;
+
+        mempoolInstance_l.aRequested[pClass->firstIndex +
+                                     (((UINT8*)pBlock - pClass->pBase) / aClassSize_l[i])] = size_p;
+        updateWaste(i);
+
+        pStats->usedBytes += aClassSize_l[i];
+        if (pStats->usedBytes > pStats->highWaterBytes)
+            pStats->highWaterBytes = pStats->usedBytes;
+
+        return pBlock;
+    }
+
+Fail:
+    pStats->failCount++;
+    DEBUG_LVL_ERROR_TRACE("%s() Allocation of %u bytes failed!\n", __func__, size_p);
+
+    return NULL;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Free block
+
+The function returns a block to the free list of its class. Freeing a block
+which is not in use, e.g. a second time, is detected and ignored.
+
+\param  pBlock_p    Pointer to the block, NULL is ignored
+*/
+//------------------------------------------------------------------------------
+void mempool_free(void* pBlock_p)
+{
+    tMempoolStatistics* pStats = &mempoolInstance_l.statistics;
+    tMempoolClass*      pClass;
+    tMempoolBlock*      pBlock = (tMempoolBlock*)pBlock_p;
+    UINT                offset;
+    UINT                index;
+    UINT                i;
+
+    if (pBlock_p == NULL)
+        return;
+
+    for (i = 0; i < MEMPOOL_CLASS_COUNT; i++)
+    {
+        pClass = &mempoolInstance_l.aClass[i];
+
+        if (((UINT8*)pBlock_p < pClass->pBase) || ((UINT8*)pBlock_p >= pClass->pEnd))
+            continue;
+
+        offset = (UINT)((UINT8*)pBlock_p - pClass->pBase);
+        if ((offset % aClassSize_l[i]) != 0)
+            break;
+
+        // A block in use has a requested size, a free one has none
+        index = pClass->firstIndex + (offset / aClassSize_l[i]);
+        if (mempoolInstance_l.aRequested[index] == 0)
+        {
+            pStats->invalidFreeCount++;
+            DEBUG_LVL_ERROR_TRACE("%s() Block %p is already free!\n", __func__, pBlock_p);
+            return;
+        }
+
+        pBlock->pNext = pClass->pFreeList;
+        pClass->pFreeList = pBlock;
+
+        pStats->aClass[i].usedCount--;
+        pStats->aClass[i].requestedBytes -= mempoolInstance_l.aRequested[index];
+        pStats->usedBytes -= aClassSize_l[i];
+        mempoolInstance_l.aRequested[index] = 0;
+
+        return;
+    }
+
+    pStats->invalidFreeCount++;
+    DEBUG_LVL_ERROR_TRACE("%s() Invalid block %p!\n", __func__, pBlock_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get memory pool statistics
+
+\param  pStatistics_p   Pointer to store the statistics
+*/
+//------------------------------------------------------------------------------
+void mempool_getStatistics(tMempoolStatistics* pStatistics_p)
+{
+    if (pStatistics_p != NULL)
+        *pStatistics_p = mempoolInstance_l.statistics;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print memory pool statistics
+
+The function prints the usage of the memory pool. The high-water marks show
+how tightly the classes can be sized, the waste shows the internal
+fragmentation of the blocks.
+*/
+//------------------------------------------------------------------------------
+void mempool_printStatistics(void)
+{
+    tMempoolStatistics*         pStats = &mempoolInstance_l.statistics;
+    tMempoolClassStatistics*    pClassStats;
+    UINT                        i;
+
+    PRINTF("Memory pool statistics:\n");
+    PRINTF(" Arena          %u bytes\n", pStats->arenaSize);
+    PRINTF(" In use         %u bytes\n", pStats->usedBytes);
+    PRINTF(" High-water     %u bytes\n", pStats->highWaterBytes);
+    PRINTF(" Failures       %u\n", pStats->failCount);
+    PRINTF(" Invalid frees  %u\n", pStats->invalidFreeCount);
+
+    for (i = 0; i < MEMPOOL_CLASS_COUNT; i++)
+    {
+        pClassStats = &pStats->aClass[i];
+
+        PRINTF(" Class %6u: used %u/%u, peak %u, allocs %u, spills %u, max waste %u\n",
+               pClassStats->blockSize, pClassStats->usedCount, pClassStats->blockCount,
+               pClassStats->highWaterCount, pClassStats->allocCount,
+               pClassStats->spillCount, pClassStats->maxWasteBytes);
+    }
+}
+
+//============================================================================//
+//            P R I V A T E   F U N C T I O N S                               //
+//============================================================================//
+/// \name Private Functions
+/// \{
+
+//------------------------------------------------------------------------------
+/**
+\brief  Update waste of class
+
+This function updates the maximum number of unused bytes in the blocks of the
+given class.
+
+\param  class_p     Index of the class
+*/
+//------------------------------------------------------------------------------
+static void updateWaste(UINT class_p)
+{
+    tMempoolClassStatistics*    pClassStats = &mempoolInstance_l.statistics.aClass[class_p];
+    UINT                        waste;
+
+    waste = (pClassStats->usedCount * pClassStats->blockSize) - pClassStats->requestedBytes;
+    if (waste > pClassStats->maxWasteBytes)
+        pClassStats->maxWasteBytes = waste;
+}
+
+/// \}
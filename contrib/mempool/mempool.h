@@ -0,0 +1,144 @@
+/**
+********************************************************************************
+\file   mempool.h
+
+\brief  Static memory pool
+
+This file contains the definitions for the static memory pool, which provides
+the long-lived and per-operation buffers of the driver.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+#ifndef _INC_mempool_H_
+#define _INC_mempool_H_
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include <oplk/oplk.h>
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define MEMPOOL_CLASS_COUNT     4   ///< Number of block size classes
+
+// Block size and number of blocks of the classes (ascending block size)
+#ifndef CONFIG_MEMPOOL_CLASS0_SIZE
+#define CONFIG_MEMPOOL_CLASS0_SIZE      256
+#endif
+
+#ifndef CONFIG_MEMPOOL_CLASS0_COUNT
+#define CONFIG_MEMPOOL_CLASS0_COUNT     8
+#endif
+
+#ifndef CONFIG_MEMPOOL_CLASS1_SIZE
+#define CONFIG_MEMPOOL_CLASS1_SIZE      1024
+#endif
+
+#ifndef CONFIG_MEMPOOL_CLASS1_COUNT
+#define CONFIG_MEMPOOL_CLASS1_COUNT     4
+#endif
+
+#ifndef CONFIG_MEMPOOL_CLASS2_SIZE
+#define CONFIG_MEMPOOL_CLASS2_SIZE      4096
+#endif
+
+#ifndef CONFIG_MEMPOOL_CLASS2_COUNT
+#define CONFIG_MEMPOOL_CLASS2_COUNT     4
+#endif
+
+// The largest class holds Flash sector buffers. The driver daemon holds up to
+// two of them at the same time: the file chunk buffer of chunks larger than
+// class 2 and one transfer buffer (staging window, delta sector buffer or
+// section keep buffer).
+#ifndef CONFIG_MEMPOOL_CLASS3_SIZE
+#define CONFIG_MEMPOOL_CLASS3_SIZE      65536
+#endif
+
+#ifndef CONFIG_MEMPOOL_CLASS3_COUNT
+#define CONFIG_MEMPOOL_CLASS3_COUNT     2
+#endif
+
+//------------------------------------------------------------------------------
+// typedef
+//------------------------------------------------------------------------------
+
+/**
+*  \brief Memory pool class statistics
+*
+*  This struct holds the statistics of a block size class.
+*/
+typedef struct
+{
+    UINT    blockSize;          ///< Block size of the class
+    UINT    blockCount;         ///< Number of blocks of the class
+    UINT    usedCount;          ///< Number of blocks in use
+    UINT    highWaterCount;     ///< Maximum number of blocks in use
+    UINT    allocCount;         ///< Number of allocations served by the class
+    UINT    spillCount;         ///< Allocations served for a smaller class
+    UINT    requestedBytes;     ///< Bytes requested by the blocks in use
+    UINT    maxWasteBytes;      ///< Maximum unused bytes of the blocks in use
+} tMempoolClassStatistics;
+
+/**
+*  \brief Memory pool statistics
+*
+*  This struct holds the statistics of the memory pool.
+*/
+typedef struct
+{
+    UINT                    arenaSize;          ///< Size of the arena
+    UINT                    usedBytes;          ///< Block bytes in use
+    UINT                    highWaterBytes;     ///< Maximum block bytes in use
+    UINT                    failCount;          ///< Number of failed allocations
+    UINT                    invalidFreeCount;   ///< Frees of invalid or already free blocks
+    tMempoolClassStatistics aClass[MEMPOOL_CLASS_COUNT]; ///< Class statistics
+} tMempoolStatistics;
+
+//------------------------------------------------------------------------------
+// function prototypes
+//------------------------------------------------------------------------------
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+void    mempool_init(void);
+void*   mempool_alloc(UINT size_p);
+void    mempool_free(void* pBlock_p);
+void    mempool_getStatistics(tMempoolStatistics* pStatistics_p);
+void    mempool_printStatistics(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _INC_mempool_H_ */
@@ -0,0 +1,235 @@
+/**
+********************************************************************************
+\file   pcpstatus.h
+
+\brief  PCP status area
+
+This file contains the layout of the status area which the driver daemon on the
+PCP publishes for host tools. The area is placed at a fixed offset of the
+common memory which the host reaches through a PCIe BAR, thus it can be read
+without a command of the kernel stack, even if the stack is not running.
+
+The area starts with a magic and a version. A host tool only evaluates the
+area if both match, the length tells how many bytes are valid. The daemon
+clears the magic while it updates the area.
+
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+#ifndef _INC_pcpstatus_H_
+#define _INC_pcpstatus_H_
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include <stdint.h>
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define PCPSTATUS_MAGIC                 0x53504350  ///< Status area magic "PCPS"
+#define PCPSTATUS_VERSION               0x00000006  ///< Status area version
+#define PCPSTATUS_OFFSET                0x0E00      ///< Offset of the area in the common memory
+#define PCPSTATUS_SIZE                  0x0200      ///< Size reserved for the area
+
+// The last word of the area is written by the host. After detaching from the
+// kernel stack, a host tool stores the ready count of the left session there,
+// thus the daemon can restart or reconfigure without waiting for its guard.
+#define PCPSTATUS_DETACH_OFFSET         0x01FC      ///< Offset of the host detach word in the area
+
+#define PCPSTATUS_MEMPOOL_CLASS_COUNT   4           ///< Number of memory pool classes in the area
+
+// Host access to the common memory of the B&R APC/PPC2100 interface card
+#ifndef PCPSTATUS_PCI_VENDOR_ID
+#define PCPSTATUS_PCI_VENDOR_ID         0x1677      ///< PCI vendor ID of the card
+#endif
+
+#ifndef PCPSTATUS_PCI_DEVICE_ID
+#define PCPSTATUS_PCI_DEVICE_ID         0xE809      ///< PCI device ID of the card
+#endif
+
+#ifndef PCPSTATUS_PCI_BAR
+#define PCPSTATUS_PCI_BAR               0           ///< BAR mapping the common memory
+#endif
+
+#ifndef PCPSTATUS_PCI_BAR_OFFSET
+#define PCPSTATUS_PCI_BAR_OFFSET        0x0000      ///< Offset of the common memory in the BAR
+#endif
+
+//------------------------------------------------------------------------------
+// typedef
+//------------------------------------------------------------------------------
+
+/**
+\brief Boot phases
+
+The enum identifies the phases of the boot timeline. The timeline starts when
+the system timer is started by the HAL, which is after the EPCS bootloader has
+copied the application.
+*/
+typedef enum
+{
+    kPcpStatusBootPhaseMain         = 0,    ///< main() entered
+    kPcpStatusBootPhaseFlashInit    = 1,    ///< flash_init() done
+    kPcpStatusBootPhaseFirmwareInit = 2,    ///< firmware_init() done
+    kPcpStatusBootPhaseImageCheck   = 3,    ///< Update image check done (factory image only)
+    kPcpStatusBootPhaseProdtestInit = 4,    ///< prodtest_init() done
+    kPcpStatusBootPhaseStackInit    = 5,    ///< initPlk() done, stack ready
+    kPcpStatusBootPhaseCount        = 6,    ///< Number of boot phases
+} ePcpStatusBootPhase;
+
+/**
+\brief Kernel stack states
+
+The enum identifies the state of the kernel stack of the driver daemon. The
+host polls it for readiness instead of retrying to initialize the stack.
+*/
+typedef enum
+{
+    kPcpStatusStackDown             = 0,    ///< Kernel stack not initialized
+    kPcpStatusStackReady            = 1,    ///< Kernel stack accepts the host
+    kPcpStatusStackRestart          = 2,    ///< Warm restart after a host shutdown
+    kPcpStatusStackReconfig         = 3,    ///< FPGA reconfiguration pending
+} ePcpStatusStackState;
+
+/**
+\brief Boot timeline
+
+The struct holds the completion times of the boot phases of the last power-on.
+*/
+typedef struct
+{
+    uint32_t    validMask;                                  ///< Recorded phases (bit per phase)
+    uint32_t    aTimeStamp[kPcpStatusBootPhaseCount];       ///< Time stamp per phase [ms]
+} tPcpStatusBoot;
+
+/**
+\brief Flash statistics
+
+The struct holds the flash activity of the last completed file transfer. The
+host derives the timing model of the fwimage update time predictor from it.
+The verify errors are updated when they occur, thus the host can report the
+failing flash offset of an aborted transfer.
+*/
+typedef struct
+{
+    uint32_t    transferCount;          ///< Completed file transfers since power-on
+    uint32_t    flashSize;              ///< Flash size [byte]
+    uint32_t    sectorSize;             ///< Flash sector size [byte]
+    uint32_t    duration;               ///< Duration of the transfer [ms]
+    uint32_t    eraseCount;             ///< Number of erased sectors
+    uint32_t    eraseTime;              ///< Time spent erasing [ms]
+    uint32_t    programLength;          ///< Number of programmed bytes
+    uint32_t    programTime;            ///< Time spent programming [ms]
+    uint32_t    verifyLength;           ///< Number of verified bytes
+    uint32_t    verifyTime;             ///< Time spent verifying [ms]
+    uint32_t    errorCount;             ///< Number of verify errors since power-on
+    uint32_t    errorOffset;            ///< Flash offset of the last verify error
+} tPcpStatusFlash;
+
+/**
+\brief Background loop statistics
+
+The struct holds the activity of the background loop of the current kernel
+stack session. It quantifies the load the ctrl polling puts on the shared
+memory and is updated periodically while the loop runs.
+*/
+typedef struct
+{
+    uint32_t    sessionCount;           ///< Kernel stack sessions since power-on
+    uint32_t    duration;               ///< Time the loop has run [ms]
+    uint32_t    loopCount;              ///< Number of loop iterations
+    uint32_t    ctrlPollCount;          ///< Number of ctrl block polls
+    uint32_t    ctrlCmdCount;           ///< Number of executed ctrl commands
+    uint32_t    heartbeatCount;         ///< Number of heartbeat updates
+} tPcpStatusLoop;
+
+/**
+\brief Kernel stack readiness
+
+The struct holds the state of the kernel stack and the time-to-ready of its
+last start. The time-to-ready is counted from the restart after the previous
+session, or from the system timer start after power-on.
+*/
+typedef struct
+{
+    uint32_t    state;                  ///< Kernel stack state (ePcpStatusStackState)
+    uint32_t    readyCount;             ///< Number of stack starts since power-on
+    uint32_t    timeToReady;            ///< Time-to-ready of the last start [ms]
+} tPcpStatusStack;
+
+/**
+\brief Memory pool class statistics
+
+The struct holds the statistics of a block size class of the memory pool.
+*/
+typedef struct
+{
+    uint32_t    blockSize;              ///< Block size of the class [byte]
+    uint32_t    blockCount;             ///< Number of blocks of the class
+    uint32_t    highWaterCount;         ///< Maximum number of blocks in use
+    uint32_t    spillCount;             ///< Allocations served for a smaller class
+    uint32_t    maxWasteBytes;          ///< Maximum unused bytes of the blocks in use
+} tPcpStatusMempoolClass;
+
+/**
+\brief Memory pool statistics
+
+The struct holds the statistics of the memory pool of the driver daemon since
+power-on. The host sizes the pool classes and the heap from the high-water
+marks. It is updated after each file transfer and kernel stack session.
+*/
+typedef struct
+{
+    uint32_t    arenaSize;              ///< Size of the arena [byte]
+    uint32_t    highWaterBytes;         ///< Maximum block bytes in use
+    uint32_t    failCount;              ///< Number of failed allocations
+    uint32_t    invalidFreeCount;       ///< Frees of invalid or already free blocks
+    tPcpStatusMempoolClass aClass[PCPSTATUS_MEMPOOL_CLASS_COUNT]; ///< Class statistics
+} tPcpStatusMempool;
+
+/**
+\brief Status area
+
+All fields are 32 bit words, thus the area can be copied word by word. The
+struct must end before the host detach word at PCPSTATUS_DETACH_OFFSET.
+*/
+typedef struct
+{
+    uint32_t        magic;                  ///< Status area magic
+    uint32_t        version;                ///< Status area version
+    uint32_t        length;                 ///< Number of valid bytes of the area
+    tPcpStatusBoot  boot;                   ///< Boot timeline
+    tPcpStatusFlash flash;                  ///< Flash statistics of the last file transfer
+    tPcpStatusLoop  loop;                   ///< Background loop statistics
+    tPcpStatusStack stack;                  ///< Kernel stack readiness
+    tPcpStatusMempool mempool;              ///< Memory pool statistics
+} tPcpStatus;
+
+#endif /* _INC_pcpstatus_H_ */
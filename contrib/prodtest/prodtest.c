@@ -49,6 +49,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 
 #include <flash.h>
 #include <firmware.h>
+#include <mempool.h>
 
 #ifdef __NIOS2__
 #include <system.h>
@@ -235,7 +236,7 @@ int prodtest_init(void)
     if (initCmdReply(prodtestInstance_l.aTxBufCmdReply, tabentries(prodtestInstance_l.aTxBufCmdReply)) != 0)
         return -1;
 
-    prodtestInstance_l.pMemTestBuffer = (UINT8*)malloc(POSTPROTEST_MEMTEST_SIZE);
+    prodtestInstance_l.pMemTestBuffer = (UINT8*)mempool_alloc(POSTPROTEST_MEMTEST_SIZE);
     if (prodtestInstance_l.pMemTestBuffer == NULL)
         return -1;
 
@@ -265,7 +266,7 @@ void prodtest_exit(void)
 
     prodtestInstance_l.fInitialize = FALSE;
 
-    free(prodtestInstance_l.pMemTestBuffer);
+    mempool_free(prodtestInstance_l.pMemTestBuffer);
     prodtestInstance_l.pMemTestBuffer = NULL;
 
     for (i=0; i<tabentries(prodtestInstance_l.aTxBufCmdReply); i++)
@@ -544,9 +545,9 @@ static int handleRxProdtestFrame(tPlkFrame* pFrame_p, UINT size_p)
                         if (pResp->pmeHeader.error == 0)
                         {
                             tFirmwareDeviceHeader   deviceHdr;
-                            UINT32                  offset = firmware_getDeviceHeaderBase();
 
-                            flash_read(offset, (UINT8*)&deviceHdr, sizeof(tFirmwareDeviceHeader));
+                            OPLK_MEMSET(&deviceHdr, 0, sizeof(tFirmwareDeviceHeader));
+                            firmware_readDeviceHeader(&deviceHdr);
 
                             // Ignore invalid device header, simply return whatever is read
 
@@ -813,7 +814,7 @@ static int ledTest(UINT8 ledVal_p)
 /**
 \brief  Write MAC address to flash
 
-This function writes the provided MAC address to flash.
+This function writes the provided MAC address to the device header in flash.
 
 \param  pMacAddr_p  Pointer to MAC address
 
@@ -822,57 +823,21 @@ This function writes the provided MAC address to flash.
 //------------------------------------------------------------------------------
 static int writeMacAddress(UINT8* pMacAddr_p)
 {
-    tFlashInfo              flashInfo;
-    UINT8*                  pSectorBuffer;
-    UINT32                  offset;
-    UINT32                  sectorOffset;
-    tFirmwareDeviceHeader*  pDeviceHeader;
-    UINT32                  crcval = 0xFFFFFFFF;
-
-    if (flash_getInfo(&flashInfo) != 0)
-        return 1;
-
-    offset = firmware_getDeviceHeaderBase();
-    if (offset == FIRMWARE_INVALID_IMAGE_BASE)
-        return 1;
-
-    pSectorBuffer = OPLK_MALLOC(flashInfo.sectorSize);
-    if (pSectorBuffer == NULL)
-        return 1;
-
-    // Get offset of the sector that includes the device header
-    sectorOffset = offset / flashInfo.sectorSize;
-    sectorOffset *= flashInfo.sectorSize;
+    tFirmwareDeviceHeader   deviceHeader;
 
-    // Read out the sector
-    if (flash_read(sectorOffset, pSectorBuffer, flashInfo.sectorSize) != 0)
+    if (firmware_getDeviceHeaderBase() == FIRMWARE_INVALID_IMAGE_BASE)
         return 1;
 
-    // Set device header pointer to device header offset
-    pDeviceHeader = (tFirmwareDeviceHeader*)(pSectorBuffer + (offset - sectorOffset));
+    // Keep the other fields of an existing header, the MAC address is replaced
+    if (firmware_readDeviceHeader(&deviceHeader) != 0)
+        OPLK_MEMSET(&deviceHeader, 0xFF, sizeof(tFirmwareDeviceHeader));
 
-    //jz: Check if there is already a header, however, if there is, overwrite it!
-    pDeviceHeader->signature = FIRMWARE_DEVICE_HEADER_SIGNATURE;
-    pDeviceHeader->version = FIRMWARE_DEVICE_HEADER_VERSION;
-    OPLK_MEMCPY(pDeviceHeader->aMacAddr, pMacAddr_p, 6);
+    OPLK_MEMCPY(deviceHeader.aMacAddr, pMacAddr_p, 6);
 
-    // Calculate header crc
-    if (firmware_calcCrc(&crcval, (UINT8*)pDeviceHeader, sizeof(tFirmwareDeviceHeader) - 4) != 0)
+    // The sector is only erased when the device header log is full
+    if (firmware_writeDeviceHeader(&deviceHeader) != 0)
         return 1;
 
-    pDeviceHeader->headerCrc = crcval;
-
-    // Erase sector (hope that no one cuts power!)
-    if (flash_eraseSector(sectorOffset) != 0)
-        return 1;
-
-    // Write sector buffer to sector
-    if (flash_write(sectorOffset, pSectorBuffer, flashInfo.sectorSize) != 0)
-        return 1;
-
-    if (pSectorBuffer != NULL)
-        OPLK_FREE(pSectorBuffer);
-
     return 0;
 }
 
@@ -43,6 +43,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //------------------------------------------------------------------------------
 #include <system.h>
 #include <sys/alt_cache.h>
+#include <sys/alt_alarm.h>
+#include <io.h>
 #include <unistd.h>
 #include <altera_avalon_pio_regs.h>
 
@@ -52,8 +54,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #include <kernel/ctrlkcal.h>
 
 #include <flash.h>
+#include <mempool.h>
 #include <firmware.h>
+#include <fwcompress.h>
+#include <fwdelta.h>
+#include <fwimage.h>
 #include <prodtest.h>
+#include <pcpstatus.h>
 
 //============================================================================//
 //            G L O B A L   D E F I N I T I O N S                             //
@@ -82,24 +89,217 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
                              (aMac[2] == 0) && (aMac[3] == 0) && \
                              (aMac[4] == 0) && (aMac[5] == 0))
 
+// Ctrl command polling while the kernel stack is not initialized
+#ifndef DAEMON_CTRL_IDLE_POLL_MS
+#define DAEMON_CTRL_IDLE_POLL_MS        1       ///< Poll period when idle
+#endif
+
+#ifndef DAEMON_CTRL_ACTIVE_HOLD_MS
+#define DAEMON_CTRL_ACTIVE_HOLD_MS      500     ///< Full rate polling after last command
+#endif
+
+#ifndef DAEMON_HEARTBEAT_PERIOD_MS
+#define DAEMON_HEARTBEAT_PERIOD_MS      1       ///< Kernel heartbeat update period
+#endif
+
+#ifndef DAEMON_STATUS_PERIOD_MS
+#define DAEMON_STATUS_PERIOD_MS         1000    ///< Background loop status update period
+#endif
+
+// A host which acknowledges its detach in the status area ends the guard times
+// early, see PCPSTATUS_DETACH_OFFSET.
+#ifndef DAEMON_RESTART_GUARD_MS
+#define DAEMON_RESTART_GUARD_MS         1000    ///< Max. host detach time before warm restart
+#endif
+
+#ifndef DAEMON_RECONFIG_GUARD_MS
+#define DAEMON_RECONFIG_GUARD_MS        2000    ///< Max. host detach time before reconfiguration
+#endif
+
+// File chunks are collected in a staging window and programmed to flash in
+// sector sized blocks. The window is disabled with 0 sectors.
+#ifndef DAEMON_STAGING_SECTORS
+#define DAEMON_STAGING_SECTORS          1       ///< Size of the staging window [sectors]
+#endif
+
+#ifndef DAEMON_VERIFY_BUFFER_SIZE
+#define DAEMON_VERIFY_BUFFER_SIZE       (8 * 1024) ///< Read buffer of flash CRC checks
+#endif
+
+// Data written to the update region is read back and compared immediately.
+// A bad write fails the file chunk instead of the image check after download.
+#ifndef DAEMON_WRITE_VERIFY
+#define DAEMON_WRITE_VERIFY             TRUE    ///< Verify flash writes by read back
+#endif
+
+// While the kernel stack is initialized, the staging window of a plain image or
+// probe transfer is programmed in slices from the background loop. A slice
+// programs one page, polls a sector erase or reads back one page of a sector
+// for the journal. Slicing is disabled with a slice size of 0.
+#ifndef DAEMON_FLASH_SLICE_SIZE
+#define DAEMON_FLASH_SLICE_SIZE         256     ///< Data per flash slice [bytes]
+#endif
+
+#ifndef DAEMON_FLASH_SLICE_PERIOD_MS
+#define DAEMON_FLASH_SLICE_PERIOD_MS    1       ///< Minimum time between flash slices
+#endif
+
+// Sector sized memory pool blocks in use at the same time, see mempool.h
+#define DAEMON_SECTOR_BLOCK_COUNT       2
+
+#if (CONFIG_MEMPOOL_CLASS3_COUNT < DAEMON_SECTOR_BLOCK_COUNT)
+#error "The memory pool needs a sector sized block for each concurrent user!"
+#endif
+
+#if (MEMPOOL_CLASS_COUNT > PCPSTATUS_MEMPOOL_CLASS_COUNT)
+#error "The PCP status area cannot hold the statistics of all memory pool classes!"
+#endif
+
+// The status area for host tools lies behind the dualprocshm structures in the
+// common memory of the PCIe subsystem.
+#define DAEMON_STATUS_BASE              (PCIE_SUBSYSTEM_ONCHIP_MEMORY_BASE + PCPSTATUS_OFFSET)
+
+#if ((PCPSTATUS_OFFSET + PCPSTATUS_SIZE) > PCIE_SUBSYSTEM_ONCHIP_MEMORY_SPAN)
+#error "The PCP status area exceeds the common memory!"
+#endif
+
 //------------------------------------------------------------------------------
 // local types
 //------------------------------------------------------------------------------
+/**
+\brief File transfer modes
+
+The enum identifies the format of a file transfer. It is selected by the start
+of the first file chunk.
+*/
+typedef enum
+{
+    kFileTransferRaw            = 0,    ///< Plain update image
+    kFileTransferCompressed     = 1,    ///< Compressed update image
+    kFileTransferDelta          = 2,    ///< Delta to the stored update image
+    kFileTransferSection        = 3,    ///< Sections of the stored update image
+    kFileTransferProbe          = 4,    ///< Throughput probe to the scratch area
+
+} eFileTransferMode;
+
+/**
+\brief Flash job states
+
+The enum identifies the next step of a flash job.
+*/
+typedef enum
+{
+    kFlashJobIdle               = 0,    ///< No flash job pending
+    kFlashJobErase              = 1,    ///< Erase the sectors crossed by the data
+    kFlashJobProgram            = 2,    ///< Program and verify the data
+    kFlashJobCommit             = 3,    ///< Read back a completed sector for the journal
+
+} eFlashJobState;
+
+/**
+\brief Background loop statistics
+
+The struct counts the background loop activity to quantify the load the ctrl
+polling puts on the shared memory.
+*/
+typedef struct
+{
+    UINT32              startTime;          ///< Time the loop was entered [ms]
+    UINT32              loopCount;          ///< Number of background loop iterations
+    UINT32              ctrlPollCount;      ///< Number of ctrlk_process() calls
+    UINT32              ctrlCmdCount;       ///< Number of executed ctrl commands
+    UINT32              heartbeatCount;     ///< Number of heartbeat updates
+} tBgtStatistics;
+
+/**
+\brief Flash statistics
+
+The struct accumulates the flash activity of a file transfer. The rates are
+reported as timing model of the update time predictor of the fwimage tool.
+*/
+typedef struct
+{
+    UINT32              startTime;          ///< Time the transfer was started [ms]
+    UINT32              eraseCount;         ///< Number of erased sectors
+    UINT32              eraseTime;          ///< Time spent erasing [ms]
+    UINT32              programLength;      ///< Number of programmed bytes
+    UINT32              programTime;        ///< Time spent programming [ms]
+    UINT32              verifyLength;       ///< Number of verified bytes
+    UINT32              verifyTime;         ///< Time spent verifying [ms]
+} tFlashStatistics;
+
+/**
+\brief Flash job
+
+The struct describes the programming of the staging window, which is executed
+in slices from the background loop while the kernel stack is initialized.
+*/
+typedef struct
+{
+    eFlashJobState      state;              ///< Next step of the job
+    UINT32              endOffset;          ///< End of the data in flash
+    const UINT8*        pData;              ///< Data at the current write offset
+    BOOL                fEraseStarted;      ///< Erase at the erase offset is in progress
+    BOOL                fJournalErase;      ///< The started erase is the one of the journal sector
+    UINT32              eraseStartTime;     ///< Start time of the sector erase [ms]
+    UINT32              commitOffset;       ///< Offset of the sector read back
+    UINT32              commitLength;       ///< Length of the sector read back so far
+    UINT32              commitCrc;          ///< CRC of the sector read back so far
+    UINT32              lastSliceTime;      ///< Time of the last slice [ms]
+    tOplkError          result;             ///< Error of the last job
+} tFlashJob;
+
 typedef struct
 {
     tFlashInfo          flashInfo;          ///< Flash info
     UINT32              writeOffset;        ///< Current flash write offset
     UINT32              writeEraseOffset;   ///< Current flash erase offset
+    UINT32              streamOffset;       ///< Expected offset of the next file chunk
+    BOOL                fChunkTrailer;      ///< File chunks are protected by a chunk trailer
+    UINT32              skipEnd;            ///< End of committed data skipped on resume
+    BOOL                fJournal;           ///< Transfer is recorded in download journal
+    BOOL                fJournalPending;    ///< Journal is started by the first flash job
+    tFirmwareHeader     journalHeader;      ///< Image header of the pending journal
+    UINT32              sectorCrc;          ///< CRC of the data written to current sector
+    UINT8*              pStagingBuffer;     ///< Staging window for image data
+    UINT32              stagingSize;        ///< Size of the staging window
+    UINT32              stagingFill;        ///< Data in the staging window
+    tFlashJob           flashJob;           ///< Sliced programming of the staging window
+    BOOL                fChunkPending;      ///< File chunk waits for the flash job
+    UINT32              chunkDone;          ///< Data of the pending chunk already staged
+    eFileTransferMode   transferMode;       ///< Mode of the current file transfer
+    tFwCompressDecoder  decoder;            ///< Decoder of compressed file transfer
+    tFwDeltaApplier     deltaApplier;       ///< Applier of delta file transfer
+    tFwImageSectionUpdate sectionUpdate;    ///< Prefix of section file transfer
     tFirmwareImageType  nextImage;          ///< Next firmware image to be configured
     BOOL                fStackInitialized;  ///< Stack is initialized
+    BOOL                fUpdateImageWritten; ///< Update image has been written since last check
     size_t              fileChunkBufferSize; ///< Size of file chunk buffer
     UINT8*              pFileChunkBuffer;   ///< Buffer for file chunk transfer
+    UINT32              lastCtrlPollTime;   ///< Time of last ctrl poll [ms]
+    UINT32              lastCtrlCmdTime;    ///< Time of last ctrl command [ms]
+    UINT32              lastHeartbeatTime;  ///< Time of last heartbeat update [ms]
+    UINT32              lastStatusTime;     ///< Time of last loop status update [ms]
+    tBgtStatistics      bgtStatistics;      ///< Background loop statistics
+    tFlashStatistics    flashStatistics;    ///< Flash statistics of the file transfer
 } tDrvInstance;
 
 //------------------------------------------------------------------------------
 // local vars
 //------------------------------------------------------------------------------
 static tDrvInstance drvInstance_l;
+static tPcpStatus pcpStatus_l;
+static UINT8 aVerifyBuffer_l[DAEMON_VERIFY_BUFFER_SIZE];
+
+static const char* const aBootPhaseName_l[kPcpStatusBootPhaseCount] =
+{
+    "main",
+    "flash_init",
+    "firmware_init",
+    "image check",
+    "prodtest_init",
+    "stack init",
+};
 
 //------------------------------------------------------------------------------
 // local function prototypes
@@ -110,9 +310,65 @@ static void bgtPlk(void);
 static BOOL ctrlCommandExecCb(tCtrlCmdType cmd_p, UINT16* pRet_p, UINT16* pStatus_p,
                               BOOL* pfExit_p);
 static tOplkError writeFileChunk(void);
+static tOplkError startFileTransfer(UINT length_p);
+static tOplkError resumeImageWrite(void);
+static tOplkError writeCompressedChunk(const tOplkApiFileChunkDesc* pDesc_p);
+static tOplkError writeDeltaChunk(const tOplkApiFileChunkDesc* pDesc_p);
+static tOplkError writeSectionChunk(const tOplkApiFileChunkDesc* pDesc_p);
+static tOplkError startSectionWrite(void);
+static tOplkError finishSectionWrite(void);
+static tOplkError writeProbeChunk(const tOplkApiFileChunkDesc* pDesc_p, const UINT8* pChunk_p);
+static tOplkError startProbeWrite(void);
+static tOplkError rewriteSector(UINT32 sectorOffset_p, UINT32 keepOffset_p, UINT32 keepEnd_p);
+static tOplkError startImageWrite(void);
+static tOplkError writeStagedChunk(const tOplkApiFileChunkDesc* pDesc_p, const UINT8* pData_p,
+                                   UINT length_p);
+static tOplkError writeImageData(const UINT8* pData_p, UINT length_p);
+static tOplkError flushImageData(void);
+static UINT32 getStagingEnd(void);
+static UINT8* getChunkBuffer(void);
+static tOplkError programImageData(const UINT8* pData_p, UINT length_p);
+static void startStaging(void);
+static tOplkError journalImageData(const UINT8* pData_p, UINT length_p);
+static tOplkError commitSector(UINT32 sectorOffset_p);
+static tOplkError commitSectorCrc(UINT32 sectorOffset_p, UINT32 crc_p);
+static BOOL isFlashSliced(void);
+static tOplkError startFlashJob(void);
+static void processFlashJob(void);
+static void waitFlashIdle(void);
+static tOplkError eraseSlice(void);
+static tOplkError programSlice(void);
+static tOplkError commitSlice(void);
+static int eraseFlash(UINT32 offset_p);
+static tOplkError writeFlash(UINT32 offset_p, const UINT8* pData_p, UINT length_p);
+static tOplkError verifyFlash(UINT32 offset_p, const UINT8* pData_p, UINT length_p);
+static UINT32 getUpdateRegionEnd(void);
+static int writeDecodedData(void* pArg_p, const uint8_t* pData_p, size_t length_p);
+static int readUpdateRegion(void* pArg_p, uint32_t offset_p, uint8_t* pDst_p, size_t length_p);
+static int eraseUpdateRegion(void* pArg_p, uint32_t offset_p);
+static int writeUpdateRegion(void* pArg_p, uint32_t offset_p, const uint8_t* pSrc_p,
+                             size_t length_p);
+static void freeTransferBuffers(void);
 static tOplkError setNextReconfigFirmware(tFirmwareImageType imageType_p);
 static tOplkError checkUpdateImage(void);
+static tOplkError calcFlashCrc(UINT32 offset_p, UINT32 length_p, UINT32* pCrc_p);
 static tOplkError getMacAddress(UINT8* pMacAddr_p);
+static UINT32 getTimeMs(void);
+static BOOL isCtrlPollDue(void);
+static void updateHeartbeat(void);
+static void updateLoopStatus(void);
+static void printBgtStatistics(void);
+static void publishBgtStatistics(void);
+static void printFlashStatistics(void);
+static void publishFlashStatistics(void);
+static void publishFlashError(UINT32 offset_p);
+static void publishMempoolStatistics(void);
+static void resetSession(void);
+static void waitHostDetach(UINT32 guardMs_p);
+static void recordBootPhase(UINT phase_p);
+static void printBootTimeline(void);
+static void publishStackState(UINT32 state_p);
+static void publishStatus(void);
 
 //============================================================================//
 //            P U B L I C   F U N C T I O N S                                 //
@@ -131,36 +387,56 @@ Calls the POWERLINK initialization and background task
 //------------------------------------------------------------------------------
 int main(void)
 {
-    tOplkError ret;
+    tOplkError  ret;
+    UINT32      restartTime;
+    UINT        restartCount = 0;
 
     alt_icache_flush_all();
     alt_dcache_flush_all();
 
+    // Not a valid ready count, thus no stale host detach acknowledge is taken
+    IOWR_32DIRECT(DAEMON_STATUS_BASE, PCPSTATUS_DETACH_OFFSET, 0);
+    recordBootPhase(kPcpStatusBootPhaseMain);
+
     PRINTF("CPU NIOS II /%s (%s)\n", ALT_CPU_CPU_IMPLEMENTATION, ALT_CPU_NAME);
     PRINTF("FREQ = %d MHZ\n", ALT_CPU_CPU_FREQ / 1000000U);
     PRINTF("DCACHE = %d BYTE\n", ALT_CPU_DCACHE_SIZE);
     PRINTF("ICACHE = %d BYTE\n", ALT_CPU_ICACHE_SIZE);
 
-    while (1)
+    PRINTF("\n");
+
+    memset((void*)&drvInstance_l, 0, sizeof(tDrvInstance));
+
+    // Buffers of the driver are taken from the static memory pool
+    mempool_init();
+
+    // Flash and firmware drivers are initialized once, they are kept across
+    // warm restarts of the kernel stack.
+    if (flash_init() != 0)
     {
-        PRINTF("\n");
+        PRINTF("Flash initialize failed!\n");
+        goto Exit;
+    }
 
-        memset((void*)&drvInstance_l, 0, sizeof(tDrvInstance));
+    recordBootPhase(kPcpStatusBootPhaseFlashInit);
 
-        if (flash_init() != 0)
-        {
-            PRINTF("Flash initialize failed!\n");
-            break;
-        }
+    if (firmware_init() != 0)
+    {
+        PRINTF("Firmware initialize failed!\n");
+        goto ExitFlash;
+    }
 
-        if (firmware_init() != 0)
-        {
-            PRINTF("Firmware initialize failed!\n");
-            break;
-        }
+    recordBootPhase(kPcpStatusBootPhaseFirmwareInit);
+
+    flash_getInfo(&drvInstance_l.flashInfo);
 
-        flash_getInfo(&drvInstance_l.flashInfo);
+    // The first pass also checks the update image after power-on. Its
+    // time-to-ready counts from the system timer start.
+    drvInstance_l.fUpdateImageWritten = TRUE;
+    restartTime = 0;
 
+    while (1)
+    {
         switch (firmware_getCurrentImageType())
         {
             case kFirmwareImageFactory:
@@ -170,13 +446,21 @@ int main(void)
                 PRINTF("Firmware in factory image mode\n");
                 PRINTF(" -> Firmware status = %d\n", firmwareStatus);
 
-                if ((firmwareStatus == kFirmwareStatusPor) ||
-                    (firmwareStatus == kFirmwareStatusReconfig))
+                // Only check the update image if it might have changed
+                if (((firmwareStatus == kFirmwareStatusPor) ||
+                     (firmwareStatus == kFirmwareStatusReconfig)) &&
+                    drvInstance_l.fUpdateImageWritten)
                 {
                     PRINTF(" -> Check for valid update image...\n");
-                    if (setNextReconfigFirmware(kFirmwareImageUpdate) == kErrorOk)
+                    ret = setNextReconfigFirmware(kFirmwareImageUpdate);
+
+                    if (restartCount == 0)
+                        recordBootPhase(kPcpStatusBootPhaseImageCheck);
+
+                    if (ret == kErrorOk)
                     {
                         PRINTF(" --> Valid image found, trigger reconfig!\n");
+                        printBootTimeline();
                         PRINTF("halt terminal\n%c", 4);
 #ifndef NDEBUG
                         usleep(2000000U);
@@ -194,12 +478,17 @@ int main(void)
                 break;
         }
 
+        resetSession();
+
         if (prodtest_init() != 0)
         {
             PRINTF("Production test initialize failed\n");
             break;
         }
 
+        if (restartCount == 0)
+            recordBootPhase(kPcpStatusBootPhaseProdtestInit);
+
         ret = initPlk();
 
         PRINTF("Initialization returned with \"%s\" (0x%X)\n",
@@ -208,26 +497,65 @@ int main(void)
         if (ret != kErrorOk)
             break;
 
+        if (restartCount == 0)
+        {
+            recordBootPhase(kPcpStatusBootPhaseStackInit);
+            printBootTimeline();
+        }
+
+        // The ctrl module reports ready to the host from now on
+        pcpStatus_l.stack.readyCount++;
+        pcpStatus_l.stack.timeToReady = getTimeMs() - restartTime;
+        publishStackState(kPcpStatusStackReady);
+
+        PRINTF("Kernel stack ready after %lu ms (%s start #%u)\n",
+               (ULONG)pcpStatus_l.stack.timeToReady,
+               (restartCount == 0) ? "cold" : "warm", restartCount);
+
         bgtPlk();
 
+        // A sector erase of a flash job may still be in progress, the flash
+        // driver rejects any access until it is done.
+        waitFlashIdle();
+
+        publishStackState((drvInstance_l.nextImage != kFirmwareImageUnknown) ?
+                          kPcpStatusStackReconfig : kPcpStatusStackRestart);
+
         PRINTF("Background loop stopped.\nShutdown Kernel Stack\n");
 
         shtdPlk();
 
+        mempool_printStatistics();
+        publishMempoolStatistics();
+
         if (drvInstance_l.nextImage != kFirmwareImageUnknown)
         {
-            usleep(2000000U); //jz: Wait here for some longer time!
+            // Give the host time to fetch the command return before the
+            // PCIe endpoint disappears.
+            waitHostDetach(DAEMON_RECONFIG_GUARD_MS);
             PRINTF("halt terminal\n%c", 4);
             firmware_reconfig(drvInstance_l.nextImage);
         }
 
         prodtest_exit();
-        firmware_exit();
-        flash_exit();
 
-        usleep(1000000U);
+        // Give the host time to detach from the shared memory before the
+        // ctrl module re-initializes it. Hosts which do not acknowledge their
+        // detach get the full guard of the original daemon.
+        restartTime = getTimeMs();
+        restartCount++;
+        waitHostDetach(DAEMON_RESTART_GUARD_MS);
+
+        PRINTF("\n");
     }
 
+    prodtest_exit();
+    firmware_exit();
+
+ExitFlash:
+    flash_exit();
+
+Exit:
     PRINTF("halt terminal\n%c", 4);
 
     return 0;
@@ -265,7 +593,7 @@ static tOplkError initPlk(void)
 
     if (drvInstance_l.fileChunkBufferSize > 0)
     {
-        drvInstance_l.pFileChunkBuffer = OPLK_MALLOC(drvInstance_l.fileChunkBufferSize);
+        drvInstance_l.pFileChunkBuffer = mempool_alloc(drvInstance_l.fileChunkBufferSize);
         if (drvInstance_l.pFileChunkBuffer == NULL)
             ret = kErrorNoResource;
     }
@@ -285,7 +613,8 @@ This function shuts down the communication stack.
 static void shtdPlk(void)
 {
     ctrlk_exit();
-    OPLK_FREE(drvInstance_l.pFileChunkBuffer);
+    freeTransferBuffers();
+    mempool_free(drvInstance_l.pFileChunkBuffer);
     drvInstance_l.pFileChunkBuffer = NULL;
 }
 
@@ -298,20 +627,41 @@ This function runs the background tasks
 //------------------------------------------------------------------------------
 static void bgtPlk(void)
 {
-    BOOL fExit = FALSE;
+    BOOL            fExit = FALSE;
+    tBgtStatistics* pStats = &drvInstance_l.bgtStatistics;
+
+    OPLK_MEMSET(pStats, 0, sizeof(tBgtStatistics));
+    pStats->startTime = getTimeMs();
+    drvInstance_l.lastCtrlCmdTime = pStats->startTime;
+    drvInstance_l.lastStatusTime = pStats->startTime;
+    pcpStatus_l.loop.sessionCount++;
 
     while (1)
     {
+        pStats->loopCount++;
+
         firmware_process();
-        ctrlk_updateHeartbeat();
-        fExit = ctrlk_process();
+        updateHeartbeat();
+        updateLoopStatus();
+        processFlashJob();
+
+        if (isCtrlPollDue())
+        {
+            pStats->ctrlPollCount++;
+            fExit = ctrlk_process();
+        }
 
         if (fExit != FALSE)
             break;
 
-        if (prodtest_process() != 0)
+        // Production test commands may write the device header, thus they
+        // are deferred while a flash job owns the flash.
+        if ((drvInstance_l.flashJob.state == kFlashJobIdle) && (prodtest_process() != 0))
             break;
     }
+
+    printBgtStatistics();
+    publishBgtStatistics();
 }
 
 //------------------------------------------------------------------------------
@@ -338,6 +688,10 @@ static BOOL ctrlCommandExecCb(tCtrlCmdType cmd_p, UINT16* pRet_p, UINT16* pStatu
     UINT16          status = kCtrlStatusUnchanged;
     BOOL            fExit = FALSE;
 
+    // Any command keeps the ctrl polling at full rate for a while
+    drvInstance_l.lastCtrlCmdTime = getTimeMs();
+    drvInstance_l.bgtStatistics.ctrlCmdCount++;
+
     switch (cmd_p)
     {
         case kCtrlInitStack:
@@ -432,7 +786,15 @@ static BOOL ctrlCommandExecCb(tCtrlCmdType cmd_p, UINT16* pRet_p, UINT16* pStatu
 \brief  Write file chunk
 
 This function handles the kCtrlWriteFileChunk command. It reads the file chunk
-buffer and writes the data to the firmware update region in flash.
+buffer and forwards the data to the firmware update region in flash. Depending
+on the start of the transfer, the data is a plain update image, a compressed
+update image, a delta to the stored update image or a section update replacing
+the trailing sections of the stored update image. Chunks continuing a plain
+update image or a probe are read directly into the staging window. If the first chunk
+carries a chunk trailer, every chunk of the transfer is checked before it is
+processed and a damaged chunk is rejected with kErrorRetry. While a flash job
+programs the staging window, chunks are rejected with kErrorReject and the host
+sends them again later.
 
 \return This function returns tOplkError error codes.
 */
@@ -440,213 +802,2231 @@ buffer and writes the data to the firmware update region in flash.
 static tOplkError writeFileChunk(void)
 {
     tOplkError              ret;
-    INT                     retflash;
-    tFlashInfo*             pFlashInfo = &drvInstance_l.flashInfo;
-    UINT32                  updateImageOffset = firmware_getImageBase(kFirmwareImageUpdate);
-    UINT32                  writeOffset;
     tOplkApiFileChunkDesc   fileChunkDesc;
+    UINT8*                  pChunk = getChunkBuffer();
 
-    ret = ctrlk_readFileChunk(&fileChunkDesc, drvInstance_l.fileChunkBufferSize,
-                              drvInstance_l.pFileChunkBuffer);
+    ret = ctrlk_readFileChunk(&fileChunkDesc, drvInstance_l.fileChunkBufferSize, pChunk);
     if (ret != kErrorOk)
         return ret;
 
-    // Check if the transfer starts correctly
-    if (fileChunkDesc.fFirst && fileChunkDesc.offset != 0)
-        return kErrorInvalidOperation;
-
-    // Get write offset within flash
-    writeOffset = updateImageOffset + fileChunkDesc.offset;
-
-    // Check if write is done continuously
-    if (!fileChunkDesc.fFirst && writeOffset != drvInstance_l.writeOffset)
-        return kErrorInvalidOperation;
-
-    // Check if write exceeds flash size
-    if ((writeOffset + fileChunkDesc.length) > pFlashInfo->size)
-        return kErrorNoResource;
+    // The first chunk of a transfer is always processed in the file chunk buffer
+    if (fileChunkDesc.fFirst && (pChunk != drvInstance_l.pFileChunkBuffer))
+    {
+        OPLK_MEMCPY(drvInstance_l.pFileChunkBuffer, pChunk, fileChunkDesc.length);
+        pChunk = drvInstance_l.pFileChunkBuffer;
+    }
 
-    // Handle first transfer
+    // The host protects all chunks of a transfer or none
     if (fileChunkDesc.fFirst)
-    {
-        // Reset write pointer
-        drvInstance_l.writeOffset = writeOffset;
+        drvInstance_l.fChunkTrailer = fwimage_hasChunkTrailer(pChunk, fileChunkDesc.length);
 
-        // Erase first sector
-        retflash = flash_eraseSector(updateImageOffset);
-        if (retflash != 0)
-            return kErrorGeneralError;
+    if (drvInstance_l.fChunkTrailer)
+    {
+        // A damaged chunk is dropped, the host sends it again
+        if (fwimage_checkChunkTrailer(pChunk, fileChunkDesc.length,
+                                      fileChunkDesc.offset) != FWIMAGE_OK)
+        {
+            PRINTF("File chunk at offset 0x%X is damaged!\n", fileChunkDesc.offset);
+            return kErrorRetry;
+        }
 
-        // Set next sector to be erased
-        drvInstance_l.writeEraseOffset = updateImageOffset + pFlashInfo->sectorSize;
+        fileChunkDesc.length -= sizeof(tFwImageChunkTrailer);
     }
 
-    // Handle sector boundary xing
-    if ((writeOffset + fileChunkDesc.length) > drvInstance_l.writeEraseOffset)
-    {
-        // Chunk exceeds current sector -> erase next sector
-        if (flash_eraseSector(drvInstance_l.writeEraseOffset) != 0)
-            return kErrorGeneralError;
+    // The flash is busy with the staging window, the host sends the chunk again
+    if (drvInstance_l.flashJob.state != kFlashJobIdle)
+        return kErrorReject;
 
-        drvInstance_l.writeEraseOffset += pFlashInfo->sectorSize;
+    // A failed flash job fails the chunk which has been waiting for it
+    if (drvInstance_l.flashJob.result != kErrorOk)
+    {
+        ret = drvInstance_l.flashJob.result;
+        drvInstance_l.flashJob.result = kErrorOk;
+        drvInstance_l.fChunkPending = FALSE;
+        drvInstance_l.chunkDone = 0;
+        return ret;
     }
 
-    // Forward data to flash
-    retflash = flash_write(drvInstance_l.writeOffset, drvInstance_l.pFileChunkBuffer,
-                           fileChunkDesc.length);
-    if (retflash != 0)
-        return kErrorGeneralError;
+    // Any other chunk than the pending one drops the pending state
+    if (drvInstance_l.fChunkPending && (fileChunkDesc.offset != drvInstance_l.streamOffset))
+    {
+        drvInstance_l.fChunkPending = FALSE;
+        drvInstance_l.chunkDone = 0;
+    }
 
-    drvInstance_l.writeOffset += fileChunkDesc.length;
+    // Check if the transfer starts correctly
+    if (fileChunkDesc.fFirst && fileChunkDesc.offset != 0)
+        return kErrorInvalidOperation;
 
-    return kErrorOk;
-}
+    if (fileChunkDesc.fFirst && !drvInstance_l.fChunkPending)
+    {
+        OPLK_MEMSET(&drvInstance_l.flashStatistics, 0, sizeof(tFlashStatistics));
+        drvInstance_l.flashStatistics.startTime = getTimeMs();
+    }
 
-//------------------------------------------------------------------------------
-/**
-\brief    Set next reconfigure firmware type
+    // Check if the transfer is done continuously
+    if (!fileChunkDesc.fFirst && fileChunkDesc.offset != drvInstance_l.streamOffset)
+        return kErrorInvalidOperation;
 
-This function sets the reconfiguration to a valid firmware image.
+    // Resume request continues an interrupted transfer
+    if (fileChunkDesc.fFirst && !drvInstance_l.fChunkPending &&
+        fwimage_isResume(drvInstance_l.pFileChunkBuffer, fileChunkDesc.length))
+        return resumeImageWrite();
 
-\note   Note that the reconfiguration itself may only be triggered after the
-        stack has been shutdown.
+    // Handle first transfer
+    if (fileChunkDesc.fFirst && !drvInstance_l.fChunkPending)
+    {
+        ret = startFileTransfer(fileChunkDesc.length);
+        if (ret != kErrorOk)
+            return ret;
+    }
 
-\param  imageType_p         Firmware image type to be reconfigured
+    switch (drvInstance_l.transferMode)
+    {
+        case kFileTransferCompressed:
+            ret = writeCompressedChunk(&fileChunkDesc);
+            break;
 
-\return This function returns tOplkError error codes.
-*/
-//------------------------------------------------------------------------------
-static tOplkError setNextReconfigFirmware(tFirmwareImageType imageType_p)
-{
-    tOplkError      ret;
+        case kFileTransferDelta:
+            ret = writeDeltaChunk(&fileChunkDesc);
+            break;
 
-    switch (imageType_p)
-    {
-        case kFirmwareImageFactory:
-            drvInstance_l.nextImage = imageType_p;
-            return kErrorOk;
+        case kFileTransferSection:
+            ret = writeSectionChunk(&fileChunkDesc);
+            break;
 
-        case kFirmwareImageUpdate:
-            // Update image must be verified before doing reconfiguration!
+        case kFileTransferProbe:
+            ret = writeProbeChunk(&fileChunkDesc, pChunk);
             break;
 
+        case kFileTransferRaw:
         default:
-            return kErrorInvalidOperation;
+            ret = writeStagedChunk(&fileChunkDesc, pChunk, fileChunkDesc.length);
+
+            // Transfer is complete, a resume is no longer needed
+            if ((ret == kErrorOk) && fileChunkDesc.fLast && drvInstance_l.fJournal)
+            {
+                firmware_clearJournal();
+                drvInstance_l.fJournal = FALSE;
+            }
+            break;
     }
 
-    ret = checkUpdateImage();
     if (ret != kErrorOk)
         return ret;
 
-    drvInstance_l.nextImage = imageType_p;
+    drvInstance_l.streamOffset += fileChunkDesc.length;
+
+    if (fileChunkDesc.fLast)
+    {
+        printFlashStatistics();
+        publishFlashStatistics();
+
+        // The staging window is not kept until the next transfer
+        freeTransferBuffers();
+        publishMempoolStatistics();
+    }
 
     return kErrorOk;
 }
 
 //------------------------------------------------------------------------------
 /**
-\brief    Check update image
+\brief  Start file transfer
 
-This function checks the update image header and the update image itself.
+This function selects the mode of a new file transfer by the start of the first
+file chunk and allocates the buffers needed by the mode. Only the transfer of a
+plain update image is recorded in the download journal. A probe keeps the
+journal, it is placed behind the update image and does not interfere with a
+later resume. All other modes clear the journal.
+
+\param  length_p    Length of the first file chunk
 
 \return This function returns tOplkError error codes.
 */
 //------------------------------------------------------------------------------
-static tOplkError checkUpdateImage(void)
+static tOplkError startFileTransfer(UINT length_p)
 {
-    UINT8           aBuffer[8 * 1024];
-    tFirmwareHeader firmwareHeader;
-    UINT32          crcVal;
-    UINT            i;
-    UINT            length;
-    UINT32          offset;
+    tOplkError      ret;
+    UINT8*          pBuffer = drvInstance_l.pFileChunkBuffer;
+    tFirmwareHeader header;
 
-    if (flash_read(firmware_getImageBase(kFirmwareImageUpdate),
-       (UINT8*)&firmwareHeader, sizeof(tFirmwareHeader)) != 0)
+    freeTransferBuffers();
+
+    // These modes erase and rewrite whole sectors at once, which would stall the
+    // background loop while it serves the kernel stack
+    if ((DAEMON_FLASH_SLICE_SIZE != 0) && drvInstance_l.fStackInitialized &&
+        (fwcompress_isCompressed(pBuffer, length_p) || fwdelta_isDelta(pBuffer, length_p) ||
+         fwimage_isSectionUpdate(pBuffer, length_p)))
     {
-        return kErrorNoResource;
+        PRINTF("Only plain images and probes are accepted while the stack is initialized!\n");
+        return kErrorInvalidOperation;
     }
 
-    PRINTF("Firmware header:\n");
-    PRINTF(" Signature      0x%08X (0x%08X)\n", firmwareHeader.signature, FIRMWARE_HEADER_SIGNATUR);
-    PRINTF(" Version        0x%08X (0x%08X)\n", firmwareHeader.version, FIRMWARE_HEADER_VERSION);
-    PRINTF(" Time stamp     0x%08X\n", firmwareHeader.timeStamp);
-    PRINTF(" Length         0x%08X\n", firmwareHeader.length);
-    PRINTF(" CRC            0x%08X\n", firmwareHeader.crc);
-    PRINTF(" OPLK Version   0x%08X\n", firmwareHeader.oplkVersion);
-    PRINTF(" OPLK Feature   0x%08X\n", firmwareHeader.oplkFeature);
-    PRINTF(" Header CRC     0x%08X\n", firmwareHeader.headerCrc);
-
-    if (firmware_checkHeader(&firmwareHeader) != 0)
+    drvInstance_l.fJournal = FALSE;
+    drvInstance_l.fJournalPending = FALSE;
+    if (!fwimage_isProbe(pBuffer, length_p) && (firmware_clearJournal() != 0))
         return kErrorGeneralError;
 
-    PRINTF("Calc image CRC...\n");
+    if (fwcompress_isCompressed(pBuffer, length_p))
+    {
+        UINT8*  pInBuffer = mempool_alloc(FWCOMPRESS_BLOCK_SIZE);
+        UINT8*  pOutBuffer = mempool_alloc(FWCOMPRESS_BLOCK_SIZE);
 
-    i = firmwareHeader.length;
-    offset = firmware_getImageBase(kFirmwareImageUpdate) + sizeof(tFirmwareHeader);
-    crcVal = 0xFFFFFFFF;
+        if ((pInBuffer == NULL) || (pOutBuffer == NULL))
+        {
+            mempool_free(pInBuffer);
+            mempool_free(pOutBuffer);
+            return kErrorNoResource;
+        }
 
-    while (i > 0)
+        fwcompress_initDecoder(&drvInstance_l.decoder, pInBuffer, pOutBuffer);
+        drvInstance_l.transferMode = kFileTransferCompressed;
+    }
+    else if (fwdelta_isDelta(pBuffer, length_p))
     {
-        if (i > sizeof(aBuffer))
-            length = sizeof(aBuffer);
-        else
-            length = i;
+        tFwDeltaFlashOps    flashOps;
+        UINT8*              pSectorBuffer = mempool_alloc(drvInstance_l.flashInfo.sectorSize);
 
-        if (flash_read(offset, aBuffer, length) != 0)
+        if (pSectorBuffer == NULL)
             return kErrorNoResource;
 
-        firmware_calcCrc(&crcVal, aBuffer, length);
+        flashOps.pfnRead = readUpdateRegion;
+        flashOps.pfnErase = eraseUpdateRegion;
+        flashOps.pfnWrite = writeUpdateRegion;
+        flashOps.pArg = NULL;
 
-        i -= length;
-        offset += length;
+        fwdelta_initApplier(&drvInstance_l.deltaApplier, &flashOps, pSectorBuffer,
+                            drvInstance_l.flashInfo.sectorSize);
+        drvInstance_l.transferMode = kFileTransferDelta;
+
+        // The applier erases the sectors itself after saving the old content
+        drvInstance_l.fUpdateImageWritten = TRUE;
+        drvInstance_l.streamOffset = 0;
+
+        return kErrorOk;
     }
+    else if (fwimage_isSectionUpdate(pBuffer, length_p))
+    {
+        OPLK_MEMCPY(&drvInstance_l.sectionUpdate, pBuffer, sizeof(tFwImageSectionUpdate));
+        drvInstance_l.transferMode = kFileTransferSection;
 
-    PRINTF("Calculated Image CRC = 0x%08X\n", crcVal);
+        // Sectors are rewritten before the staging window is allocated
+        ret = startSectionWrite();
+        if (ret == kErrorOk)
+            startStaging();
 
-    if (crcVal != firmwareHeader.crc)
+        return ret;
+    }
+    else if (fwimage_isProbe(pBuffer, length_p))
     {
-        PRINTF(" --> Wrong CRC!\n");
-        return kErrorGeneralError;
+        drvInstance_l.transferMode = kFileTransferProbe;
+
+        ret = startProbeWrite();
+        if (ret == kErrorOk)
+            startStaging();
+
+        return ret;
     }
+    else
+    {
+        drvInstance_l.transferMode = kFileTransferRaw;
 
-    return kErrorOk;
+        // The image header identifies the transfer in the download journal. If
+        // the window is programmed in slices, the first flash job erases the
+        // journal sector and starts the journal.
+        if (length_p >= sizeof(tFirmwareHeader))
+        {
+            OPLK_MEMCPY(&header, pBuffer, sizeof(tFirmwareHeader));
+            if (firmware_checkHeader(&header) == 0)
+            {
+                if (!isFlashSliced())
+                    drvInstance_l.fJournal = (firmware_startJournal(&header, FALSE) == 0);
+                else if (firmware_getJournalBase() != FIRMWARE_INVALID_IMAGE_BASE)
+                {
+                    drvInstance_l.journalHeader = header;
+                    drvInstance_l.fJournalPending = TRUE;
+                }
+            }
+        }
+    }
+
+    // The first erase is left to the flash job if the window is programmed in slices
+    startStaging();
+
+    return startImageWrite();
 }
 
 //------------------------------------------------------------------------------
 /**
-\brief    Get MAC address
+\brief  Resume image write
 
-This function reads the MAC address from the flash and writes it to the given
-address.
-
-\param  pMacAddr_p      Pointer to memory where the MAC address is returned.
+This function handles a resume request. The transfer of a plain update image
+continues at the requested offset if the download journal belongs to the same
+image and all sectors before the offset are committed. A rejected request does
+not change the current transfer.
 
 \return This function returns tOplkError error codes.
 */
 //------------------------------------------------------------------------------
-static tOplkError getMacAddress(UINT8* pMacAddr_p)
+static tOplkError resumeImageWrite(void)
 {
-    UINT32                  offset;
-    tFirmwareDeviceHeader   deviceHeader;
+    tFwImageResume  resume;
+    tFirmwareHeader header;
+    UINT32          committedLength;
+    UINT32          imageBase = firmware_getImageBase(kFirmwareImageUpdate);
 
-    if (pMacAddr_p == NULL)
-        return kErrorGeneralError;
+    OPLK_MEMCPY(&resume, drvInstance_l.pFileChunkBuffer, sizeof(tFwImageResume));
+    OPLK_MEMCPY(&header, resume.aHeader, sizeof(tFirmwareHeader));
 
-    offset = firmware_getDeviceHeaderBase();
+    if ((firmware_getJournalResumeOffset(&header, &committedLength) != 0) ||
+        (resume.offset > committedLength))
+        return kErrorInvalidOperation;
 
-    if (offset == FIRMWARE_INVALID_IMAGE_BASE)
-        return kErrorGeneralError;
+    freeTransferBuffers();
 
-    if (flash_read(offset, (UINT8*)&deviceHeader, sizeof(tFirmwareDeviceHeader)) != 0)
-        return kErrorGeneralError;
+    drvInstance_l.transferMode = kFileTransferRaw;
+    drvInstance_l.fJournal = TRUE;
+    drvInstance_l.fJournalPending = FALSE;
+    drvInstance_l.fUpdateImageWritten = TRUE;
 
-    if (firmware_checkDeviceHeader(&deviceHeader) != 0)
-        return kErrorGeneralError;
+    // Data up to the committed length is already in flash and skipped
+    drvInstance_l.writeOffset = imageBase + resume.offset;
+    drvInstance_l.skipEnd = imageBase + committedLength;
+    drvInstance_l.writeEraseOffset = drvInstance_l.skipEnd;
+    drvInstance_l.sectorCrc = 0xFFFFFFFF;
+    drvInstance_l.streamOffset = resume.offset;
 
-    OPLK_MEMCPY(pMacAddr_p, deviceHeader.aMacAddr, 6);
+    startStaging();
+
+    PRINTF("Resume update image download at offset 0x%X\n", resume.offset);
 
     return kErrorOk;
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Write compressed file chunk
+
+This function decodes a file chunk of a compressed transfer and writes the
+decoded data to flash.
+
+\param  pDesc_p     File chunk descriptor
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError writeCompressedChunk(const tOplkApiFileChunkDesc* pDesc_p)
+{
+    tOplkError  ret = kErrorOk;
+
+    // Decoder is released after the last chunk or an error
+    if (drvInstance_l.decoder.pInBuffer == NULL)
+        return kErrorInvalidOperation;
+
+    if (fwcompress_decode(&drvInstance_l.decoder, drvInstance_l.pFileChunkBuffer,
+                          pDesc_p->length, writeDecodedData, &ret) != FWCOMPRESS_OK)
+    {
+        PRINTF("Decoding file chunk at offset 0x%X failed!\n", pDesc_p->offset);
+        freeTransferBuffers();
+        return (ret != kErrorOk) ? ret : kErrorInvalidOperation;
+    }
+
+    if (pDesc_p->fLast)
+    {
+        ret = fwcompress_isComplete(&drvInstance_l.decoder) ? kErrorOk : kErrorInvalidOperation;
+        if (ret == kErrorOk)
+            ret = flushImageData();
+
+        freeTransferBuffers();
+    }
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write delta file chunk
+
+This function applies a file chunk of a delta transfer to the update image
+stored in flash.
+
+\param  pDesc_p     File chunk descriptor
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError writeDeltaChunk(const tOplkApiFileChunkDesc* pDesc_p)
+{
+    int retDelta;
+
+    // Applier is released after the last chunk or an error
+    if (drvInstance_l.deltaApplier.pSectorBuffer == NULL)
+        return kErrorInvalidOperation;
+
+    retDelta = fwdelta_apply(&drvInstance_l.deltaApplier, drvInstance_l.pFileChunkBuffer,
+                             pDesc_p->length);
+
+    if ((retDelta == FWDELTA_OK) && pDesc_p->fLast)
+        retDelta = fwdelta_finish(&drvInstance_l.deltaApplier);
+
+    if ((retDelta != FWDELTA_OK) || pDesc_p->fLast)
+        freeTransferBuffers();
+
+    switch (retDelta)
+    {
+        case FWDELTA_OK:
+            return kErrorOk;
+
+        case FWDELTA_ERR_BASE:
+            PRINTF("Delta does not match the stored update image!\n");
+            return kErrorInvalidOperation;
+
+        case FWDELTA_ERR_FLASH:
+            return kErrorGeneralError;
+
+        default:
+            PRINTF("Applying delta at offset 0x%X failed (%d)!\n", pDesc_p->offset, retDelta);
+            return kErrorInvalidOperation;
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write section file chunk
+
+This function writes a file chunk of a section transfer to flash. The first
+file chunk starts with the section update prefix, which is skipped.
+
+\param  pDesc_p     File chunk descriptor
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError writeSectionChunk(const tOplkApiFileChunkDesc* pDesc_p)
+{
+    tOplkError      ret;
+    const UINT8*    pData = drvInstance_l.pFileChunkBuffer;
+    UINT            length = pDesc_p->length;
+
+    if (pDesc_p->fFirst)
+    {
+        pData += sizeof(tFwImageSectionUpdate);
+        length -= sizeof(tFwImageSectionUpdate);
+    }
+
+    ret = writeImageData(pData, length);
+    if (ret != kErrorOk)
+        return ret;
+
+    if (pDesc_p->fLast)
+    {
+        ret = flushImageData();
+        if (ret != kErrorOk)
+            return ret;
+
+        return finishSectionWrite();
+    }
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Start writing sections of the update image
+
+This function prepares the update region for a section transfer. The sections
+in front of the replaced ones must match the stored update image. Their sectors
+are kept, only the sector shared with the first replaced section is rewritten.
+The firmware header is left erased until the transfer is finished, thus an
+interrupted transfer leaves an invalid update image.
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError startSectionWrite(void)
+{
+    tOplkError              ret;
+    tFwImageSectionUpdate*  pUpdate = &drvInstance_l.sectionUpdate;
+    tFwImageSectionTable    storedTable;
+    tFirmwareHeader         header;
+    UINT32                  imageBase = firmware_getImageBase(kFirmwareImageUpdate);
+    UINT32                  sectorSize = drvInstance_l.flashInfo.sectorSize;
+    UINT32                  startOffset;
+    UINT32                  sectorOffset;
+    UINT32                  firstSectorEnd;
+    UINT                    i;
+
+    // Check the new header and section table
+    OPLK_MEMCPY(&header, pUpdate->aHeader, sizeof(tFirmwareHeader));
+    if ((firmware_checkHeader(&header) != 0) ||
+        (fwimage_checkSectionTable(&pUpdate->sectionTable, header.length) != FWIMAGE_OK) ||
+        (pUpdate->sectionIndex >= FWIMAGE_SECTION_COUNT))
+    {
+        PRINTF("Invalid section update!\n");
+        return kErrorInvalidOperation;
+    }
+
+    // Check the stored header and section table
+    if (flash_read(imageBase, (UINT8*)&header, sizeof(tFirmwareHeader)) != 0)
+        return kErrorNoResource;
+
+    if ((firmware_checkHeader(&header) != 0) ||
+        (header.length < sizeof(tFwImageSectionTable)) ||
+        (flash_read(imageBase + sizeof(tFirmwareHeader) + header.length -
+                    sizeof(tFwImageSectionTable),
+                    (UINT8*)&storedTable, sizeof(tFwImageSectionTable)) != 0) ||
+        (fwimage_checkSectionTable(&storedTable, header.length) != FWIMAGE_OK))
+    {
+        PRINTF("Stored update image has no section table, full update required!\n");
+        return kErrorInvalidOperation;
+    }
+
+    // Kept sections must be identical
+    for (i = 0; i < pUpdate->sectionIndex; i++)
+    {
+        if ((storedTable.aSection[i].length != pUpdate->sectionTable.aSection[i].length) ||
+            (storedTable.aSection[i].crc != pUpdate->sectionTable.aSection[i].crc))
+        {
+            PRINTF("Section %d differs from stored update image, full update required!\n", i);
+            return kErrorInvalidOperation;
+        }
+    }
+
+    drvInstance_l.fUpdateImageWritten = TRUE;
+
+    startOffset = imageBase + sizeof(tFirmwareHeader) +
+                  pUpdate->sectionTable.aSection[pUpdate->sectionIndex].offset;
+    sectorOffset = startOffset - ((startOffset - imageBase) % sectorSize);
+    firstSectorEnd = imageBase + sectorSize;
+
+    // Rewrite the first sector without the header
+    ret = rewriteSector(imageBase, imageBase + sizeof(tFirmwareHeader),
+                        (startOffset < firstSectorEnd) ? startOffset : firstSectorEnd);
+    if (ret != kErrorOk)
+        return ret;
+
+    // Rewrite the sector shared by the kept and the replaced sections
+    if (sectorOffset != imageBase)
+    {
+        ret = rewriteSector(sectorOffset, sectorOffset, startOffset);
+        if (ret != kErrorOk)
+            return ret;
+    }
+
+    drvInstance_l.writeOffset = startOffset;
+    drvInstance_l.writeEraseOffset = sectorOffset + sectorSize;
+    drvInstance_l.streamOffset = 0;
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Finish writing sections of the update image
+
+This function verifies the replaced sections and the section table in flash.
+Finally the new firmware header is written, which makes the update image valid.
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError finishSectionWrite(void)
+{
+    tOplkError              ret;
+    tFwImageSectionUpdate*  pUpdate = &drvInstance_l.sectionUpdate;
+    tFwImageSectionTable    storedTable;
+    tFwImageSection*        pSection;
+    tFirmwareHeader         header;
+    UINT32                  imageOffset;
+    UINT32                  crc;
+    UINT                    i;
+
+    OPLK_MEMCPY(&header, pUpdate->aHeader, sizeof(tFirmwareHeader));
+    imageOffset = firmware_getImageBase(kFirmwareImageUpdate) + sizeof(tFirmwareHeader);
+
+    if (drvInstance_l.writeOffset != (imageOffset + header.length))
+    {
+        PRINTF("Section update has wrong length!\n");
+        return kErrorInvalidOperation;
+    }
+
+    // Verify the replaced sections only
+    for (i = pUpdate->sectionIndex; i < FWIMAGE_SECTION_COUNT; i++)
+    {
+        pSection = &pUpdate->sectionTable.aSection[i];
+
+        ret = calcFlashCrc(imageOffset + pSection->offset, pSection->length, &crc);
+        if (ret != kErrorOk)
+            return ret;
+
+        if (crc != pSection->crc)
+        {
+            PRINTF("Section %d has wrong CRC 0x%08X (0x%08X)!\n", i, crc, pSection->crc);
+            return kErrorInvalidOperation;
+        }
+    }
+
+    if ((flash_read(imageOffset + header.length - sizeof(tFwImageSectionTable),
+                    (UINT8*)&storedTable, sizeof(tFwImageSectionTable)) != 0) ||
+        (storedTable.tableCrc != pUpdate->sectionTable.tableCrc))
+    {
+        PRINTF("Section table was not written correctly!\n");
+        return kErrorGeneralError;
+    }
+
+    // Header area is still erased
+    return writeFlash(firmware_getImageBase(kFirmwareImageUpdate), (UINT8*)&header,
+                      sizeof(tFirmwareHeader));
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write probe file chunk
+
+This function writes a file chunk of a probe transfer to the scratch area. The
+probe prefix of the first chunk is skipped.
+
+\param  pDesc_p     File chunk descriptor
+\param  pChunk_p    File chunk data
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError writeProbeChunk(const tOplkApiFileChunkDesc* pDesc_p, const UINT8* pChunk_p)
+{
+    UINT    length = pDesc_p->length;
+
+    if (pDesc_p->fFirst)
+    {
+        pChunk_p += sizeof(tFwImageProbe);
+        length -= sizeof(tFwImageProbe);
+    }
+
+    return writeStagedChunk(pDesc_p, pChunk_p, length);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Start probe write
+
+This function places the scratch area of a probe transfer in the last sectors
+of the update region. A stored update image must not be overlapped, the probe
+is rejected otherwise. The data left in the scratch area is erased by the next
+image download before it is used.
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError startProbeWrite(void)
+{
+    tFwImageProbe   probe;
+    tFirmwareHeader header;
+    UINT32          imageBase = firmware_getImageBase(kFirmwareImageUpdate);
+    UINT32          sectorSize = drvInstance_l.flashInfo.sectorSize;
+    UINT32          regionEnd = getUpdateRegionEnd();
+    UINT32          imageEnd = imageBase;
+    UINT32          scratchLength;
+
+    OPLK_MEMCPY(&probe, drvInstance_l.pFileChunkBuffer, sizeof(tFwImageProbe));
+
+    scratchLength = ((probe.length + sectorSize - 1) / sectorSize) * sectorSize;
+
+    if (flash_read(imageBase, (UINT8*)&header, sizeof(tFirmwareHeader)) != 0)
+        return kErrorNoResource;
+
+    if (firmware_checkHeader(&header) == 0)
+        imageEnd += sizeof(tFirmwareHeader) + header.length;
+
+    if ((scratchLength == 0) || (imageEnd > regionEnd) ||
+        (scratchLength > (regionEnd - imageEnd)))
+    {
+        PRINTF("Probe of %u bytes does not fit behind the update image!\n", probe.length);
+        return kErrorNoResource;
+    }
+
+    drvInstance_l.writeOffset = regionEnd - scratchLength;
+    drvInstance_l.writeEraseOffset = drvInstance_l.writeOffset;
+    drvInstance_l.skipEnd = 0;
+    drvInstance_l.streamOffset = 0;
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Rewrite flash sector
+
+This function erases a flash sector and restores the given part of its content.
+The rest of the sector is left erased.
+
+\param  sectorOffset_p  Offset of the sector
+\param  keepOffset_p    Offset of the content to be kept
+\param  keepEnd_p       End of the content to be kept
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError rewriteSector(UINT32 sectorOffset_p, UINT32 keepOffset_p, UINT32 keepEnd_p)
+{
+    tOplkError  ret = kErrorOk;
+    UINT        keepLength = (keepEnd_p > keepOffset_p) ? (keepEnd_p - keepOffset_p) : 0;
+    UINT8*      pBuffer = NULL;
+
+    if (keepLength > 0)
+    {
+        pBuffer = mempool_alloc(keepLength);
+        if (pBuffer == NULL)
+            return kErrorNoResource;
+
+        if (flash_read(keepOffset_p, pBuffer, keepLength) != 0)
+        {
+            ret = kErrorNoResource;
+            goto Exit;
+        }
+    }
+
+    if (eraseFlash(sectorOffset_p) != 0)
+    {
+        ret = kErrorGeneralError;
+        goto Exit;
+    }
+
+    if (keepLength > 0)
+        ret = writeFlash(keepOffset_p, pBuffer, keepLength);
+
+Exit:
+    mempool_free(pBuffer);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Start writing the update image
+
+This function prepares the firmware update region for a new image by erasing
+its first sector. If the staging window is programmed in slices, the first
+sector is erased by the first flash job.
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError startImageWrite(void)
+{
+    UINT32  updateImageOffset = firmware_getImageBase(kFirmwareImageUpdate);
+
+    drvInstance_l.fUpdateImageWritten = TRUE;
+
+    // Reset write pointer
+    drvInstance_l.writeOffset = updateImageOffset;
+    drvInstance_l.streamOffset = 0;
+    drvInstance_l.skipEnd = 0;
+    drvInstance_l.sectorCrc = 0xFFFFFFFF;
+
+    if (isFlashSliced())
+    {
+        drvInstance_l.writeEraseOffset = updateImageOffset;
+        return kErrorOk;
+    }
+
+    // Erase first sector
+    if (eraseFlash(updateImageOffset) != 0)
+        return kErrorGeneralError;
+
+    // Set next sector to be erased
+    drvInstance_l.writeEraseOffset = updateImageOffset + drvInstance_l.flashInfo.sectorSize;
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write staged file chunk
+
+This function writes the data of a plain image or probe file chunk to the
+staging window and flushes the window after the last chunk. If the window is
+handed over to a flash job, the chunk is rejected with kErrorReject. The data
+staged so far is skipped when the host sends the chunk again, and the chunk
+completes after the flash job has finished.
+
+\param  pDesc_p     File chunk descriptor
+\param  pData_p     Data of the file chunk
+\param  length_p    Length of the data
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError writeStagedChunk(const tOplkApiFileChunkDesc* pDesc_p, const UINT8* pData_p,
+                                   UINT length_p)
+{
+    tOplkError  ret;
+    UINT32      stagedEnd = drvInstance_l.writeOffset + drvInstance_l.stagingFill;
+
+    ret = writeImageData(pData_p + drvInstance_l.chunkDone, length_p - drvInstance_l.chunkDone);
+    drvInstance_l.chunkDone += drvInstance_l.writeOffset + drvInstance_l.stagingFill - stagedEnd;
+
+    if ((ret == kErrorOk) && pDesc_p->fLast)
+        ret = flushImageData();
+
+    drvInstance_l.fChunkPending = (ret == kErrorReject);
+    if (!drvInstance_l.fChunkPending)
+        drvInstance_l.chunkDone = 0;
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write update image data
+
+This function writes the next part of the update image. The data is collected
+in the staging window, which is programmed to flash when it is full. Without
+staging window the data is programmed directly. Data which has been read into
+the staging window already is not copied again.
+
+\param  pData_p     Image data
+\param  length_p    Length of image data
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError writeImageData(const UINT8* pData_p, UINT length_p)
+{
+    tOplkError  ret;
+    UINT32      stagingOffset;
+    UINT32      stagingEnd;
+    UINT8*      pStaging;
+    UINT        length;
+
+    // Skip data committed before the transfer was resumed
+    if (drvInstance_l.writeOffset < drvInstance_l.skipEnd)
+    {
+        length = drvInstance_l.skipEnd - drvInstance_l.writeOffset;
+        if (length > length_p)
+            length = length_p;
+
+        drvInstance_l.writeOffset += length;
+        pData_p += length;
+        length_p -= length;
+
+        if (length_p == 0)
+            return kErrorOk;
+    }
+
+    // Check if write exceeds update region
+    if ((drvInstance_l.writeOffset + drvInstance_l.stagingFill + length_p) > getUpdateRegionEnd())
+        return kErrorNoResource;
+
+    if (drvInstance_l.pStagingBuffer == NULL)
+        return programImageData(pData_p, length_p);
+
+    while (length_p > 0)
+    {
+        stagingOffset = drvInstance_l.writeOffset + drvInstance_l.stagingFill;
+        stagingEnd = getStagingEnd();
+
+        length = stagingEnd - stagingOffset;
+        if (length > length_p)
+            length = length_p;
+
+        pStaging = drvInstance_l.pStagingBuffer + drvInstance_l.stagingFill;
+        if (pStaging != pData_p)
+            OPLK_MEMCPY(pStaging, pData_p, length);
+
+        drvInstance_l.stagingFill += length;
+        pData_p += length;
+        length_p -= length;
+
+        if ((stagingOffset + length) == stagingEnd)
+        {
+            ret = flushImageData();
+            if (ret != kErrorOk)
+                return ret;
+        }
+    }
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Flush update image data
+
+This function programs the data collected in the staging window to flash. If
+the window is programmed in slices, a flash job is started instead.
+
+\return This function returns tOplkError error codes.
+\retval kErrorReject    The flash job has been started.
+*/
+//------------------------------------------------------------------------------
+static tOplkError flushImageData(void)
+{
+    UINT32  length = drvInstance_l.stagingFill;
+
+    if (length == 0)
+        return kErrorOk;
+
+    if (isFlashSliced())
+        return startFlashJob();
+
+    drvInstance_l.stagingFill = 0;
+
+    return programImageData(drvInstance_l.pStagingBuffer, length);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get end of staging window
+
+This function returns the flash offset at which the current staging window
+ends. The windows are aligned to their size relative to the update image base.
+
+\return The function returns the end offset of the staging window.
+*/
+//------------------------------------------------------------------------------
+static UINT32 getStagingEnd(void)
+{
+    UINT32  imageBase = firmware_getImageBase(kFirmwareImageUpdate);
+
+    return drvInstance_l.writeOffset + drvInstance_l.stagingSize -
+           ((drvInstance_l.writeOffset - imageBase) % drvInstance_l.stagingSize);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get buffer for next file chunk
+
+This function selects the buffer the next file chunk is read into. A chunk
+continuing a plain update image is read directly behind the data in the
+staging window if a chunk of maximum size fits into the window. Otherwise, or
+while the window is programmed by a flash job or a chunk waits for it, the file
+chunk buffer is used and the data is copied to the window afterwards.
+
+\return The function returns the buffer for the next file chunk.
+*/
+//------------------------------------------------------------------------------
+static UINT8* getChunkBuffer(void)
+{
+    UINT32  stagingOffset;
+
+    if (((drvInstance_l.transferMode != kFileTransferRaw) &&
+         (drvInstance_l.transferMode != kFileTransferProbe)) ||
+        (drvInstance_l.pStagingBuffer == NULL) ||
+        (drvInstance_l.writeOffset < drvInstance_l.skipEnd) ||
+        (drvInstance_l.flashJob.state != kFlashJobIdle) ||
+        drvInstance_l.fChunkPending)
+        return drvInstance_l.pFileChunkBuffer;
+
+    stagingOffset = drvInstance_l.writeOffset + drvInstance_l.stagingFill;
+    if ((getStagingEnd() - stagingOffset) < drvInstance_l.fileChunkBufferSize)
+        return drvInstance_l.pFileChunkBuffer;
+
+    return drvInstance_l.pStagingBuffer + drvInstance_l.stagingFill;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Program update image data
+
+This function programs image data at the current write offset. All sectors
+crossed by the data are erased before.
+
+\param  pData_p     Image data
+\param  length_p    Length of image data
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError programImageData(const UINT8* pData_p, UINT length_p)
+{
+    tOplkError  ret;
+
+    // Erase all sectors crossed by the data
+    while ((drvInstance_l.writeOffset + length_p) > drvInstance_l.writeEraseOffset)
+    {
+        if (eraseFlash(drvInstance_l.writeEraseOffset) != 0)
+            return kErrorGeneralError;
+
+        drvInstance_l.writeEraseOffset += drvInstance_l.flashInfo.sectorSize;
+    }
+
+    // Forward data to flash
+    ret = writeFlash(drvInstance_l.writeOffset, pData_p, length_p);
+    if (ret != kErrorOk)
+        return ret;
+
+    if (drvInstance_l.fJournal)
+    {
+        ret = journalImageData(pData_p, length_p);
+        if (ret != kErrorOk)
+            return ret;
+    }
+
+    drvInstance_l.writeOffset += length_p;
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Start staging window
+
+This function allocates the staging window for a new transfer. If the window
+is disabled or not available, the image data is programmed directly.
+*/
+//------------------------------------------------------------------------------
+static void startStaging(void)
+{
+    mempool_free(drvInstance_l.pStagingBuffer);
+    drvInstance_l.pStagingBuffer = NULL;
+    drvInstance_l.stagingFill = 0;
+    drvInstance_l.stagingSize = drvInstance_l.flashInfo.sectorSize * DAEMON_STAGING_SECTORS;
+
+    if (drvInstance_l.stagingSize > 0)
+        drvInstance_l.pStagingBuffer = mempool_alloc(drvInstance_l.stagingSize);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Record image data in download journal
+
+This function accumulates the CRC of the data written at the current write
+offset and commits each sector which has been completely written.
+
+\param  pData_p     Image data written to flash
+\param  length_p    Length of image data
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError journalImageData(const UINT8* pData_p, UINT length_p)
+{
+    tOplkError  ret;
+    UINT32      sectorSize = drvInstance_l.flashInfo.sectorSize;
+    UINT32      imageBase = firmware_getImageBase(kFirmwareImageUpdate);
+    UINT32      offset = drvInstance_l.writeOffset;
+    UINT32      sectorEnd;
+    UINT        length;
+
+    while (length_p > 0)
+    {
+        sectorEnd = offset - ((offset - imageBase) % sectorSize) + sectorSize;
+        length = sectorEnd - offset;
+        if (length > length_p)
+            length = length_p;
+
+        firmware_calcCrc(&drvInstance_l.sectorCrc, (UINT8*)pData_p, length);
+
+        offset += length;
+        pData_p += length;
+        length_p -= length;
+
+        if (offset == sectorEnd)
+        {
+            ret = commitSector(sectorEnd - sectorSize);
+            if (ret != kErrorOk)
+                return ret;
+        }
+    }
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Commit sector
+
+This function verifies a completely written sector against the CRC of the data
+written to it and commits it to the download journal. If DAEMON_WRITE_VERIFY is
+enabled, writeFlash() has already read back and compared each byte of the
+sector, thus the CRC of the flash content is the CRC of the written data and
+the sector is not read again.
+
+\param  sectorOffset_p  Offset of the sector
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError commitSector(UINT32 sectorOffset_p)
+{
+#if (DAEMON_WRITE_VERIFY != FALSE)
+    return commitSectorCrc(sectorOffset_p, drvInstance_l.sectorCrc);
+#else
+    tOplkError  ret;
+    UINT32      crc;
+
+    ret = calcFlashCrc(sectorOffset_p, drvInstance_l.flashInfo.sectorSize, &crc);
+    if (ret != kErrorOk)
+        return ret;
+
+    return commitSectorCrc(sectorOffset_p, crc);
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Commit sector with CRC
+
+This function compares the CRC read back from a completely written sector to
+the CRC of the data written to it and commits the sector to the download
+journal.
+
+\param  sectorOffset_p  Offset of the sector
+\param  crc_p           CRC of the sector content read back from flash
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError commitSectorCrc(UINT32 sectorOffset_p, UINT32 crc_p)
+{
+    if (crc_p != drvInstance_l.sectorCrc)
+    {
+        PRINTF("Verifying sector at 0x%X failed!\n", sectorOffset_p);
+        publishFlashError(sectorOffset_p);
+        return kErrorGeneralError;
+    }
+
+    drvInstance_l.sectorCrc = 0xFFFFFFFF;
+
+    if (firmware_commitJournalSector(sectorOffset_p -
+                                     firmware_getImageBase(kFirmwareImageUpdate)) != 0)
+        return kErrorGeneralError;
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check if flash is programmed in slices
+
+The staging window of a plain image or probe transfer is programmed in slices
+while the kernel stack is initialized. A blocking erase or program of a whole
+window would stall the background loop, which serves the kernel stack then.
+The other transfer modes are refused in this state.
+
+\return The function returns TRUE if the staging window is programmed by flash
+        jobs.
+*/
+//------------------------------------------------------------------------------
+static BOOL isFlashSliced(void)
+{
+    if ((DAEMON_FLASH_SLICE_SIZE == 0) || !drvInstance_l.fStackInitialized)
+        return FALSE;
+
+    return (drvInstance_l.transferMode == kFileTransferRaw) ||
+           (drvInstance_l.transferMode == kFileTransferProbe);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Start flash job
+
+This function hands the staging window over to a flash job. The window stays
+occupied until the job has programmed it.
+
+\return The function returns kErrorReject, as the data is not yet programmed.
+*/
+//------------------------------------------------------------------------------
+static tOplkError startFlashJob(void)
+{
+    tFlashJob*  pJob = &drvInstance_l.flashJob;
+
+    pJob->endOffset = drvInstance_l.writeOffset + drvInstance_l.stagingFill;
+    pJob->pData = drvInstance_l.pStagingBuffer;
+    pJob->fEraseStarted = FALSE;
+    pJob->fJournalErase = FALSE;
+    pJob->result = kErrorOk;
+    pJob->state = kFlashJobErase;
+
+    return kErrorReject;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Process flash job
+
+This function executes the next slice of a pending flash job. The slices are
+separated by DAEMON_FLASH_SLICE_PERIOD_MS to leave the background loop to the
+kernel stack. The staging window is released when the job is done or has
+failed.
+*/
+//------------------------------------------------------------------------------
+static void processFlashJob(void)
+{
+    tFlashJob*  pJob = &drvInstance_l.flashJob;
+    tOplkError  ret = kErrorOk;
+    UINT32      now;
+
+    if (pJob->state == kFlashJobIdle)
+        return;
+
+    now = getTimeMs();
+    if ((now - pJob->lastSliceTime) < DAEMON_FLASH_SLICE_PERIOD_MS)
+        return;
+
+    pJob->lastSliceTime = now;
+
+    switch (pJob->state)
+    {
+        case kFlashJobErase:
+            ret = eraseSlice();
+            break;
+
+        case kFlashJobProgram:
+            ret = programSlice();
+            break;
+
+        case kFlashJobCommit:
+            ret = commitSlice();
+            break;
+
+        default:
+            break;
+    }
+
+    if (ret != kErrorOk)
+    {
+        PRINTF("Flash job at 0x%X failed (0x%X)!\n", drvInstance_l.writeOffset, ret);
+        pJob->result = ret;
+        pJob->state = kFlashJobIdle;
+    }
+
+    if (pJob->state == kFlashJobIdle)
+        drvInstance_l.stagingFill = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Wait until flash is idle
+
+This function waits for the end of a sector erase started by a flash job. The
+flash driver does not wait for it, thus it is only called when the kernel stack
+is shut down and the background loop is left.
+*/
+//------------------------------------------------------------------------------
+static void waitFlashIdle(void)
+{
+    while (flash_isBusy())
+        usleep(DAEMON_FLASH_SLICE_PERIOD_MS * 1000U);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Erase slice of flash job
+
+This function starts the erase of the next sector crossed by the job data or
+checks if the started erase is completed. The job continues with programming
+after all sectors are erased. A pending download journal is started before,
+its sector is erased the same way.
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError eraseSlice(void)
+{
+    tFlashJob*          pJob = &drvInstance_l.flashJob;
+    tFlashStatistics*   pStats = &drvInstance_l.flashStatistics;
+
+    if (pJob->fEraseStarted)
+    {
+        if (flash_isBusy())
+            return kErrorOk;
+
+        pJob->fEraseStarted = FALSE;
+
+        if (pJob->fJournalErase)
+        {
+            // The journal is started before the first sector to be committed is written
+            pJob->fJournalErase = FALSE;
+            drvInstance_l.fJournalPending = FALSE;
+            if (firmware_startJournal(&drvInstance_l.journalHeader, TRUE) == 0)
+                drvInstance_l.fJournal = TRUE;
+
+            return kErrorOk;
+        }
+
+        pStats->eraseTime += getTimeMs() - pJob->eraseStartTime;
+        pStats->eraseCount++;
+
+        drvInstance_l.writeEraseOffset += drvInstance_l.flashInfo.sectorSize;
+    }
+
+    if (drvInstance_l.fJournalPending)
+    {
+        if (flash_startEraseSector(firmware_getJournalBase()) != 0)
+            return kErrorGeneralError;
+
+        pJob->fJournalErase = TRUE;
+        pJob->fEraseStarted = TRUE;
+        return kErrorOk;
+    }
+
+    if (pJob->endOffset > drvInstance_l.writeEraseOffset)
+    {
+        if (flash_startEraseSector(drvInstance_l.writeEraseOffset) != 0)
+            return kErrorGeneralError;
+
+        pJob->eraseStartTime = getTimeMs();
+        pJob->fEraseStarted = TRUE;
+        return kErrorOk;
+    }
+
+    pJob->state = kFlashJobProgram;
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Program slice of flash job
+
+This function programs the job data up to the next DAEMON_FLASH_SLICE_SIZE
+boundary at the current write offset. If a sector of a journaled transfer is
+completed, it is committed. Without DAEMON_WRITE_VERIFY the job continues with
+reading the sector back before.
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError programSlice(void)
+{
+    tOplkError  ret;
+    tFlashJob*  pJob = &drvInstance_l.flashJob;
+    UINT32      sectorSize = drvInstance_l.flashInfo.sectorSize;
+    UINT32      imageBase = firmware_getImageBase(kFirmwareImageUpdate);
+    UINT32      offset = drvInstance_l.writeOffset;
+    UINT        length;
+
+    length = DAEMON_FLASH_SLICE_SIZE - (offset % DAEMON_FLASH_SLICE_SIZE);
+    if (length > (pJob->endOffset - offset))
+        length = pJob->endOffset - offset;
+
+    ret = writeFlash(offset, pJob->pData, length);
+    if (ret != kErrorOk)
+        return ret;
+
+    if (drvInstance_l.fJournal)
+        firmware_calcCrc(&drvInstance_l.sectorCrc, (UINT8*)pJob->pData, length);
+
+    pJob->pData += length;
+    drvInstance_l.writeOffset += length;
+
+    if (drvInstance_l.fJournal && (((drvInstance_l.writeOffset - imageBase) % sectorSize) == 0))
+    {
+#if (DAEMON_WRITE_VERIFY != FALSE)
+        ret = commitSector(drvInstance_l.writeOffset - sectorSize);
+        if (ret != kErrorOk)
+            return ret;
+#else
+        pJob->commitOffset = drvInstance_l.writeOffset - sectorSize;
+        pJob->commitLength = 0;
+        pJob->commitCrc = 0xFFFFFFFF;
+        pJob->state = kFlashJobCommit;
+        return kErrorOk;
+#endif
+    }
+
+    if (drvInstance_l.writeOffset == pJob->endOffset)
+        pJob->state = kFlashJobIdle;
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Commit slice of flash job
+
+This function reads back the next part of a completed sector, which is only
+needed without DAEMON_WRITE_VERIFY. The sector is committed to the download
+journal after it has been read completely.
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError commitSlice(void)
+{
+    tOplkError  ret;
+    tFlashJob*  pJob = &drvInstance_l.flashJob;
+    UINT32      sectorSize = drvInstance_l.flashInfo.sectorSize;
+    UINT        length = DAEMON_FLASH_SLICE_SIZE;
+
+    if (length > sizeof(aVerifyBuffer_l))
+        length = sizeof(aVerifyBuffer_l);
+
+    if (length > (sectorSize - pJob->commitLength))
+        length = sectorSize - pJob->commitLength;
+
+    if (flash_read(pJob->commitOffset + pJob->commitLength, aVerifyBuffer_l, length) != 0)
+        return kErrorNoResource;
+
+    firmware_calcCrc(&pJob->commitCrc, aVerifyBuffer_l, length);
+    pJob->commitLength += length;
+
+    if (pJob->commitLength < sectorSize)
+        return kErrorOk;
+
+    ret = commitSectorCrc(pJob->commitOffset, pJob->commitCrc);
+    if (ret != kErrorOk)
+        return ret;
+
+    pJob->state = (drvInstance_l.writeOffset == pJob->endOffset) ? kFlashJobIdle :
+                                                                  kFlashJobProgram;
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Erase flash sector
+
+This function erases a flash sector and accounts the erase time in the flash
+statistics.
+
+\param  offset_p    Offset of the sector
+
+\return This function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int eraseFlash(UINT32 offset_p)
+{
+    tFlashStatistics*   pStats = &drvInstance_l.flashStatistics;
+    UINT32              startTime = getTimeMs();
+    int                 ret;
+
+    ret = flash_eraseSector(offset_p);
+
+    pStats->eraseTime += getTimeMs() - startTime;
+    pStats->eraseCount++;
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write flash
+
+This function programs data to flash. If DAEMON_WRITE_VERIFY is enabled, the
+data is read back and compared after programming. Program and verify time are
+accounted in the flash statistics.
+
+\param  offset_p    Flash offset
+\param  pData_p     Data to be written
+\param  length_p    Length of data
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError writeFlash(UINT32 offset_p, const UINT8* pData_p, UINT length_p)
+{
+    tFlashStatistics*   pStats = &drvInstance_l.flashStatistics;
+    UINT32              startTime = getTimeMs();
+    int                 flashRet;
+
+    flashRet = flash_write(offset_p, (UINT8*)pData_p, length_p);
+
+    pStats->programTime += getTimeMs() - startTime;
+    pStats->programLength += length_p;
+
+    if (flashRet != 0)
+        return kErrorGeneralError;
+
+#if (DAEMON_WRITE_VERIFY != FALSE)
+    {
+        tOplkError  ret;
+
+        startTime = getTimeMs();
+        ret = verifyFlash(offset_p, pData_p, length_p);
+
+        pStats->verifyTime += getTimeMs() - startTime;
+        pStats->verifyLength += length_p;
+
+        return ret;
+    }
+#else
+    return kErrorOk;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Verify flash
+
+This function reads back the given flash area and compares it to the data
+which has been written. The offset of the first differing byte is published
+in the status area.
+
+\param  offset_p    Flash offset
+\param  pData_p     Data which has been written
+\param  length_p    Length of data
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError verifyFlash(UINT32 offset_p, const UINT8* pData_p, UINT length_p)
+{
+    UINT    length;
+    UINT    i;
+
+    while (length_p > 0)
+    {
+        if (length_p > sizeof(aVerifyBuffer_l))
+            length = sizeof(aVerifyBuffer_l);
+        else
+            length = length_p;
+
+        if (flash_read(offset_p, aVerifyBuffer_l, length) != 0)
+            return kErrorNoResource;
+
+        for (i = 0; i < length; i++)
+        {
+            if (aVerifyBuffer_l[i] != pData_p[i])
+            {
+                PRINTF("Flash verify failed at 0x%X (0x%02X instead of 0x%02X)!\n",
+                       offset_p + i, aVerifyBuffer_l[i], pData_p[i]);
+                publishFlashError(offset_p + i);
+                return kErrorGeneralError;
+            }
+        }
+
+        length_p -= length;
+        offset_p += length;
+        pData_p += length;
+    }
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get end of update region
+
+This function returns the end of the flash region available for the update
+image. The device header backup sector and the download journal are located
+behind it.
+
+\return This function returns the end offset of the update region.
+*/
+//------------------------------------------------------------------------------
+static UINT32 getUpdateRegionEnd(void)
+{
+    UINT32  backupBase = firmware_getDeviceBackupBase();
+    UINT32  journalBase = firmware_getJournalBase();
+
+    if (backupBase != FIRMWARE_INVALID_IMAGE_BASE)
+        return backupBase;
+
+    if (journalBase != FIRMWARE_INVALID_IMAGE_BASE)
+        return journalBase;
+
+    return drvInstance_l.flashInfo.size;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write decoded data
+
+This function is the output callback of the decoder. It writes the decoded
+block to flash.
+
+\param  pArg_p      Pointer to store the tOplkError of the write
+\param  pData_p     Decoded data
+\param  length_p    Length of decoded data
+
+\return This function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int writeDecodedData(void* pArg_p, const uint8_t* pData_p, size_t length_p)
+{
+    tOplkError* pRet = (tOplkError*)pArg_p;
+
+    *pRet = writeImageData(pData_p, (UINT)length_p);
+
+    return (*pRet == kErrorOk) ? 0 : -1;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read from update region
+
+This function is the flash read function of the delta applier.
+
+\param  pArg_p      Unused
+\param  offset_p    Offset within the update region
+\param  pDst_p      Buffer for the data
+\param  length_p    Length of data
+
+\return This function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int readUpdateRegion(void* pArg_p, uint32_t offset_p, uint8_t* pDst_p, size_t length_p)
+{
+    UNUSED_PARAMETER(pArg_p);
+
+    return flash_read(firmware_getImageBase(kFirmwareImageUpdate) + offset_p, pDst_p,
+                      (UINT)length_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Erase sector of update region
+
+This function is the flash erase function of the delta applier.
+
+\param  pArg_p      Unused
+\param  offset_p    Offset of the sector within the update region
+
+\return This function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int eraseUpdateRegion(void* pArg_p, uint32_t offset_p)
+{
+    UNUSED_PARAMETER(pArg_p);
+
+    if ((firmware_getImageBase(kFirmwareImageUpdate) + offset_p) >= getUpdateRegionEnd())
+        return -1;
+
+    return eraseFlash(firmware_getImageBase(kFirmwareImageUpdate) + offset_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write to update region
+
+This function is the flash write function of the delta applier.
+
+\param  pArg_p      Unused
+\param  offset_p    Offset within the update region
+\param  pSrc_p      Data to be written
+\param  length_p    Length of data
+
+\return This function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int writeUpdateRegion(void* pArg_p, uint32_t offset_p, const uint8_t* pSrc_p,
+                             size_t length_p)
+{
+    UNUSED_PARAMETER(pArg_p);
+
+    if (writeFlash(firmware_getImageBase(kFirmwareImageUpdate) + offset_p,
+                   pSrc_p, (UINT)length_p) != kErrorOk)
+        return -1;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Free file transfer buffers
+
+This function releases the buffers of a compressed or delta transfer and the
+staging window. Data left in the staging window is discarded.
+*/
+//------------------------------------------------------------------------------
+static void freeTransferBuffers(void)
+{
+    mempool_free(drvInstance_l.decoder.pInBuffer);
+    mempool_free(drvInstance_l.decoder.pOutBuffer);
+    drvInstance_l.decoder.pInBuffer = NULL;
+    drvInstance_l.decoder.pOutBuffer = NULL;
+
+    mempool_free(drvInstance_l.deltaApplier.pSectorBuffer);
+    drvInstance_l.deltaApplier.pSectorBuffer = NULL;
+
+    mempool_free(drvInstance_l.pStagingBuffer);
+    drvInstance_l.pStagingBuffer = NULL;
+    drvInstance_l.stagingFill = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Set next reconfigure firmware type
+
+This function sets the reconfiguration to a valid firmware image. It is
+rejected while the kernel stack is initialized, since the reconfiguration would
+stop the stack of a running control application. A downloaded update image
+stays in flash until the stack has been shut down.
+
+\note   Note that the reconfiguration itself may only be triggered after the
+        stack has been shutdown.
+
+\param  imageType_p         Firmware image type to be reconfigured
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError setNextReconfigFirmware(tFirmwareImageType imageType_p)
+{
+    tOplkError      ret;
+
+    if (drvInstance_l.fStackInitialized)
+    {
+        PRINTF("Reconfiguration rejected, the stack is initialized!\n");
+        return kErrorInvalidOperation;
+    }
+
+    // The flash job of the last file chunk may still own the flash
+    if (drvInstance_l.flashJob.state != kFlashJobIdle)
+        return kErrorReject;
+
+    switch (imageType_p)
+    {
+        case kFirmwareImageFactory:
+            drvInstance_l.nextImage = imageType_p;
+            return kErrorOk;
+
+        case kFirmwareImageUpdate:
+            // Update image must be verified before doing reconfiguration!
+            break;
+
+        default:
+            return kErrorInvalidOperation;
+    }
+
+    ret = checkUpdateImage();
+    drvInstance_l.fUpdateImageWritten = FALSE;
+    if (ret != kErrorOk)
+        return ret;
+
+    drvInstance_l.nextImage = imageType_p;
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Check update image
+
+This function checks the update image header and the update image itself.
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError checkUpdateImage(void)
+{
+    tOplkError      ret;
+    tFirmwareHeader firmwareHeader;
+    UINT32          crcVal;
+
+    if (flash_read(firmware_getImageBase(kFirmwareImageUpdate),
+       (UINT8*)&firmwareHeader, sizeof(tFirmwareHeader)) != 0)
+    {
+        return kErrorNoResource;
+    }
+
+    PRINTF("Firmware header:\n");
+    PRINTF(" Signature      0x%08X (0x%08X)\n", firmwareHeader.signature, FIRMWARE_HEADER_SIGNATUR);
+    PRINTF(" Version        0x%08X (0x%08X)\n", firmwareHeader.version, FIRMWARE_HEADER_VERSION);
+    PRINTF(" Time stamp     0x%08X\n", firmwareHeader.timeStamp);
+    PRINTF(" Length         0x%08X\n", firmwareHeader.length);
+    PRINTF(" CRC            0x%08X\n", firmwareHeader.crc);
+    PRINTF(" OPLK Version   0x%08X\n", firmwareHeader.oplkVersion);
+    PRINTF(" OPLK Feature   0x%08X\n", firmwareHeader.oplkFeature);
+    PRINTF(" Header CRC     0x%08X\n", firmwareHeader.headerCrc);
+
+    if (firmware_checkHeader(&firmwareHeader) != 0)
+        return kErrorGeneralError;
+
+    PRINTF("Calc image CRC...\n");
+
+    ret = calcFlashCrc(firmware_getImageBase(kFirmwareImageUpdate) + sizeof(tFirmwareHeader),
+                       firmwareHeader.length, &crcVal);
+    if (ret != kErrorOk)
+        return ret;
+
+    PRINTF("Calculated Image CRC = 0x%08X\n", crcVal);
+
+    if (crcVal != firmwareHeader.crc)
+    {
+        PRINTF(" --> Wrong CRC!\n");
+        return kErrorGeneralError;
+    }
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Calculate CRC of flash content
+
+This function calculates the CRC of the given flash area. The area is read
+into a static buffer to keep it off the stack.
+
+\param  offset_p    Offset of the flash area
+\param  length_p    Length of the flash area
+\param  pCrc_p      Pointer to store the CRC
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError calcFlashCrc(UINT32 offset_p, UINT32 length_p, UINT32* pCrc_p)
+{
+    UINT    length;
+
+    *pCrc_p = 0xFFFFFFFF;
+
+    while (length_p > 0)
+    {
+        if (length_p > sizeof(aVerifyBuffer_l))
+            length = sizeof(aVerifyBuffer_l);
+        else
+            length = length_p;
+
+        if (flash_read(offset_p, aVerifyBuffer_l, length) != 0)
+            return kErrorNoResource;
+
+        firmware_calcCrc(pCrc_p, aVerifyBuffer_l, length);
+
+        length_p -= length;
+        offset_p += length;
+    }
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Get MAC address
+
+This function gets the MAC address from the device header cached by the
+firmware module and writes it to the given address.
+
+\param  pMacAddr_p      Pointer to memory where the MAC address is returned.
+
+\return This function returns tOplkError error codes.
+*/
+//------------------------------------------------------------------------------
+static tOplkError getMacAddress(UINT8* pMacAddr_p)
+{
+    tFirmwareDeviceHeader   deviceHeader;
+
+    if (pMacAddr_p == NULL)
+        return kErrorGeneralError;
+
+    if (firmware_readDeviceHeader(&deviceHeader) != 0)
+        return kErrorGeneralError;
+
+    OPLK_MEMCPY(pMacAddr_p, deviceHeader.aMacAddr, 6);
+
+    return kErrorOk;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Get time
+
+This function returns the system timer converted to milliseconds.
+
+\return The function returns the time in milliseconds.
+*/
+//------------------------------------------------------------------------------
+static UINT32 getTimeMs(void)
+{
+    return (UINT32)(((UINT64)alt_nticks() * 1000U) / alt_ticks_per_second());
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Check if ctrl command polling is due
+
+The ctrl command block is polled on every background loop iteration while the
+kernel stack is initialized, since the ctrl module also serves the user-to-kernel
+queues then. Otherwise the PCP is idle and waits for the host to post a command
+or file chunk. After the first command is seen the polling runs at full rate
+for DAEMON_CTRL_ACTIVE_HOLD_MS, falling back to DAEMON_CTRL_IDLE_POLL_MS
+afterwards. This keeps the idle background loop off the shared memory.
+
+\return The function returns TRUE if ctrlk_process() shall be called.
+*/
+//------------------------------------------------------------------------------
+static BOOL isCtrlPollDue(void)
+{
+    UINT32  now;
+
+    if (drvInstance_l.fStackInitialized)
+        return TRUE;
+
+    now = getTimeMs();
+
+    if (((now - drvInstance_l.lastCtrlCmdTime) >= DAEMON_CTRL_ACTIVE_HOLD_MS) &&
+        ((now - drvInstance_l.lastCtrlPollTime) < DAEMON_CTRL_IDLE_POLL_MS))
+        return FALSE;
+
+    drvInstance_l.lastCtrlPollTime = now;
+
+    return TRUE;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Update kernel heartbeat
+
+This function updates the kernel heartbeat in the shared control block if
+DAEMON_HEARTBEAT_PERIOD_MS has elapsed since the last update.
+*/
+//------------------------------------------------------------------------------
+static void updateHeartbeat(void)
+{
+    UINT32  now = getTimeMs();
+
+    if ((now - drvInstance_l.lastHeartbeatTime) < DAEMON_HEARTBEAT_PERIOD_MS)
+        return;
+
+    drvInstance_l.lastHeartbeatTime = now;
+    drvInstance_l.bgtStatistics.heartbeatCount++;
+
+    ctrlk_updateHeartbeat();
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Update background loop status
+
+This function publishes the background loop statistics in the status area if
+DAEMON_STATUS_PERIOD_MS has elapsed since the last update.
+*/
+//------------------------------------------------------------------------------
+static void updateLoopStatus(void)
+{
+    UINT32  now = getTimeMs();
+
+    if ((now - drvInstance_l.lastStatusTime) < DAEMON_STATUS_PERIOD_MS)
+        return;
+
+    drvInstance_l.lastStatusTime = now;
+
+    publishBgtStatistics();
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Print background loop statistics
+
+This function prints the statistics of the background loop which has been left.
+*/
+//------------------------------------------------------------------------------
+static void printBgtStatistics(void)
+{
+    tBgtStatistics* pStats = &drvInstance_l.bgtStatistics;
+    UINT32          duration = getTimeMs() - pStats->startTime;
+
+    PRINTF("Background loop statistics:\n");
+    PRINTF(" Duration       %lu ms\n", (ULONG)duration);
+    PRINTF(" Iterations     %lu\n", (ULONG)pStats->loopCount);
+    PRINTF(" Ctrl polls     %lu\n", (ULONG)pStats->ctrlPollCount);
+    PRINTF(" Ctrl commands  %lu\n", (ULONG)pStats->ctrlCmdCount);
+    PRINTF(" Heartbeats     %lu\n", (ULONG)pStats->heartbeatCount);
+
+    if (duration > 0)
+    {
+        PRINTF(" Ctrl poll rate %lu 1/s\n",
+               (ULONG)(((UINT64)pStats->ctrlPollCount * 1000U) / duration));
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Publish background loop statistics
+
+This function copies the background loop statistics to the status area, thus
+the host can measure the ctrl polling load of a running kernel stack.
+*/
+//------------------------------------------------------------------------------
+static void publishBgtStatistics(void)
+{
+    tBgtStatistics* pStats = &drvInstance_l.bgtStatistics;
+    tPcpStatusLoop* pLoop = &pcpStatus_l.loop;
+
+    pLoop->duration = getTimeMs() - pStats->startTime;
+    pLoop->loopCount = pStats->loopCount;
+    pLoop->ctrlPollCount = pStats->ctrlPollCount;
+    pLoop->ctrlCmdCount = pStats->ctrlCmdCount;
+    pLoop->heartbeatCount = pStats->heartbeatCount;
+
+    publishStatus();
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print flash statistics
+
+This function prints the flash statistics of the completed file transfer. The
+last line holds the measured rates in the syntax of the fwimage timing model,
+it can be passed to "fwimage calibrate" to update the model of the card.
+*/
+//------------------------------------------------------------------------------
+static void printFlashStatistics(void)
+{
+    tFlashStatistics*   pStats = &drvInstance_l.flashStatistics;
+
+    PRINTF("Flash statistics of file transfer:\n");
+    PRINTF(" Duration       %lu ms\n", (ULONG)(getTimeMs() - pStats->startTime));
+    PRINTF(" Erased         %lu sectors in %lu ms\n",
+           (ULONG)pStats->eraseCount, (ULONG)pStats->eraseTime);
+    PRINTF(" Programmed     %lu bytes in %lu ms\n",
+           (ULONG)pStats->programLength, (ULONG)pStats->programTime);
+    PRINTF(" Verified       %lu bytes in %lu ms\n",
+           (ULONG)pStats->verifyLength, (ULONG)pStats->verifyTime);
+
+    PRINTF(" Timing model   flash_size=%lu sector_size=%lu",
+           (ULONG)drvInstance_l.flashInfo.size, (ULONG)drvInstance_l.flashInfo.sectorSize);
+
+    if (pStats->eraseCount > 0)
+        PRINTF(" erase_ms=%lu", (ULONG)(pStats->eraseTime / pStats->eraseCount));
+
+    // Rates below 1 KB are too inaccurate with the millisecond time base
+    if (pStats->programLength >= 1024U)
+    {
+        PRINTF(" program_us_per_kb=%lu",
+               (ULONG)(((UINT64)pStats->programTime * 1000U * 1024U) / pStats->programLength));
+    }
+
+    if (pStats->verifyLength >= 1024U)
+    {
+        PRINTF(" verify_us_per_kb=%lu",
+               (ULONG)(((UINT64)pStats->verifyTime * 1000U * 1024U) / pStats->verifyLength));
+    }
+
+    PRINTF("\n");
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Publish flash statistics
+
+This function copies the flash statistics of the completed file transfer to
+the status area. The host derives the timing model for "fwimage calibrate"
+from them, thus it needs no access to the JTAG console.
+*/
+//------------------------------------------------------------------------------
+static void publishFlashStatistics(void)
+{
+    tFlashStatistics*   pStats = &drvInstance_l.flashStatistics;
+    tPcpStatusFlash*    pFlash = &pcpStatus_l.flash;
+
+    pFlash->transferCount++;
+    pFlash->flashSize = drvInstance_l.flashInfo.size;
+    pFlash->sectorSize = drvInstance_l.flashInfo.sectorSize;
+    pFlash->duration = getTimeMs() - pStats->startTime;
+    pFlash->eraseCount = pStats->eraseCount;
+    pFlash->eraseTime = pStats->eraseTime;
+    pFlash->programLength = pStats->programLength;
+    pFlash->programTime = pStats->programTime;
+    pFlash->verifyLength = pStats->verifyLength;
+    pFlash->verifyTime = pStats->verifyTime;
+
+    publishStatus();
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Publish flash error
+
+This function publishes the flash offset of a verify error in the status area
+as soon as it occurs. The transfer is aborted then, thus the host reads the
+offset after the failed file chunk. With the staging window this is the chunk
+completing the window, not necessarily the chunk holding the offset.
+
+\param  offset_p    Flash offset of the first differing byte or of the sector
+                    whose CRC differs
+*/
+//------------------------------------------------------------------------------
+static void publishFlashError(UINT32 offset_p)
+{
+    pcpStatus_l.flash.errorCount++;
+    pcpStatus_l.flash.errorOffset = offset_p;
+
+    publishStatus();
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Publish memory pool statistics
+
+This function copies the memory pool statistics to the status area. The host
+reads the high-water marks from there to size the pool and the heap.
+*/
+//------------------------------------------------------------------------------
+static void publishMempoolStatistics(void)
+{
+    tMempoolStatistics  stats;
+    tPcpStatusMempool*  pMempool = &pcpStatus_l.mempool;
+    UINT                i;
+
+    mempool_getStatistics(&stats);
+
+    pMempool->arenaSize = stats.arenaSize;
+    pMempool->highWaterBytes = stats.highWaterBytes;
+    pMempool->failCount = stats.failCount;
+    pMempool->invalidFreeCount = stats.invalidFreeCount;
+
+    for (i = 0; i < MEMPOOL_CLASS_COUNT; i++)
+    {
+        pMempool->aClass[i].blockSize = stats.aClass[i].blockSize;
+        pMempool->aClass[i].blockCount = stats.aClass[i].blockCount;
+        pMempool->aClass[i].highWaterCount = stats.aClass[i].highWaterCount;
+        pMempool->aClass[i].spillCount = stats.aClass[i].spillCount;
+        pMempool->aClass[i].maxWasteBytes = stats.aClass[i].maxWasteBytes;
+    }
+
+    publishStatus();
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Reset session state
+
+This function resets the state of a kernel stack session before the stack is
+(re-)initialized. The state kept across warm restarts is left untouched.
+*/
+//------------------------------------------------------------------------------
+static void resetSession(void)
+{
+    drvInstance_l.writeOffset = 0;
+    drvInstance_l.writeEraseOffset = 0;
+    drvInstance_l.streamOffset = 0;
+    drvInstance_l.skipEnd = 0;
+    drvInstance_l.fJournal = FALSE;
+    drvInstance_l.fJournalPending = FALSE;
+    drvInstance_l.stagingFill = 0;
+    OPLK_MEMSET(&drvInstance_l.flashJob, 0, sizeof(tFlashJob));
+    drvInstance_l.fChunkPending = FALSE;
+    drvInstance_l.chunkDone = 0;
+    drvInstance_l.transferMode = kFileTransferRaw;
+    drvInstance_l.nextImage = kFirmwareImageUnknown;
+    drvInstance_l.fStackInitialized = FALSE;
+    drvInstance_l.lastCtrlPollTime = 0;
+    drvInstance_l.lastHeartbeatTime = 0;
+    drvInstance_l.lastStatusTime = 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Wait for the host to detach
+
+This function waits until the host has acknowledged its detach from the left
+kernel stack session in the status area, but at most for the given guard time.
+The firmware module (watchdog) is serviced meanwhile.
+
+\param  guardMs_p           Maximum time to wait in milliseconds
+*/
+//------------------------------------------------------------------------------
+static void waitHostDetach(UINT32 guardMs_p)
+{
+    UINT32  startTime = getTimeMs();
+
+    while ((getTimeMs() - startTime) < guardMs_p)
+    {
+        if (IORD_32DIRECT(DAEMON_STATUS_BASE, PCPSTATUS_DETACH_OFFSET) ==
+            pcpStatus_l.stack.readyCount)
+        {
+            PRINTF("Host detached after %lu ms\n", (ULONG)(getTimeMs() - startTime));
+            return;
+        }
+
+        firmware_process();
+    }
+}
+
+//------------------------------------------------------------------------------
+static void waitMs(UINT32 timeMs_p)
+{
+    UINT32  startTime = getTimeMs();
+
+    while ((getTimeMs() - startTime) < timeMs_p)
+        firmware_process();
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Record boot phase
+
+This function stores the current system time as completion time of the given
+boot phase and publishes the timeline in the status area.
+
+\param  phase_p             Boot phase which has been completed
+*/
+//------------------------------------------------------------------------------
+static void recordBootPhase(UINT phase_p)
+{
+    if (phase_p >= kPcpStatusBootPhaseCount)
+        return;
+
+    pcpStatus_l.boot.aTimeStamp[phase_p] = getTimeMs();
+    pcpStatus_l.boot.validMask |= (1U << phase_p);
+
+    publishStatus();
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Print boot timeline
+
+This function prints the recorded boot phases with their absolute time stamps
+and durations.
+*/
+//------------------------------------------------------------------------------
+static void printBootTimeline(void)
+{
+    UINT    phase;
+    UINT32  lastTimeStamp = 0;
+
+    PRINTF("Boot timeline (since system timer start):\n");
+
+    for (phase = 0; phase < kPcpStatusBootPhaseCount; phase++)
+    {
+        if ((pcpStatus_l.boot.validMask & (1U << phase)) == 0)
+            continue;
+
+        PRINTF(" %-14s %6lu ms (+%lu ms)\n", aBootPhaseName_l[phase],
+               (ULONG)pcpStatus_l.boot.aTimeStamp[phase],
+               (ULONG)(pcpStatus_l.boot.aTimeStamp[phase] - lastTimeStamp));
+
+        lastTimeStamp = pcpStatus_l.boot.aTimeStamp[phase];
+    }
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Publish kernel stack state
+
+This function publishes the state of the kernel stack in the status area. The
+host polls it to attach as soon as the stack is ready.
+
+\param  state_p             Kernel stack state (ePcpStatusStackState)
+*/
+//------------------------------------------------------------------------------
+static void publishStackState(UINT32 state_p)
+{
+    pcpStatus_l.stack.state = state_p;
+
+    publishStatus();
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief    Publish status area
+
+This function copies the status to the status area in the common memory, where
+host tools read it through the PCIe BAR. The magic is cleared during the copy,
+thus a host never evaluates a partly written area.
+*/
+//------------------------------------------------------------------------------
+static void publishStatus(void)
+{
+    const UINT32*   pWord = (const UINT32*)&pcpStatus_l;
+    UINT            offset;
+
+    pcpStatus_l.magic = PCPSTATUS_MAGIC;
+    pcpStatus_l.version = PCPSTATUS_VERSION;
+    pcpStatus_l.length = sizeof(tPcpStatus);
+
+    IOWR_32DIRECT(DAEMON_STATUS_BASE, 0, 0);
+
+    for (offset = sizeof(UINT32); offset < sizeof(tPcpStatus); offset += sizeof(UINT32))
+        IOWR_32DIRECT(DAEMON_STATUS_BASE, offset, pWord[offset / sizeof(UINT32)]);
+
+    IOWR_32DIRECT(DAEMON_STATUS_BASE, 0, pcpStatus_l.magic);
+}
+
 /// \}
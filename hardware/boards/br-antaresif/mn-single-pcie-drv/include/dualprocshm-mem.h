@@ -42,6 +42,7 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //------------------------------------------------------------------------------
 // includes
 //------------------------------------------------------------------------------
+#include <system.h>
 
 //------------------------------------------------------------------------------
 // const defines
@@ -59,14 +60,56 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define MEM_INTR_BASE               (MEM_ADDR_TABLE_BASE + MAX_DYNAMIC_BUFF_SIZE)
 #define TARGET_SYNC_INT_BASE        (PCIE_SUBSYSTEM_PCIE_IP_BASE + 0x50)
 
+/* Virtual Ethernet Tx queue */
+// The MN sends one VETH frame per cycle. When the queue is full, the host
+// waits for the frame sent event before it posts again, thus a queue of N
+// frames keeps the VETH slot busy as long as the host refills the queue
+// within N cycles. Throughput and latency for other cycle times and host
+// latencies are measured with "vethbench -S -c <CYCLE_US> -r <LATENCY_US>"
+// (tools/vethbench), the smallest depth reaching 100% of the slots is used.
+// 4 frames cover a host refill latency of 4 ms at 1 ms cycle time.
+#ifndef CONFIG_DLLCAL_VETH_TX_FRAME_COUNT
+#define CONFIG_DLLCAL_VETH_TX_FRAME_COUNT           4       ///< Number of full frames the VETH Tx queue can hold
+#endif
+
+// Maximum Ethernet frame (1514 bytes w/o CRC) plus circular buffer block
+// header, rounded up to a multiple of 32 bytes
+#define DLLCAL_VETH_TX_FRAME_SIZE                   1536
+
 /* Queue Size */
 #define CONFIG_EVENT_SIZE_CIRCBUF_KERNEL_TO_USER    4096
 #define CONFIG_EVENT_SIZE_CIRCBUF_USER_TO_KERNEL    4096
 #define CONFIG_DLLCAL_BUFFER_SIZE_TX_NMT            2048
 #define CONFIG_DLLCAL_BUFFER_SIZE_TX_GEN            4096
-#define CONFIG_DLLCAL_BUFFER_SIZE_TX_VETH           1024
+#define CONFIG_DLLCAL_BUFFER_SIZE_TX_VETH           (CONFIG_DLLCAL_VETH_TX_FRAME_COUNT * DLLCAL_VETH_TX_FRAME_SIZE)
 #define CONFIG_DLLCAL_BUFFER_SIZE_TX_SYNC           2048
 
+/* Queue memory budget */
+#define DUALPROCSHM_QUEUE_MEM_SIZE  (CONFIG_EVENT_SIZE_CIRCBUF_KERNEL_TO_USER + \
+                                     CONFIG_EVENT_SIZE_CIRCBUF_USER_TO_KERNEL + \
+                                     CONFIG_DLLCAL_BUFFER_SIZE_TX_NMT + \
+                                     CONFIG_DLLCAL_BUFFER_SIZE_TX_GEN + \
+                                     CONFIG_DLLCAL_BUFFER_SIZE_TX_VETH + \
+                                     CONFIG_DLLCAL_BUFFER_SIZE_TX_SYNC)
+
+// The queues share the SRAM with the process images and the dynamic buffers,
+// thus limit them to half of the shared memory.
+#ifndef CONFIG_DUALPROCSHM_QUEUE_MEM_BUDGET
+#define CONFIG_DUALPROCSHM_QUEUE_MEM_BUDGET         (SRAM_0_SIZE / 2)
+#endif
+
+#if (CONFIG_DLLCAL_VETH_TX_FRAME_COUNT < 1)
+#error "CONFIG_DLLCAL_VETH_TX_FRAME_COUNT must allow at least one frame!"
+#endif
+
+#if defined(SRAM_0_SIZE)
+#if (DUALPROCSHM_QUEUE_MEM_SIZE > CONFIG_DUALPROCSHM_QUEUE_MEM_BUDGET)
+#error "Queue sizes exceed the shared memory budget, reduce CONFIG_DLLCAL_VETH_TX_FRAME_COUNT!"
+#endif
+#else
+#error "SRAM_0_SIZE is not provided by system.h, the shared memory budget cannot be checked!"
+#endif
+
 //------------------------------------------------------------------------------
 // typedef
 //------------------------------------------------------------------------------
@@ -46,7 +46,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 //------------------------------------------------------------------------------
 #define FIRMWARE_FACTORY_IMAGE_BASE     0x000000
 #define FIRMWARE_UPDATE_IMAGE_BASE      0x080000
-#define FIRMWARE_DEVICE_HEADER_BASE     (FIRMWARE_UPDATE_IMAGE_BASE - 256)
+#define FIRMWARE_DEVICE_HEADER_SIZE     256
+#define FIRMWARE_DEVICE_HEADER_BASE     (FIRMWARE_UPDATE_IMAGE_BASE - FIRMWARE_DEVICE_HEADER_SIZE)
+#define FIRMWARE_JOURNAL_BITMAP_SIZE    64      // Download journal in last sector (512 sectors),
+                                                // device header backup in the sector before
 
 #define FIRMWARE_WDOG_ENABLE            0       // Deactivate WDOG
 #define FIRMWARE_WDOG_TIMEOUT           0xFFF   // Timeout is unused
@@ -37,11 +37,40 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #ifndef _INC_oplkcfg_board_H_
 #define _INC_oplkcfg_board_H_
 
+#include <system.h>
+
 // Size of kernel internal queue
 #define CONFIG_EVENT_SIZE_CIRCBUF_KERNEL_INTERNAL   16384
 
 // Set number of Rx buffers for openMAC
-//TODO: Use max Rx buffer for large network configuration after dualprocshm rework
-//#define CONFIG_EDRV_RX_BUFFERS                      32
+// PRes frames are processed in the Rx interrupt and release their buffer
+// before the next frame arrives, two buffers cover back-to-back frames. The
+// buffers of ASnd and VETH frames are only released after the kernel has
+// forwarded them from the background loop. The MN receives at most one async
+// frame per cycle, so the remaining buffers bridge a background loop stall of
+// that many cycles. The openMAC maximum of 32 buffers bridges 30 cycles, which
+// covers the longest flash or ctrl activity of the daemon at 1 ms cycle time.
+#define CONFIG_EDRV_RX_BUFFERS                      32
+
+// Size of one Rx buffer (maximum Ethernet frame incl. CRC, 32 byte aligned)
+#define BOARD_RX_BUFFER_SIZE                        1536
+
+// The Rx buffers are allocated from the heap in SRAM_0, which also holds the
+// code, the memory pool and the dualprocshm queues.
+#ifndef CONFIG_BOARD_RX_BUFFER_BUDGET
+#define CONFIG_BOARD_RX_BUFFER_BUDGET               (SRAM_0_SIZE / 16) ///< 64 KB of the 1 MB SRAM
+#endif
+
+#if (CONFIG_EDRV_RX_BUFFERS > 32)
+#error "openMAC supports at most 32 Rx buffers!"
+#endif
+
+#if defined(SRAM_0_SIZE)
+#if ((CONFIG_EDRV_RX_BUFFERS * BOARD_RX_BUFFER_SIZE) > CONFIG_BOARD_RX_BUFFER_BUDGET)
+#error "Rx buffers exceed the SRAM budget, reduce CONFIG_EDRV_RX_BUFFERS!"
+#endif
+#else
+#error "SRAM_0_SIZE is not provided by system.h, the Rx buffer budget cannot be checked!"
+#endif
 
 #endif /* _INC_oplkcfg_board_H_ */
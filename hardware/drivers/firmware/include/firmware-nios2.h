@@ -53,6 +53,10 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define FIRMWARE_DEVICE_HEADER_SIGNATURE    0x44455643  ///< Device signature
 #define FIRMWARE_DEVICE_HEADER_VERSION      0x00000001  ///< Device version
 
+#define FIRMWARE_DEVICE_BACKUP_SIGNATURE    0x4B424844  ///< Device header sector backup signature
+
+#define FIRMWARE_JOURNAL_SIGNATURE          0x314A5746  ///< Download journal signature
+
 //------------------------------------------------------------------------------
 // typedef
 //------------------------------------------------------------------------------
@@ -89,6 +93,54 @@ typedef struct
     UINT32              headerCrc;      ///< Device header crc
 } tFirmwareDeviceHeader;
 
+/**
+*  \brief Firmware device header record
+*
+*  The struct defines a device header record. Records are appended behind the
+*  plain device header in the device header area, the valid record with the
+*  highest sequence number replaces the plain device header. Older firmware only
+*  reads the plain device header.
+*/
+typedef struct
+{
+    UINT32              sequence;       ///< Record sequence number
+    UINT32              baseCrc;        ///< Header crc of the plain device header
+    tFirmwareDeviceHeader deviceHeader; ///< Device header
+    UINT32              recordCrc;      ///< Record crc
+} tFirmwareDeviceRecord;
+
+/**
+*  \brief Firmware device header sector backup
+*
+*  The struct defines the descriptor of the device header sector backup. It is
+*  stored at the location of the device header area in the backup sector, after
+*  the rest of the sector has been copied there. A valid descriptor marks an
+*  interrupted compaction of the device header area.
+*/
+typedef struct
+{
+    UINT32              signature;      ///< Backup signature, cleared after restore
+    UINT32              sectorOffset;   ///< Offset of the device header sector
+    UINT32              dataCrc;        ///< Crc of the copied sector data
+    tFirmwareDeviceHeader deviceHeader; ///< New plain device header
+    UINT32              backupCrc;      ///< Crc of the descriptor
+} tFirmwareDeviceBackup;
+
+/**
+*  \brief Firmware download journal
+*
+*  The struct defines the download journal which is stored at the start of the
+*  last Flash sector. It identifies the update image being downloaded and is
+*  followed by a bitmap of the update image sectors, where a cleared bit marks
+*  a sector which has been written and verified.
+*/
+typedef struct
+{
+    UINT32              signature;      ///< Journal signature
+    tFirmwareHeader     imageHeader;    ///< Header of the downloaded image
+    UINT32              journalCrc;     ///< Crc of signature and image header
+} tFirmwareJournal;
+
 //------------------------------------------------------------------------------
 // function prototypes
 //------------------------------------------------------------------------------
@@ -108,6 +108,15 @@ UINT32              firmware_getDeviceHeaderBase(void);
 int                 firmware_calcCrc(UINT32* pCrcVal_p, UINT8* pBuffer_p, INT length_p);
 int                 firmware_checkHeader(tFirmwareHeader* pHeader_p);
 int                 firmware_checkDeviceHeader(tFirmwareDeviceHeader* pHeader_p);
+int                 firmware_readDeviceHeader(tFirmwareDeviceHeader* pHeader_p);
+int                 firmware_writeDeviceHeader(tFirmwareDeviceHeader* pHeader_p);
+UINT32              firmware_getDeviceBackupBase(void);
+
+UINT32              firmware_getJournalBase(void);
+int                 firmware_startJournal(tFirmwareHeader* pHeader_p, BOOL fErased_p);
+int                 firmware_commitJournalSector(UINT32 offset_p);
+int                 firmware_getJournalResumeOffset(tFirmwareHeader* pHeader_p, UINT32* pOffset_p);
+int                 firmware_clearJournal(void);
 
 void                firmware_process(void);
 void                firmware_reconfig(tFirmwareImageType next_p);
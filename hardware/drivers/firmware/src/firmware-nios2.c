@@ -40,10 +40,13 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // includes
 //------------------------------------------------------------------------------
 #include <firmware.h>
+#include <flash.h>
+#include <crc32.h>
 #include <oplk/oplk.h>
 
 #include <system.h>
 #include <io.h>
+#include <sys/alt_alarm.h>
 #include <stdlib.h>
 #include <unistd.h>
 
@@ -99,6 +102,24 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define FIRMWARE_WDOG_MAXVALUE          0xFFF
 #define FIRMWARE_WDOG_RESET             0x02
 
+// The watchdog timeout value is compared to the upper 12 bits of a 29 bit
+// counter clocked by the 10 MHz internal oscillator (2^17 / 10 MHz).
+#define FIRMWARE_WDOG_TICK_US           13107
+
+// Service the watchdog at a fraction of its timeout
+#ifndef FIRMWARE_WDOG_SERVICE_DIVIDER
+#define FIRMWARE_WDOG_SERVICE_DIVIDER   4
+#endif
+
+// The watchdog of the update image is configured by the factory image, which
+// may have been built with a shorter timeout. Thus, limit the service period.
+#ifndef FIRMWARE_WDOG_SERVICE_MAX_MS
+#define FIRMWARE_WDOG_SERVICE_MAX_MS    100
+#endif
+
+#define FIRMWARE_WDOG_SERVICE_MS        (((FIRMWARE_WDOG_TIMEOUT * FIRMWARE_WDOG_TICK_US) / 1000U) / \
+                                         FIRMWARE_WDOG_SERVICE_DIVIDER)
+
 #define FIRMWARE_RECONFIG               0x01
 
 // Invalidate not set image base addresses
@@ -110,6 +131,23 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 #define FIRMWARE_UPDATE_IMAGE_BASE      FIRMWARE_INVALID_IMAGE_BASE
 #endif
 
+#ifndef FIRMWARE_DEVICE_HEADER_SIZE
+#define FIRMWARE_DEVICE_HEADER_SIZE     sizeof(tFirmwareDeviceHeader)
+#endif
+
+// Download journal layout
+#ifndef FIRMWARE_JOURNAL_BITMAP_SIZE
+#define FIRMWARE_JOURNAL_BITMAP_SIZE    64
+#endif
+
+#define FIRMWARE_JOURNAL_BITMAP_OFFSET  64
+
+// Device header log layout, the plain device header occupies the first slot
+#define FIRMWARE_DEVICE_RECORD_SIZE     sizeof(tFirmwareDeviceRecord)
+#define FIRMWARE_DEVICE_RECORD_COUNT    ((FIRMWARE_DEVICE_HEADER_SIZE / FIRMWARE_DEVICE_RECORD_SIZE) - 1)
+
+#define FIRMWARE_COPY_CHUNK_SIZE        256     ///< Chunk size for copying Flash data
+
 //------------------------------------------------------------------------------
 // local types
 //------------------------------------------------------------------------------
@@ -123,6 +161,23 @@ typedef struct
 {
     BOOL                fInitialized;   ///< Initialization flag for firmware module
     BOOL                fResetWdog;     ///< Reset Watchdog to avoid reconfig
+    UINT32              wdogServicePeriod; ///< Watchdog service period [ms]
+    UINT32              lastWdogService;   ///< Time of last watchdog service [ms]
+    BOOL                fDeviceHeaderLoaded; ///< Device header area has been read
+    BOOL                fDeviceHeaderValid;  ///< Cached device header is valid
+    BOOL                fDeviceHeaderErased; ///< Device header area is erased
+    BOOL                fDevicePlainValid; ///< Plain device header is valid
+    tFirmwareDeviceHeader deviceHeader;    ///< Cached copy of the valid device header
+    UINT32              deviceBaseCrc;     ///< Header crc of the plain device header
+    UINT32              deviceSequence;    ///< Sequence number of the latest device header record
+    UINT                deviceRecordNext;  ///< Index of the next free device header record
+    UINT32              deviceBackupBase;  ///< Base of the device header backup sector
+    UINT32              journalBase;       ///< Base of the download journal
+    UINT32              sectorSize;        ///< Flash sector size
+    BOOL                fJournalValid;     ///< Download journal is valid
+    tFirmwareJournal    journal;           ///< Cached copy of the download journal
+    UINT8               aJournalBitmap[FIRMWARE_JOURNAL_BITMAP_SIZE]; ///< Committed sectors
+    UINT                journalCommitted;  ///< Number of leading committed sectors
 
 } tFirmwareInstance;
 
@@ -148,6 +203,20 @@ static UINT32 getReconfigCondition(UINT past_p);
 static UINT32 getBootAddress(UINT past_p);
 static void triggerReconfig(void);
 
+static UINT32 getTimeMs(void);
+
+static int loadDeviceHeader(void);
+static BOOL isErased(const UINT8* pBuffer_p, UINT length_p);
+static int appendDeviceRecord(tFirmwareDeviceHeader* pHeader_p);
+static int compactDeviceHeader(tFirmwareDeviceHeader* pHeader_p);
+static int recoverDeviceSector(void);
+static int restoreDeviceSector(tFirmwareDeviceBackup* pBackup_p);
+static int copyDeviceSector(UINT32 dstBase_p, UINT32 srcBase_p, UINT32* pCrc_p);
+static int copyFlash(UINT32 dst_p, UINT32 src_p, UINT32 length_p, UINT32* pCrc_p);
+
+static int loadJournal(void);
+static UINT countCommittedSectors(void);
+
 //============================================================================//
 //            P U B L I C   F U N C T I O N S                                 //
 //============================================================================//
@@ -156,7 +225,11 @@ static void triggerReconfig(void);
 /**
 \brief  Initialize Firmware module
 
-The function initializes the Firmware module before being used.
+The function initializes the Firmware module before being used. It loads the
+download journal, completes an interrupted compaction of the device header area
+and loads the device header, thus the Flash module must be initialized before.
+A failure to load the device header does not fail the initialization, it is
+retried on its first use.
 
 \return The function returns 0 if the Firmware module has been initialized
         successfully, otherwise -1.
@@ -169,6 +242,22 @@ int firmware_init(void)
     memset((void*)&firmwareInstance_l, 0, sizeof(tFirmwareInstance));
 
     firmwareInstance_l.fResetWdog = getWdogEnable();
+
+    firmwareInstance_l.wdogServicePeriod = FIRMWARE_WDOG_SERVICE_MS;
+    if (firmwareInstance_l.wdogServicePeriod > FIRMWARE_WDOG_SERVICE_MAX_MS)
+        firmwareInstance_l.wdogServicePeriod = FIRMWARE_WDOG_SERVICE_MAX_MS;
+
+    firmwareInstance_l.lastWdogService = getTimeMs();
+
+    if (loadJournal() != 0)
+        ret = -1;
+
+    if (recoverDeviceSector() != 0)
+        ret = -1;
+
+    if (!firmwareInstance_l.fDeviceHeaderLoaded)
+        loadDeviceHeader();
+
     firmwareInstance_l.fInitialized = TRUE;
 
     return ret;
@@ -324,7 +413,7 @@ The function calculates the CRC value of the given buffer. The caller must
 provide a 32 bit buffer which is used to calculate the CRC chunk-wise.
 The caller must initialize the buffer to 0xFFFFFFFF.
 
-\note   This implementation bases on AN458.
+\note   The CRC is calculated by the shared CRC32 module (contrib/crc32).
 
 \param  pCrcVal_p   Buffer for CRC value calculation
 \param  pBuffer_p   Pointer to buffer of chunk data for CRC calculation
@@ -335,27 +424,10 @@ The function returns 0 if the CRC calculation was successful, otherwise -1.
 //------------------------------------------------------------------------------
 int firmware_calcCrc(UINT32* pCrcVal_p, UINT8* pBuffer_p, INT length_p)
 {
-    UINT32  crcval;
-    UINT8   cval;
-    int     i;
-
-    if (pCrcVal_p == NULL)
+    if ((pCrcVal_p == NULL) || (length_p < 0))
         return -1;
 
-    crcval = *pCrcVal_p;
-
-    for (; length_p; length_p--)
-    {
-        cval = *pBuffer_p;
-        crcval ^= cval;
-
-        for (i=8; i; i--)
-            crcval = (crcval & 0x00000001) ? ((crcval >> 1) ^ 0xEDB88320) : (crcval >> 1);
-
-        pBuffer_p++;
-    }
-
-    *pCrcVal_p = crcval;
+    *pCrcVal_p = crc32_calc(*pCrcVal_p, pBuffer_p, (size_t)length_p);
 
     return 0;
 }
@@ -418,18 +490,298 @@ int firmware_checkDeviceHeader(tFirmwareDeviceHeader* pHeader_p)
     return 0;
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Read firmware device header
+
+The function returns the valid device header. The header is read from Flash by
+firmware_init() and kept up to date by firmware_writeDeviceHeader(), thus no
+Flash access is needed. Only if the Flash read in firmware_init() failed, it is
+retried here.
+
+\param  pHeader_p   Pointer to store the device header
+
+\return The function returns 0 if a valid device header was read, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+int firmware_readDeviceHeader(tFirmwareDeviceHeader* pHeader_p)
+{
+    if (pHeader_p == NULL)
+        return -1;
+
+    // Fallback if the load in firmware_init() failed
+    if (!firmwareInstance_l.fDeviceHeaderLoaded && (loadDeviceHeader() != 0))
+        return -1;
+
+    if (!firmwareInstance_l.fDeviceHeaderValid)
+        return -1;
+
+    *pHeader_p = firmwareInstance_l.deviceHeader;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write firmware device header
+
+The function writes the given device header to the device header area. The
+signature, version and header CRC are set by this function.
+An unchanged header is not written at all. An erased area, e.g. of a new card,
+gets the plain header at the base of the area, which is also read by older
+firmware. Otherwise a record is appended behind the plain header, each needs
+programming a single Flash page. Only a full or corrupted area is compacted,
+which rewrites the plain header and erases the sector.
+
+\param  pHeader_p   Pointer to the device header to be written
+
+\return The function returns 0 if the device header was written, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+int firmware_writeDeviceHeader(tFirmwareDeviceHeader* pHeader_p)
+{
+    UINT32  crcval = 0xFFFFFFFF;
+
+    if ((pHeader_p == NULL) ||
+        (firmware_getDeviceHeaderBase() == FIRMWARE_INVALID_IMAGE_BASE))
+        return -1;
+
+    pHeader_p->signature = FIRMWARE_DEVICE_HEADER_SIGNATURE;
+    pHeader_p->version = FIRMWARE_DEVICE_HEADER_VERSION;
+
+    if (firmware_calcCrc(&crcval, (UINT8*)pHeader_p, sizeof(tFirmwareDeviceHeader) - 4) != 0)
+        return -1;
+
+    pHeader_p->headerCrc = crcval;
+
+    // Fallback if the load in firmware_init() failed
+    if (!firmwareInstance_l.fDeviceHeaderLoaded && (loadDeviceHeader() != 0))
+        return -1;
+
+    if (firmwareInstance_l.fDeviceHeaderValid &&
+        (OPLK_MEMCMP(&firmwareInstance_l.deviceHeader, pHeader_p,
+                     sizeof(tFirmwareDeviceHeader)) == 0))
+        return 0;
+
+    if (firmwareInstance_l.fDeviceHeaderErased)
+    {
+        if (flash_write(firmware_getDeviceHeaderBase(), (UINT8*)pHeader_p,
+                        sizeof(tFirmwareDeviceHeader)) != 0)
+            return -1;
+
+        firmwareInstance_l.fDeviceHeaderErased = FALSE;
+        firmwareInstance_l.fDeviceHeaderValid = TRUE;
+        firmwareInstance_l.fDevicePlainValid = TRUE;
+        firmwareInstance_l.deviceHeader = *pHeader_p;
+        firmwareInstance_l.deviceBaseCrc = pHeader_p->headerCrc;
+        firmwareInstance_l.deviceSequence = 0;
+        firmwareInstance_l.deviceRecordNext = 0;
+
+        return 0;
+    }
+
+    if (firmwareInstance_l.fDevicePlainValid &&
+        (firmwareInstance_l.deviceRecordNext < FIRMWARE_DEVICE_RECORD_COUNT))
+        return appendDeviceRecord(pHeader_p);
+
+    return compactDeviceHeader(pHeader_p);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get device header backup base
+
+The function returns the base of the sector used to back up the device header
+sector during compaction of the device header area. It is located before the
+download journal, thus the update image must end before it.
+
+\return The function returns the device header backup base.
+\retval FIRMWARE_INVALID_IMAGE_BASE     If no backup sector is available.
+*/
+//------------------------------------------------------------------------------
+UINT32 firmware_getDeviceBackupBase(void)
+{
+    return firmwareInstance_l.deviceBackupBase;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get download journal base
+
+The function returns the base of the download journal, which is located in the
+last Flash sector. The update image must end before the journal.
+
+\return The function returns the download journal base.
+\retval FIRMWARE_INVALID_IMAGE_BASE     If no download journal is available.
+*/
+//------------------------------------------------------------------------------
+UINT32 firmware_getJournalBase(void)
+{
+    return firmwareInstance_l.journalBase;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Start download journal
+
+The function starts a new download journal for the given update image. All
+sectors of the update image are marked as not written. The journal sector is
+erased unless the caller has already erased it, e.g. without blocking by
+flash_startEraseSector().
+
+\param  pHeader_p   Pointer to the header of the downloaded update image
+\param  fErased_p   TRUE if the journal sector has already been erased
+
+\return The function returns 0 if the journal was started, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+int firmware_startJournal(tFirmwareHeader* pHeader_p, BOOL fErased_p)
+{
+    tFirmwareJournal*   pJournal = &firmwareInstance_l.journal;
+    UINT32              crcval = 0xFFFFFFFF;
+
+    if ((pHeader_p == NULL) || (firmwareInstance_l.journalBase == FIRMWARE_INVALID_IMAGE_BASE))
+        return -1;
+
+    firmwareInstance_l.fJournalValid = FALSE;
+
+    if (!fErased_p && (flash_eraseSector(firmwareInstance_l.journalBase) != 0))
+        return -1;
+
+    pJournal->signature = FIRMWARE_JOURNAL_SIGNATURE;
+    pJournal->imageHeader = *pHeader_p;
+    firmware_calcCrc(&crcval, (UINT8*)pJournal, sizeof(tFirmwareJournal) - 4);
+    pJournal->journalCrc = crcval;
+
+    if (flash_write(firmwareInstance_l.journalBase, (UINT8*)pJournal,
+                    sizeof(tFirmwareJournal)) != 0)
+        return -1;
+
+    OPLK_MEMSET(firmwareInstance_l.aJournalBitmap, 0xFF, FIRMWARE_JOURNAL_BITMAP_SIZE);
+    firmwareInstance_l.journalCommitted = 0;
+    firmwareInstance_l.fJournalValid = TRUE;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Commit sector to download journal
+
+The function marks the given sector of the update image as written and
+verified. Only a single byte of the bitmap is programmed.
+
+\param  offset_p    Offset of the sector relative to the update image base
+
+\return The function returns 0 if the sector was committed, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+int firmware_commitJournalSector(UINT32 offset_p)
+{
+    UINT    sector;
+    UINT8   bitmap;
+
+    if (!firmwareInstance_l.fJournalValid)
+        return -1;
+
+    sector = offset_p / firmwareInstance_l.sectorSize;
+    if (sector >= (FIRMWARE_JOURNAL_BITMAP_SIZE * 8))
+        return -1;
+
+    bitmap = firmwareInstance_l.aJournalBitmap[sector / 8] & ~(1 << (sector % 8));
+
+    if (flash_write(firmwareInstance_l.journalBase + FIRMWARE_JOURNAL_BITMAP_OFFSET + (sector / 8),
+                    &bitmap, 1) != 0)
+        return -1;
+
+    firmwareInstance_l.aJournalBitmap[sector / 8] = bitmap;
+    firmwareInstance_l.journalCommitted = countCommittedSectors();
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get resume offset from download journal
+
+The function returns the offset from which an interrupted download of the given
+update image can be resumed. All sectors before this offset have been written
+and verified.
+
+\param  pHeader_p   Pointer to the header of the update image to be downloaded
+\param  pOffset_p   Pointer to store the resume offset
+
+\return The function returns 0 if the journal belongs to the given update image,
+        otherwise -1.
+*/
+//------------------------------------------------------------------------------
+int firmware_getJournalResumeOffset(tFirmwareHeader* pHeader_p, UINT32* pOffset_p)
+{
+    tFirmwareHeader*    pJournalHeader = &firmwareInstance_l.journal.imageHeader;
+
+    if ((pHeader_p == NULL) || (pOffset_p == NULL) || !firmwareInstance_l.fJournalValid)
+        return -1;
+
+    // The header CRC covers time stamp, length and CRC of the image
+    if ((firmware_checkHeader(pHeader_p) != 0) ||
+        (pHeader_p->headerCrc != pJournalHeader->headerCrc) ||
+        (pHeader_p->length != pJournalHeader->length) ||
+        (pHeader_p->crc != pJournalHeader->crc))
+        return -1;
+
+    *pOffset_p = firmwareInstance_l.journalCommitted * firmwareInstance_l.sectorSize;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Clear download journal
+
+The function invalidates the download journal by programming its signature,
+thus no erase is needed.
+
+\return The function returns 0 if the journal was cleared, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+int firmware_clearJournal(void)
+{
+    UINT32  signature = 0;
+
+    if (!firmwareInstance_l.fJournalValid)
+        return 0;
+
+    firmwareInstance_l.fJournalValid = FALSE;
+
+    if (flash_write(firmwareInstance_l.journalBase, (UINT8*)&signature, sizeof(signature)) != 0)
+        return -1;
+
+    return 0;
+}
+
 //------------------------------------------------------------------------------
 /**
 \brief  Firmware process function
 
 This is the firmware process function, which shall be called on a regular basis.
+The watchdog is only serviced when its service period has elapsed, thus the
+function is cheap to call from a busy loop.
 
 */
 //------------------------------------------------------------------------------
 void firmware_process(void)
 {
-    if (firmwareInstance_l.fResetWdog)
-        resetWdog();
+    UINT32  now;
+
+    if (!firmwareInstance_l.fResetWdog)
+        return;
+
+    now = getTimeMs();
+    if ((now - firmwareInstance_l.lastWdogService) < firmwareInstance_l.wdogServicePeriod)
+        return;
+
+    firmwareInstance_l.lastWdogService = now;
+    resetWdog();
 }
 
 //------------------------------------------------------------------------------
@@ -749,4 +1101,442 @@ static void triggerReconfig(void)
     FIRMWARE_IO_WR(0x20, FIRMWARE_RECONFIG);
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Load device header
+
+This function reads the device header area and builds the index of the device
+header log. The valid device header is the latest valid record appended to a
+valid plain header, or the plain header itself. The function also notes whether
+the area is erased, thus a header can be programmed without erasing the sector.
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int loadDeviceHeader(void)
+{
+    UINT8                   aArea[FIRMWARE_DEVICE_HEADER_SIZE];
+    tFirmwareDeviceHeader*  pPlain = (tFirmwareDeviceHeader*)aArea;
+    tFirmwareDeviceRecord*  pRecord;
+    UINT32                  offset = firmware_getDeviceHeaderBase();
+    UINT32                  crcval;
+    UINT                    index;
+
+    firmwareInstance_l.fDeviceHeaderValid = FALSE;
+    firmwareInstance_l.fDeviceHeaderErased = FALSE;
+    firmwareInstance_l.fDevicePlainValid = FALSE;
+    firmwareInstance_l.deviceSequence = 0;
+    firmwareInstance_l.deviceRecordNext = FIRMWARE_DEVICE_RECORD_COUNT;
+
+    if (offset == FIRMWARE_INVALID_IMAGE_BASE)
+        return -1; // No device header available
+
+    if (flash_read(offset, aArea, sizeof(aArea)) != 0)
+        return -1;
+
+    firmwareInstance_l.fDeviceHeaderLoaded = TRUE;
+
+    if (firmware_checkDeviceHeader(pPlain) != 0)
+    {
+        // Records only apply to a valid plain header
+        firmwareInstance_l.fDeviceHeaderErased = isErased(aArea, sizeof(aArea));
+        return 0;
+    }
+
+    firmwareInstance_l.fDeviceHeaderValid = TRUE;
+    firmwareInstance_l.fDevicePlainValid = TRUE;
+    firmwareInstance_l.deviceHeader = *pPlain;
+    firmwareInstance_l.deviceBaseCrc = pPlain->headerCrc;
+
+    for (index = 0; index < FIRMWARE_DEVICE_RECORD_COUNT; index++)
+    {
+        pRecord = (tFirmwareDeviceRecord*)(aArea + ((index + 1) * FIRMWARE_DEVICE_RECORD_SIZE));
+
+        // Records are appended in order, thus the first erased slot ends the log
+        if (isErased((UINT8*)pRecord, FIRMWARE_DEVICE_RECORD_SIZE))
+        {
+            firmwareInstance_l.deviceRecordNext = index;
+            break;
+        }
+
+        // Skip torn records and records appended to an older plain header
+        crcval = 0xFFFFFFFF;
+        firmware_calcCrc(&crcval, (UINT8*)pRecord, FIRMWARE_DEVICE_RECORD_SIZE - 4);
+
+        if ((crcval != pRecord->recordCrc) ||
+            (pRecord->baseCrc != firmwareInstance_l.deviceBaseCrc) ||
+            (pRecord->sequence <= firmwareInstance_l.deviceSequence) ||
+            (firmware_checkDeviceHeader(&pRecord->deviceHeader) != 0))
+            continue;
+
+        firmwareInstance_l.deviceSequence = pRecord->sequence;
+        firmwareInstance_l.deviceHeader = pRecord->deviceHeader;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check if buffer is erased
+
+\param  pBuffer_p   Pointer to buffer
+\param  length_p    Length of buffer
+
+\return The function returns TRUE if all bytes of the buffer are erased (0xFF).
+*/
+//------------------------------------------------------------------------------
+static BOOL isErased(const UINT8* pBuffer_p, UINT length_p)
+{
+    for (; length_p > 0; length_p--, pBuffer_p++)
+    {
+        if (*pBuffer_p != 0xFF)
+            return FALSE;
+    }
+
+    return TRUE;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Append device header record
+
+This function appends a record with the given device header to the device
+header log. The slot is consumed even if programming fails, as it may be
+partially programmed then.
+
+\param  pHeader_p   Pointer to the valid device header to be stored
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int appendDeviceRecord(tFirmwareDeviceHeader* pHeader_p)
+{
+    tFirmwareDeviceRecord   record;
+    UINT32                  offset = firmware_getDeviceHeaderBase();
+    UINT32                  crcval = 0xFFFFFFFF;
+
+    record.sequence = firmwareInstance_l.deviceSequence + 1;
+    record.baseCrc = firmwareInstance_l.deviceBaseCrc;
+    record.deviceHeader = *pHeader_p;
+    firmware_calcCrc(&crcval, (UINT8*)&record, sizeof(tFirmwareDeviceRecord) - 4);
+    record.recordCrc = crcval;
+
+    offset += (firmwareInstance_l.deviceRecordNext + 1) * FIRMWARE_DEVICE_RECORD_SIZE;
+    firmwareInstance_l.deviceRecordNext++;
+
+    if (flash_write(offset, (UINT8*)&record, sizeof(tFirmwareDeviceRecord)) != 0)
+        return -1;
+
+    firmwareInstance_l.deviceSequence = record.sequence;
+    firmwareInstance_l.deviceHeader = *pHeader_p;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Compact device header area
+
+This function rewrites the sector holding the device header area with the given
+device header as plain header and an empty log. The rest of the sector is first
+copied to the backup sector and verified, then a backup descriptor is written.
+Only after that the device header sector is erased and restored, thus a power
+loss at any point leaves either the old sector or a complete backup, which is
+restored by firmware_init().
+
+\param  pHeader_p   Pointer to the valid device header to be stored
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int compactDeviceHeader(tFirmwareDeviceHeader* pHeader_p)
+{
+    tFirmwareDeviceBackup   backup;
+    UINT32                  backupBase = firmwareInstance_l.deviceBackupBase;
+    UINT32                  offset = firmware_getDeviceHeaderBase();
+    UINT32                  crcval = 0xFFFFFFFF;
+
+    if ((backupBase == FIRMWARE_INVALID_IMAGE_BASE) ||
+        (FIRMWARE_DEVICE_HEADER_SIZE < sizeof(tFirmwareDeviceBackup)))
+        return -1; // No room for a backup, the sector is never erased
+
+    backup.signature = FIRMWARE_DEVICE_BACKUP_SIGNATURE;
+    backup.sectorOffset = (offset / firmwareInstance_l.sectorSize) * firmwareInstance_l.sectorSize;
+    backup.dataCrc = 0xFFFFFFFF;
+    backup.deviceHeader = *pHeader_p;
+
+    if ((flash_eraseSector(backupBase) != 0) ||
+        (copyDeviceSector(backupBase, backup.sectorOffset, &backup.dataCrc) != 0) ||
+        (copyDeviceSector(FIRMWARE_INVALID_IMAGE_BASE, backupBase, &crcval) != 0) ||
+        (crcval != backup.dataCrc))
+        return -1;
+
+    crcval = 0xFFFFFFFF;
+    firmware_calcCrc(&crcval, (UINT8*)&backup, sizeof(tFirmwareDeviceBackup) - 4);
+    backup.backupCrc = crcval;
+
+    if (flash_write(backupBase + (offset - backup.sectorOffset), (UINT8*)&backup,
+                    sizeof(tFirmwareDeviceBackup)) != 0)
+        return -1;
+
+    return restoreDeviceSector(&backup);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Recover device header sector
+
+This function checks the backup sector for the descriptor of an interrupted
+compaction of the device header area and completes it.
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int recoverDeviceSector(void)
+{
+    tFirmwareDeviceBackup   backup;
+    UINT32                  backupBase = firmwareInstance_l.deviceBackupBase;
+    UINT32                  offset = firmware_getDeviceHeaderBase();
+    UINT32                  crcval = 0xFFFFFFFF;
+
+    if ((backupBase == FIRMWARE_INVALID_IMAGE_BASE) ||
+        (FIRMWARE_DEVICE_HEADER_SIZE < sizeof(tFirmwareDeviceBackup)))
+        return 0;
+
+    if (flash_read(backupBase + (offset % firmwareInstance_l.sectorSize), (UINT8*)&backup,
+                   sizeof(tFirmwareDeviceBackup)) != 0)
+        return -1;
+
+    firmware_calcCrc(&crcval, (UINT8*)&backup, sizeof(tFirmwareDeviceBackup) - 4);
+
+    if ((backup.signature != FIRMWARE_DEVICE_BACKUP_SIGNATURE) ||
+        (crcval != backup.backupCrc) ||
+        (backup.sectorOffset != (offset - (offset % firmwareInstance_l.sectorSize))))
+        return 0; // No compaction interrupted
+
+    // The descriptor is only written after the backup was verified
+    crcval = 0xFFFFFFFF;
+    if ((copyDeviceSector(FIRMWARE_INVALID_IMAGE_BASE, backupBase, &crcval) != 0) ||
+        (crcval != backup.dataCrc))
+        return -1;
+
+    return restoreDeviceSector(&backup);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Restore device header sector
+
+This function erases the device header sector, copies the sector data back
+from the backup sector and programs the new plain device header. Finally the
+backup descriptor is invalidated by programming its signature, thus no erase
+is needed.
+
+\param  pBackup_p   Pointer to the valid backup descriptor
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int restoreDeviceSector(tFirmwareDeviceBackup* pBackup_p)
+{
+    UINT32  backupBase = firmwareInstance_l.deviceBackupBase;
+    UINT32  offset = firmware_getDeviceHeaderBase();
+    UINT32  crcval = 0xFFFFFFFF;
+    UINT32  signature = 0;
+
+    firmwareInstance_l.fDeviceHeaderLoaded = FALSE;
+
+    if ((flash_eraseSector(pBackup_p->sectorOffset) != 0) ||
+        (copyDeviceSector(pBackup_p->sectorOffset, backupBase, &crcval) != 0) ||
+        (crcval != pBackup_p->dataCrc) ||
+        (flash_write(offset, (UINT8*)&pBackup_p->deviceHeader,
+                     sizeof(tFirmwareDeviceHeader)) != 0))
+        return -1;
+
+    if (flash_write(backupBase + (offset - pBackup_p->sectorOffset), (UINT8*)&signature,
+                    sizeof(signature)) != 0)
+        return -1;
+
+    firmwareInstance_l.fDeviceHeaderLoaded = TRUE;
+    firmwareInstance_l.fDeviceHeaderValid = TRUE;
+    firmwareInstance_l.fDeviceHeaderErased = FALSE;
+    firmwareInstance_l.fDevicePlainValid = TRUE;
+    firmwareInstance_l.deviceHeader = pBackup_p->deviceHeader;
+    firmwareInstance_l.deviceBaseCrc = pBackup_p->deviceHeader.headerCrc;
+    firmwareInstance_l.deviceSequence = 0;
+    firmwareInstance_l.deviceRecordNext = 0;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Copy device header sector
+
+This function copies the device header sector data between the device header
+sector and the backup sector, except for the device header area. The CRC of the
+data read is accumulated in the given buffer.
+
+\param  dstBase_p   Base of the destination sector, if FIRMWARE_INVALID_IMAGE_BASE
+                    the source is only read to calculate the CRC
+\param  srcBase_p   Base of the source sector
+\param  pCrc_p      Pointer to the CRC value, must be initialized by the caller
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int copyDeviceSector(UINT32 dstBase_p, UINT32 srcBase_p, UINT32* pCrc_p)
+{
+    UINT32  areaOffset = firmware_getDeviceHeaderBase() % firmwareInstance_l.sectorSize;
+    UINT32  tailOffset = areaOffset + FIRMWARE_DEVICE_HEADER_SIZE;
+    UINT32  dstTail = FIRMWARE_INVALID_IMAGE_BASE;
+
+    if (dstBase_p != FIRMWARE_INVALID_IMAGE_BASE)
+        dstTail = dstBase_p + tailOffset;
+
+    if ((copyFlash(dstBase_p, srcBase_p, areaOffset, pCrc_p) != 0) ||
+        (copyFlash(dstTail, srcBase_p + tailOffset,
+                   firmwareInstance_l.sectorSize - tailOffset, pCrc_p) != 0))
+        return -1;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Copy Flash data
+
+This function copies Flash data chunk-wise through a small buffer on the stack,
+thus no sector sized buffer is needed. The CRC of the data read is accumulated
+in the given buffer.
+
+\param  dst_p       Destination offset, if FIRMWARE_INVALID_IMAGE_BASE the source
+                    is only read to calculate the CRC
+\param  src_p       Source offset
+\param  length_p    Length of data to be copied
+\param  pCrc_p      Pointer to the CRC value, must be initialized by the caller
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int copyFlash(UINT32 dst_p, UINT32 src_p, UINT32 length_p, UINT32* pCrc_p)
+{
+    UINT8   aChunk[FIRMWARE_COPY_CHUNK_SIZE];
+    UINT32  length;
+
+    while (length_p > 0)
+    {
+        length = (length_p < sizeof(aChunk)) ? length_p : sizeof(aChunk);
+
+        if ((flash_read(src_p, aChunk, length) != 0) ||
+            (firmware_calcCrc(pCrc_p, aChunk, (INT)length) != 0))
+            return -1;
+
+        if (dst_p != FIRMWARE_INVALID_IMAGE_BASE)
+        {
+            if (flash_write(dst_p, aChunk, length) != 0)
+                return -1;
+
+            dst_p += length;
+        }
+
+        src_p += length;
+        length_p -= length;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Load download journal
+
+This function determines the location of the download journal and the device
+header backup sector and loads the journal from Flash.
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int loadJournal(void)
+{
+    tFlashInfo          flashInfo;
+    tFirmwareJournal*   pJournal = &firmwareInstance_l.journal;
+    UINT32              crcval = 0xFFFFFFFF;
+
+    firmwareInstance_l.journalBase = FIRMWARE_INVALID_IMAGE_BASE;
+    firmwareInstance_l.deviceBackupBase = FIRMWARE_INVALID_IMAGE_BASE;
+    firmwareInstance_l.fJournalValid = FALSE;
+
+    if (flash_getInfo(&flashInfo) != 0)
+        return -1;
+
+    // Journal is located in the last sector behind the update image
+    if ((FIRMWARE_UPDATE_IMAGE_BASE == FIRMWARE_INVALID_IMAGE_BASE) ||
+        (flashInfo.size <= (FIRMWARE_UPDATE_IMAGE_BASE + flashInfo.sectorSize)))
+        return 0;
+
+    firmwareInstance_l.journalBase = flashInfo.size - flashInfo.sectorSize;
+    firmwareInstance_l.sectorSize = flashInfo.sectorSize;
+
+    // Device header backup sector is located before the journal
+    if ((firmware_getDeviceHeaderBase() != FIRMWARE_INVALID_IMAGE_BASE) &&
+        (flashInfo.size > (FIRMWARE_UPDATE_IMAGE_BASE + (2 * flashInfo.sectorSize))))
+        firmwareInstance_l.deviceBackupBase = firmwareInstance_l.journalBase - flashInfo.sectorSize;
+
+    if ((flash_read(firmwareInstance_l.journalBase, (UINT8*)pJournal,
+                    sizeof(tFirmwareJournal)) != 0) ||
+        (flash_read(firmwareInstance_l.journalBase + FIRMWARE_JOURNAL_BITMAP_OFFSET,
+                    firmwareInstance_l.aJournalBitmap, FIRMWARE_JOURNAL_BITMAP_SIZE) != 0))
+        return -1;
+
+    firmware_calcCrc(&crcval, (UINT8*)pJournal, sizeof(tFirmwareJournal) - 4);
+
+    if ((pJournal->signature != FIRMWARE_JOURNAL_SIGNATURE) ||
+        (crcval != pJournal->journalCrc))
+        return 0; // No download in progress
+
+    firmwareInstance_l.journalCommitted = countCommittedSectors();
+    firmwareInstance_l.fJournalValid = TRUE;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Count committed sectors
+
+This function counts the sectors from the start of the update image which are
+committed in the download journal bitmap.
+
+\return The function returns the number of leading committed sectors.
+*/
+//------------------------------------------------------------------------------
+static UINT countCommittedSectors(void)
+{
+    UINT    sector;
+
+    for (sector = 0; sector < (FIRMWARE_JOURNAL_BITMAP_SIZE * 8); sector++)
+    {
+        if (firmwareInstance_l.aJournalBitmap[sector / 8] & (1 << (sector % 8)))
+            break;
+    }
+
+    return sector;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get time
+
+This function returns the system timer converted to milliseconds.
+
+\return The function returns the time in milliseconds.
+*/
+//------------------------------------------------------------------------------
+static UINT32 getTimeMs(void)
+{
+    return (UINT32)(((UINT64)alt_nticks() * 1000U) / alt_ticks_per_second());
+}
+
 /// \}
@@ -77,6 +77,8 @@ int     flash_getInfo(tFlashInfo* pFlashInfo_p);
 int     flash_read(UINT offset_p, UINT8* pDest_p, UINT length_p);
 int     flash_eraseSector(UINT offset_p);
 int     flash_write(UINT offset_p, UINT8* pSrc_p, UINT length_p);
+int     flash_startEraseSector(UINT offset_p);
+BOOL    flash_isBusy(void);
 
 #ifdef __cplusplus
 }
@@ -48,6 +48,8 @@ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
 // Otherwise this module degenerates to a null implementation.
 #if defined(__ALTERA_AVALON_EPCS_FLASH_CONTROLLER)
 #include <altera_avalon_epcs_flash_controller.h>
+#include <altera_avalon_spi.h>
+#include <epcs_commands.h>
 
 #define FLASH_NAME          EPCS_FLASH_CONTROLLER_NAME
 
@@ -93,6 +95,7 @@ typedef struct
     alt_flash_fd*   pFlashDevice;   ///< Altera Flash device instance
     tFlashInfo      flashInfo;      ///< Flash info
     BOOL            fInitialized;   ///< Flash module initialized
+    BOOL            fEraseActive;   ///< Sector erase started by flash_startEraseSector()
 
 } tFlashInstance;
 
@@ -105,6 +108,7 @@ static tFlashInstance flashInstance_g;
 // local function prototypes
 //------------------------------------------------------------------------------
 static int getFlashInfo(tFlashInfo* pFlashInfo_p);
+static alt_u32 getRegisterBase(void);
 
 //============================================================================//
 //            P U B L I C   F U N C T I O N S                                 //
@@ -180,7 +184,8 @@ int flash_getInfo(tFlashInfo* pFlashInfo_p)
 \brief  Read from Flash
 
 The function reads from the given Flash offset. The caller must provide a buffer
-with sufficient size.
+with sufficient size. The read fails while a sector erase started by
+flash_startEraseSector is in progress.
 
 \param  offset_p    Base Flash offset reading from
 \param  pDest_p     Pointer to destination buffer storing the read data
@@ -201,6 +206,9 @@ int flash_read(UINT offset_p, UINT8* pDest_p, UINT length_p)
         return -1;
     }
 
+    if (flash_isBusy())
+        return -1;
+
     ret = alt_read_flash(flashInstance_g.pFlashDevice, offset_p, pDest_p, length_p);
 
     // EPCS Flash read returns 0 on success.
@@ -212,7 +220,8 @@ int flash_read(UINT offset_p, UINT8* pDest_p, UINT length_p)
 \brief  Erase Flash sector
 
 The function erases the given Flash sector. Use flash_getInfo function to obtain
-the Flash sector size and count.
+the Flash sector size and count. The erase fails while a sector erase started
+by flash_startEraseSector is in progress.
 
 \param  offset_p    Byte offset of sector
 
@@ -227,6 +236,9 @@ int flash_eraseSector(UINT offset_p)
     if ((!flashInstance_g.fInitialized) || (offset_p > flashInstance_g.flashInfo.size))
         return -1;
 
+    if (flash_isBusy())
+        return -1;
+
     ret = alt_erase_flash_block(flashInstance_g.pFlashDevice, offset_p,
                                 flashInstance_g.flashInfo.sectorSize);
 
@@ -238,7 +250,8 @@ int flash_eraseSector(UINT offset_p)
 /**
 \brief  Write to Flash
 
-The function writes to the given Flash offset.
+The function writes to the given Flash offset. The write fails while a sector
+erase started by flash_startEraseSector is in progress.
 
 \note Before writing to a sector that already holds content it is mandatory to
       backup that data and add it to newly written data.
@@ -268,12 +281,81 @@ int flash_write(UINT offset_p, UINT8* pSrc_p, UINT length_p)
     blockOffset = (offset_p / flashInstance_g.flashInfo.sectorSize) *
                   flashInstance_g.flashInfo.numberOfSectors;
 
+    if (flash_isBusy())
+        return -1;
+
     ret = alt_write_flash_block(flashInstance_g.pFlashDevice, 0, offset_p, pSrc_p, length_p);
 
     // EPCS Flash write returns 0 or positive value on success.
     return (ret >= 0) ? 0 : -1;
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Start Flash sector erase
+
+The function starts the erase of the given Flash sector and returns without
+waiting for its completion. Use flash_isBusy to poll for the end of the erase.
+Any other Flash access fails until the erase is completed, the driver never
+waits for it. Thus a caller erasing in the background must check flash_isBusy
+before accessing the Flash.
+
+\param  offset_p    Byte offset of sector
+
+\return The function returns 0 if the sector erase has been started,
+        otherwise -1.
+*/
+//------------------------------------------------------------------------------
+int flash_startEraseSector(UINT offset_p)
+{
+    alt_u32 registerBase;
+    alt_u8  aCmd[4];
+
+    if ((!flashInstance_g.fInitialized) || (offset_p >= flashInstance_g.flashInfo.size) ||
+        ((offset_p % flashInstance_g.flashInfo.sectorSize) != 0))
+        return -1;
+
+    if (flash_isBusy())
+        return -1;
+
+    registerBase = getRegisterBase();
+
+    aCmd[0] = epcs_se;
+    aCmd[1] = (alt_u8)(offset_p >> 16);
+    aCmd[2] = (alt_u8)(offset_p >> 8);
+    aCmd[3] = (alt_u8)offset_p;
+
+    epcs_write_enable(registerBase);
+    alt_avalon_spi_command(registerBase, 0, sizeof(aCmd), aCmd, 0, NULL, 0);
+
+    flashInstance_g.fEraseActive = TRUE;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check if Flash is busy
+
+The function checks if a sector erase started by flash_startEraseSector is
+still in progress.
+
+\return The function returns TRUE if the Flash is busy, otherwise FALSE.
+*/
+//------------------------------------------------------------------------------
+BOOL flash_isBusy(void)
+{
+    if (!flashInstance_g.fEraseActive)
+        return FALSE;
+
+    if ((epcs_read_status_register(getRegisterBase()) & 1) != 0)
+        return TRUE;
+
+    flashInstance_g.fEraseActive = FALSE;
+
+    return FALSE;
+}
+
 //============================================================================//
 //            P R I V A T E   F U N C T I O N S                               //
 //============================================================================//
@@ -312,4 +394,16 @@ static int getFlashInfo(tFlashInfo* pFlashInfo_p)
     return 0;
 }
 
+//------------------------------------------------------------------------------
+/**
+\brief  Get register base of the EPCS controller
+
+\return The function returns the base address of the EPCS controller registers.
+*/
+//------------------------------------------------------------------------------
+static alt_u32 getRegisterBase(void)
+{
+    return ((alt_flash_epcs_dev*)flashInstance_g.pFlashDevice)->register_base;
+}
+
 /// \}
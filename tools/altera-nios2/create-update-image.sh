@@ -28,14 +28,13 @@ HW_FILE=hw
 SW_FILE=sw
 IMG_FILE=image
 
-MAKE_HEADER_PL=make_header.pl
+# Firmware image tool (tools/fwimage), taken from PATH if not given
+FWIMAGE=${FWIMAGE:-fwimage}
 
-SIGNATUR=0x46575550
-VERSION=0x00000001
-
-if [ ! -f "${MAKE_HEADER_PL}" ]; then
-    echo "ERROR: Could not find ${MAKE_HEADER_PL}!"
-    echo "       ${MAKE_HEADER_PL} must be stored in same path!"
+if ! command -v "${FWIMAGE}" > /dev/null; then
+    echo "ERROR: Could not find ${FWIMAGE}!"
+    echo "       Run build-firmware.sh, or build tools/fwimage with CMake and"
+    echo "       add it to PATH or set FWIMAGE!"
     exit 1
 fi
 
@@ -60,34 +59,20 @@ ${CMD} || {
     exit 1
 }
 
-# Concatenate hard- and software srecs
-echo
-echo "INFO: Concatenate bitstream and elf to a single flash file..."
-cat ${HW_FILE}.flash ${SW_FILE}.flash > ${IMG_FILE}.flash
-
-# Create binary out of flash file
+# Build image with section table and header from the flash files
 echo
-echo "INFO: Create binary out of flash file..."
-CMD="nios2-elf-objcopy -I srec -O binary ${IMG_FILE}.flash ${IMG_FILE}.bin"
+echo "INFO: Create update image from bitstream and elf flash files..."
+CMD="${FWIMAGE} create ${HW_FILE}.flash ${SW_FILE}.flash ${OPLK_VERSION} ${OPLK_FEATURE} \
+${IMG_FILE}_hdr.bin \
+"
 ${CMD} || {
     echo
-    echo "ERROR: OBJCOPY hardware srec to binary failed!"
+    echo "ERROR: FWIMAGE failed!"
+    rm -f ${HW_FILE}.flash ${SW_FILE}.flash
     exit 1
 }
 
 # Remove srecs
-rm -rf ${HW_FILE}.flash ${SW_FILE}.flash ${IMG_FILE}.flash
-
-# Add header to binary file
-CMD="\
-perl ./${MAKE_HEADER_PL} \
-${IMG_FILE}.bin ${IMG_FILE}_hdr.bin \
-${SIGNATUR} ${VERSION} ${OPLK_VERSION} ${OPLK_FEATURE} \
-"
-${CMD} || {
-    echo
-    echo "ERROR: Make header perl script failed!"
-    exit 1
-}
+rm -f ${HW_FILE}.flash ${SW_FILE}.flash
 
 exit 0
@@ -0,0 +1,566 @@
+/**
+********************************************************************************
+\file   main.c
+
+\brief  Main file of firmware delta tool
+
+This file contains the main file of the firmware delta tool. It creates delta
+patches between two update images and applies them to a simulated flash to
+verify them before they are used in the field.
+
+\ingroup module_fwdelta_tool
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <fwdelta/fwdelta.h>
+
+//============================================================================//
+//            G L O B A L   D E F I N I T I O N S                             //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// module global vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// global function prototypes
+//------------------------------------------------------------------------------
+
+//============================================================================//
+//            P R I V A T E   D E F I N I T I O N S                           //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define DEFAULT_SECTOR_SIZE         (64 * 1024)     // EPCS sector size
+#define DEFAULT_CHUNK_SIZE          1024            // Chunk size of the simulated transfer
+
+//------------------------------------------------------------------------------
+// local types
+//------------------------------------------------------------------------------
+
+/**
+\brief Simulated flash
+
+The struct holds the update region of a simulated NOR flash. Programming can
+only clear bits, thus writing to a location which has not been erased is
+reported as an error.
+*/
+typedef struct
+{
+    uint8_t*    pData;              ///< Flash content
+    size_t      size;               ///< Size of the update region
+    uint32_t    sectorSize;         ///< Sector size
+    unsigned    eraseCount;         ///< Number of erased sectors
+    unsigned    writeCount;         ///< Number of write accesses
+    size_t      readBytes;          ///< Number of read bytes
+    size_t      writeBytes;         ///< Number of written bytes
+} tFlashSim;
+
+//------------------------------------------------------------------------------
+// local vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// local function prototypes
+//------------------------------------------------------------------------------
+static int      createDelta(const char* pszBase_p, const char* pszTarget_p,
+                            const char* pszDelta_p, uint32_t sectorSize_p);
+static int      applyDelta(const char* pszBase_p, const char* pszDelta_p,
+                           const char* pszTarget_p, uint32_t sectorSize_p);
+static uint8_t* readFile(const char* pszFile_p, size_t* pLength_p);
+static int      writeFile(const char* pszFile_p, const uint8_t* pData_p, size_t length_p);
+static int      flashSimRead(void* pArg_p, uint32_t offset_p, uint8_t* pDst_p, size_t length_p);
+static int      flashSimErase(void* pArg_p, uint32_t offset_p);
+static int      flashSimWrite(void* pArg_p, uint32_t offset_p, const uint8_t* pSrc_p,
+                              size_t length_p);
+static uint32_t readUint32(const uint8_t* pData_p);
+static void     printUsage(const char* pszName_p);
+
+//============================================================================//
+//            P U B L I C   F U N C T I O N S                                 //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+/**
+\brief  main function
+
+This is the main function of the firmware delta tool.
+
+\param  argc                    Number of arguments
+\param  argv                    Pointer to argument strings
+
+\return Returns an exit code
+
+\ingroup module_fwdelta_tool
+*/
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    uint32_t    sectorSize = DEFAULT_SECTOR_SIZE;
+    int         argIndex = 2;
+
+    if (argc < 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if ((argc > 3) && (strcmp(argv[2], "-s") == 0))
+    {
+        sectorSize = (uint32_t)strtoul(argv[3], NULL, 0);
+        argIndex = 4;
+
+        if (sectorSize == 0)
+        {
+            fprintf(stderr, "Invalid sector size %s!\n", argv[3]);
+            return 1;
+        }
+    }
+
+    if ((strcmp(argv[1], "create") == 0) && (argc == (argIndex + 3)))
+    {
+        return createDelta(argv[argIndex], argv[argIndex + 1], argv[argIndex + 2],
+                           sectorSize);
+    }
+
+    if ((strcmp(argv[1], "apply") == 0) &&
+        ((argc == (argIndex + 2)) || (argc == (argIndex + 3))))
+    {
+        return applyDelta(argv[argIndex], argv[argIndex + 1],
+                          (argc == (argIndex + 3)) ? argv[argIndex + 2] : NULL, sectorSize);
+    }
+
+    printUsage(argv[0]);
+
+    return 1;
+}
+
+//============================================================================//
+//            P R I V A T E   F U N C T I O N S                               //
+//============================================================================//
+/// \name Private Functions
+/// \{
+
+//------------------------------------------------------------------------------
+/**
+\brief  Create delta
+
+The function creates the delta between two update images and verifies it with
+the simulated flash before it is written.
+
+\param  pszBase_p       Update image currently stored on the card
+\param  pszTarget_p     New update image
+\param  pszDelta_p      Delta file to be created
+\param  sectorSize_p    Flash sector size
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int createDelta(const char* pszBase_p, const char* pszTarget_p,
+                       const char* pszDelta_p, uint32_t sectorSize_p)
+{
+    int         ret = 1;
+    uint8_t*    pBase;
+    uint8_t*    pTarget;
+    uint8_t*    pDelta = NULL;
+    size_t      baseLength;
+    size_t      targetLength;
+    size_t      deltaSize;
+
+    pBase = readFile(pszBase_p, &baseLength);
+    pTarget = readFile(pszTarget_p, &targetLength);
+    if ((pBase == NULL) || (pTarget == NULL))
+        goto Exit;
+
+    // Worst case is a single literal per sector
+    deltaSize = FWDELTA_HEADER_SIZE + targetLength +
+                (((targetLength / sectorSize_p) + 1) * 2 * (1 + 4 + 4));
+    pDelta = (uint8_t*)malloc(deltaSize);
+    if (pDelta == NULL)
+        goto Exit;
+
+    deltaSize = fwdelta_create(pBase, baseLength, pTarget, targetLength, sectorSize_p,
+                               pDelta, deltaSize);
+    if (deltaSize == 0)
+    {
+        fprintf(stderr, "Unable to create delta!\n");
+        goto Exit;
+    }
+
+    printf("Base image:   %lu bytes\n", (unsigned long)baseLength);
+    printf("Target image: %lu bytes\n", (unsigned long)targetLength);
+    printf("Delta:        %lu bytes (%.1f%% of target)\n", (unsigned long)deltaSize,
+           (targetLength > 0) ? ((deltaSize * 100.0) / targetLength) : 0.0);
+
+    if (writeFile(pszDelta_p, pDelta, deltaSize) != 0)
+        goto Exit;
+
+    ret = applyDelta(pszBase_p, pszDelta_p, pszTarget_p, sectorSize_p);
+
+Exit:
+    free(pBase);
+    free(pTarget);
+    free(pDelta);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Apply delta
+
+The function applies a delta to the base image in a simulated flash. The delta
+is fed in chunks like the firmware update tool does. If a target image is
+given, the flash content is compared against it.
+
+\param  pszBase_p       Update image currently stored on the card
+\param  pszDelta_p      Delta file
+\param  pszTarget_p     Expected update image, may be NULL
+\param  sectorSize_p    Flash sector size
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int applyDelta(const char* pszBase_p, const char* pszDelta_p,
+                      const char* pszTarget_p, uint32_t sectorSize_p)
+{
+    int                 ret = 1;
+    int                 retDelta = FWDELTA_OK;
+    tFlashSim           flash;
+    tFwDeltaFlashOps    flashOps;
+    tFwDeltaApplier     applier;
+    uint8_t*            pBase;
+    uint8_t*            pDelta;
+    uint8_t*            pTarget = NULL;
+    uint8_t*            pSectorBuffer = NULL;
+    size_t              baseLength;
+    size_t              deltaLength;
+    size_t              targetLength = 0;
+    size_t              offset;
+    size_t              length;
+
+    memset(&flash, 0, sizeof(flash));
+
+    pBase = readFile(pszBase_p, &baseLength);
+    pDelta = readFile(pszDelta_p, &deltaLength);
+    if ((pBase == NULL) || (pDelta == NULL))
+        goto Exit;
+
+    if (pszTarget_p != NULL)
+    {
+        pTarget = readFile(pszTarget_p, &targetLength);
+        if (pTarget == NULL)
+            goto Exit;
+    }
+
+    if (!fwdelta_isDelta(pDelta, deltaLength))
+    {
+        fprintf(stderr, "%s is no delta!\n", pszDelta_p);
+        goto Exit;
+    }
+
+    // The update region holds the base image, the rest is erased
+    length = readUint32(pDelta + 12);   // Target length of delta header
+    if (length < baseLength)
+        length = baseLength;
+
+    flash.sectorSize = sectorSize_p;
+    flash.size = ((length + sectorSize_p - 1) / sectorSize_p) * sectorSize_p;
+    flash.pData = (uint8_t*)malloc(flash.size);
+    pSectorBuffer = (uint8_t*)malloc(sectorSize_p);
+    if ((flash.pData == NULL) || (pSectorBuffer == NULL))
+        goto Exit;
+
+    memset(flash.pData, 0xFF, flash.size);
+    memcpy(flash.pData, pBase, baseLength);
+
+    flashOps.pfnRead = flashSimRead;
+    flashOps.pfnErase = flashSimErase;
+    flashOps.pfnWrite = flashSimWrite;
+    flashOps.pArg = &flash;
+
+    fwdelta_initApplier(&applier, &flashOps, pSectorBuffer, sectorSize_p);
+
+    for (offset = 0; offset < deltaLength; offset += length)
+    {
+        length = deltaLength - offset;
+        if (length > DEFAULT_CHUNK_SIZE)
+            length = DEFAULT_CHUNK_SIZE;
+
+        retDelta = fwdelta_apply(&applier, pDelta + offset, length);
+        if (retDelta != FWDELTA_OK)
+            break;
+    }
+
+    if (retDelta == FWDELTA_OK)
+        retDelta = fwdelta_finish(&applier);
+
+    if (retDelta != FWDELTA_OK)
+    {
+        fprintf(stderr, "Applying delta failed at delta offset %lu (%d)!\n",
+                (unsigned long)offset, retDelta);
+        goto Exit;
+    }
+
+    printf("Simulated flash: %u sectors erased, %u writes (%lu bytes), %lu bytes read\n",
+           flash.eraseCount, flash.writeCount, (unsigned long)flash.writeBytes,
+           (unsigned long)flash.readBytes);
+
+    if ((pTarget != NULL) &&
+        ((targetLength != applier.header.targetLength) ||
+         (memcmp(flash.pData, pTarget, targetLength) != 0)))
+    {
+        fprintf(stderr, "Flash content differs from %s!\n", pszTarget_p);
+        goto Exit;
+    }
+
+    printf("Delta verified successfully\n");
+    ret = 0;
+
+Exit:
+    free(pBase);
+    free(pDelta);
+    free(pTarget);
+    free(pSectorBuffer);
+    free(flash.pData);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read file
+
+\param  pszFile_p       File name
+\param  pLength_p       Pointer to store the file length
+
+\return The function returns the allocated file content, or NULL on error.
+*/
+//------------------------------------------------------------------------------
+static uint8_t* readFile(const char* pszFile_p, size_t* pLength_p)
+{
+    FILE*       pFile;
+    uint8_t*    pData = NULL;
+    long        fileSize;
+
+    pFile = fopen(pszFile_p, "rb");
+    if (pFile == NULL)
+    {
+        fprintf(stderr, "Unable to open file %s\n", pszFile_p);
+        return NULL;
+    }
+
+    fseek(pFile, 0, SEEK_END);
+    fileSize = ftell(pFile);
+    rewind(pFile);
+
+    if (fileSize >= 0)
+        pData = (uint8_t*)malloc((fileSize > 0) ? (size_t)fileSize : 1);
+
+    if ((pData == NULL) || (fread(pData, 1, (size_t)fileSize, pFile) != (size_t)fileSize))
+    {
+        fprintf(stderr, "Unable to read file %s\n", pszFile_p);
+        free(pData);
+        pData = NULL;
+    }
+    else
+        *pLength_p = (size_t)fileSize;
+
+    fclose(pFile);
+
+    return pData;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write file
+
+\param  pszFile_p       File name
+\param  pData_p         Data to be written
+\param  length_p        Length of data
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int writeFile(const char* pszFile_p, const uint8_t* pData_p, size_t length_p)
+{
+    FILE*   pFile;
+    int     ret = 0;
+
+    pFile = fopen(pszFile_p, "wb");
+    if (pFile == NULL)
+    {
+        fprintf(stderr, "Unable to create file %s\n", pszFile_p);
+        return -1;
+    }
+
+    if (fwrite(pData_p, 1, length_p, pFile) != length_p)
+    {
+        fprintf(stderr, "Unable to write file %s\n", pszFile_p);
+        ret = -1;
+    }
+
+    fclose(pFile);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read from simulated flash
+
+\param  pArg_p      Pointer to the simulated flash
+\param  offset_p    Offset within the update region
+\param  pDst_p      Buffer for the data
+\param  length_p    Length of data
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int flashSimRead(void* pArg_p, uint32_t offset_p, uint8_t* pDst_p, size_t length_p)
+{
+    tFlashSim* pFlash = (tFlashSim*)pArg_p;
+
+    if ((offset_p > pFlash->size) || (length_p > (pFlash->size - offset_p)))
+        return -1;
+
+    memcpy(pDst_p, pFlash->pData + offset_p, length_p);
+    pFlash->readBytes += length_p;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Erase sector of simulated flash
+
+\param  pArg_p      Pointer to the simulated flash
+\param  offset_p    Offset of the sector within the update region
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int flashSimErase(void* pArg_p, uint32_t offset_p)
+{
+    tFlashSim* pFlash = (tFlashSim*)pArg_p;
+
+    if ((offset_p >= pFlash->size) || ((offset_p % pFlash->sectorSize) != 0))
+        return -1;
+
+    memset(pFlash->pData + offset_p, 0xFF, pFlash->sectorSize);
+    pFlash->eraseCount++;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Write to simulated flash
+
+\param  pArg_p      Pointer to the simulated flash
+\param  offset_p    Offset within the update region
+\param  pSrc_p      Data to be written
+\param  length_p    Length of data
+
+\return The function returns 0 on success, otherwise -1.
+*/
+//------------------------------------------------------------------------------
+static int flashSimWrite(void* pArg_p, uint32_t offset_p, const uint8_t* pSrc_p,
+                         size_t length_p)
+{
+    tFlashSim*  pFlash = (tFlashSim*)pArg_p;
+    size_t      i;
+
+    if ((offset_p > pFlash->size) || (length_p > (pFlash->size - offset_p)))
+        return -1;
+
+    for (i = 0; i < length_p; i++)
+    {
+        if (pFlash->pData[offset_p + i] != 0xFF)
+        {
+            fprintf(stderr, "Write to non-erased flash at offset 0x%lX!\n",
+                    (unsigned long)(offset_p + i));
+            return -1;
+        }
+
+        pFlash->pData[offset_p + i] = pSrc_p[i];
+    }
+
+    pFlash->writeCount++;
+    pFlash->writeBytes += length_p;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read little endian 32 bit value
+
+\param  pData_p     Pointer to the value
+
+\return The function returns the value.
+*/
+//------------------------------------------------------------------------------
+static uint32_t readUint32(const uint8_t* pData_p)
+{
+    return (uint32_t)pData_p[0] | ((uint32_t)pData_p[1] << 8) |
+           ((uint32_t)pData_p[2] << 16) | ((uint32_t)pData_p[3] << 24);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print usage
+
+\param  pszName_p   Name of the executable
+*/
+//------------------------------------------------------------------------------
+static void printUsage(const char* pszName_p)
+{
+    printf("Usage: %s create [-s <SECTOR_SIZE>] <BASE_IMAGE> <TARGET_IMAGE> <DELTA>\n"
+           "       %s apply [-s <SECTOR_SIZE>] <BASE_IMAGE> <DELTA> [<TARGET_IMAGE>]\n"
+           "create : Create delta from base to target image and verify it\n"
+           "apply  : Apply delta to base image in a simulated flash\n"
+           "-s     : Flash sector size (default 65536)\n",
+           pszName_p, pszName_p);
+}
+
+/// \}
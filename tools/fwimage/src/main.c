@@ -0,0 +1,1276 @@
+/**
+********************************************************************************
+\file   main.c
+
+\brief  Main file of firmware image tool
+
+This file contains the main file of the firmware image tool. It builds update
+images from the bitstream and application flash files, shows the information
+of update images and verifies them.
+
+\ingroup module_fwimage_tool
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <fwimage/fwimage.h>
+#include <crc32/crc32.h>
+
+#include <firmware-info.h>
+
+//============================================================================//
+//            G L O B A L   D E F I N I T I O N S                             //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// module global vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// global function prototypes
+//------------------------------------------------------------------------------
+
+//============================================================================//
+//            P R I V A T E   D E F I N I T I O N S                           //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+#define SREC_GAP_FILL               0x00    // Fill of address gaps (as objcopy)
+
+#define MODEL_LINE_SIZE             256     // Maximum line length of a model file
+
+//------------------------------------------------------------------------------
+// local types
+//------------------------------------------------------------------------------
+
+/**
+\brief Image input
+
+The struct holds the content of an input file. S-record files are placed at
+their load address, binary files at address 0.
+*/
+typedef struct
+{
+    uint8_t*    pData;              ///< Content of the input
+    size_t      length;             ///< Length of the content
+    uint32_t    address;            ///< Load address of the content
+    int         fSrec;              ///< Input is an S-record file
+} tImageInput;
+
+/**
+\brief Timing model
+
+The struct holds the flash geometry and the timing of a card. It is used to
+predict the duration of an update. The flash values are reported by the daemon
+at the end of a file transfer, the transfer values can be derived from the
+firmware_update statistics.
+*/
+typedef struct
+{
+    uint32_t    flashSize;          ///< Flash size [byte]
+    uint32_t    sectorSize;         ///< Flash sector size [byte]
+    uint32_t    chunkSize;          ///< File chunk size [byte]
+    uint32_t    chunkUs;            ///< Round trip overhead per file chunk [us]
+    uint32_t    transferUsPerKb;    ///< Copy time of transferred data [us/KB]
+    uint32_t    eraseMs;            ///< Erase time per sector [ms]
+    uint32_t    programUsPerKb;     ///< Program time [us/KB]
+    uint32_t    verifyUsPerKb;      ///< Read back time [us/KB]
+} tTimingModel;
+
+/**
+\brief Timing model parameter
+
+The struct describes a parameter of the timing model file.
+*/
+typedef struct
+{
+    const char* pszKey;             ///< Key in the model file
+    size_t      offset;             ///< Offset in tTimingModel
+    const char* pszDescription;     ///< Description of the parameter
+} tTimingParam;
+
+/**
+\brief Flash work
+
+The struct holds the flash work of an update transfer.
+*/
+typedef struct
+{
+    uint32_t    transferLength;     ///< Bytes transferred to the card
+    uint32_t    eraseCount;         ///< Sectors to be erased
+    uint32_t    programLength;      ///< Bytes to be programmed
+    uint32_t    verifyLength;       ///< Bytes read back for verification
+} tFlashWork;
+
+//------------------------------------------------------------------------------
+// local vars
+//------------------------------------------------------------------------------
+
+// Defaults are the typical datasheet values of an EPCS128, the transfer values
+// are estimates. They should be replaced by values measured on the card.
+static const tTimingModel defaultModel_l =
+{
+    0x1000000,                      // flashSize
+    0x10000,                        // sectorSize
+    4096,                           // chunkSize
+    1000,                           // chunkUs
+    20,                             // transferUsPerKb
+    2000,                           // eraseMs
+    6000,                           // programUsPerKb
+    500,                            // verifyUsPerKb
+};
+
+static const tTimingParam aTimingParam_l[] =
+{
+    {"flash_size",          offsetof(tTimingModel, flashSize),          "Flash size [byte]"},
+    {"sector_size",         offsetof(tTimingModel, sectorSize),         "Flash sector size [byte]"},
+    {"chunk_size",          offsetof(tTimingModel, chunkSize),          "File chunk size [byte]"},
+    {"chunk_us",            offsetof(tTimingModel, chunkUs),            "Round trip per chunk [us]"},
+    {"transfer_us_per_kb",  offsetof(tTimingModel, transferUsPerKb),    "Transfer time [us/KB]"},
+    {"erase_ms",            offsetof(tTimingModel, eraseMs),            "Erase time per sector [ms]"},
+    {"program_us_per_kb",   offsetof(tTimingModel, programUsPerKb),     "Program time [us/KB]"},
+    {"verify_us_per_kb",    offsetof(tTimingModel, verifyUsPerKb),      "Read back time [us/KB]"},
+};
+
+//------------------------------------------------------------------------------
+// local function prototypes
+//------------------------------------------------------------------------------
+static int      createImage(const char* pszBitstream_p, const char* pszApplication_p,
+                            uint32_t oplkVersion_p, uint32_t oplkFeature_p,
+                            uint32_t timeStamp_p, const char* pszImage_p);
+static int      showImage(const char* pszImage_p, int fVerify_p);
+static int      predictUpdate(const char* pszImage_p, const char* pszModel_p);
+static int      calibrateModel(const char* pszModel_p, int argc_p, char** argv_p);
+static void     getFullUpdateWork(uint32_t fileLength_p, const tTimingModel* pModel_p,
+                                  tFlashWork* pWork_p);
+static void     getSectionUpdateWork(const tFwImageHeader* pHeader_p,
+                                     const tFwImageSectionTable* pTable_p,
+                                     const tTimingModel* pModel_p, tFlashWork* pWork_p);
+static void     printPrediction(const char* pszTitle_p, const tFlashWork* pWork_p,
+                                const tTimingModel* pModel_p);
+static uint32_t getUpdateRegionEnd(const tTimingModel* pModel_p);
+static int      loadModel(const char* pszModel_p, tTimingModel* pModel_p);
+static int      saveModel(const char* pszModel_p, const tTimingModel* pModel_p);
+static int      setModelParam(tTimingModel* pModel_p, const char* pszParam_p);
+static int      loadInput(const char* pszFile_p, tImageInput* pInput_p);
+static int      isSrec(const uint8_t* pText_p, size_t length_p);
+static int      parseSrec(const uint8_t* pText_p, size_t length_p, tImageInput* pInput_p);
+static int      parseSrecRecord(const char* pszLine_p, uint32_t* pAddress_p,
+                                uint8_t* pData_p, size_t* pLength_p);
+static int      parseHex(const char* pszText_p, size_t digits_p, uint32_t* pValue_p);
+static uint8_t* readFile(const char* pszFile_p, size_t* pLength_p);
+static void     printUsage(const char* pszName_p);
+
+//============================================================================//
+//            P U B L I C   F U N C T I O N S                                 //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+/**
+\brief  main function
+
+This is the main function of the firmware image tool.
+
+\param  argc                    Number of arguments
+\param  argv                    Pointer to argument strings
+
+\return Returns an exit code
+
+\ingroup module_fwimage_tool
+*/
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    uint32_t    timeStamp = (uint32_t)time(NULL);
+    int         argIndex = 2;
+
+    if (argc < 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if ((argc > 3) && (strcmp(argv[2], "-t") == 0))
+    {
+        timeStamp = (uint32_t)strtoul(argv[3], NULL, 0);
+        argIndex = 4;
+    }
+
+    if ((strcmp(argv[1], "create") == 0) && (argc == (argIndex + 5)))
+    {
+        return createImage(argv[argIndex], argv[argIndex + 1],
+                           (uint32_t)strtoul(argv[argIndex + 2], NULL, 0),
+                           (uint32_t)strtoul(argv[argIndex + 3], NULL, 0),
+                           timeStamp, argv[argIndex + 4]);
+    }
+
+    if ((strcmp(argv[1], "info") == 0) && (argc == 3))
+        return showImage(argv[2], 0);
+
+    if ((strcmp(argv[1], "verify") == 0) && (argc == 3))
+        return showImage(argv[2], 1);
+
+    if ((strcmp(argv[1], "predict") == 0) && (argc == 3))
+        return predictUpdate(argv[2], NULL);
+
+    if ((strcmp(argv[1], "predict") == 0) && (argc == 5) && (strcmp(argv[2], "-m") == 0))
+        return predictUpdate(argv[4], argv[3]);
+
+    if ((strcmp(argv[1], "calibrate") == 0) && (argc >= 3))
+        return calibrateModel(argv[2], argc - 3, &argv[3]);
+
+    printUsage(argv[0]);
+
+    return 1;
+}
+
+//============================================================================//
+//            P R I V A T E   F U N C T I O N S                               //
+//============================================================================//
+/// \name Private Functions
+/// \{
+
+//------------------------------------------------------------------------------
+/**
+\brief  Create update image
+
+The function builds the update image from the bitstream and the application.
+If both are S-record files, the application is placed at its load address
+relative to the bitstream, otherwise it directly follows the bitstream. The
+section table is appended and the firmware header is put in front, the image
+is written in one pass.
+
+\param  pszBitstream_p      Bitstream file (sof2flash output or binary)
+\param  pszApplication_p    Application file (elf2flash output or binary)
+\param  oplkVersion_p       openPOWERLINK version of the header
+\param  oplkFeature_p       openPOWERLINK feature of the header
+\param  timeStamp_p         Time stamp of the header
+\param  pszImage_p          Update image file to be created
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int createImage(const char* pszBitstream_p, const char* pszApplication_p,
+                       uint32_t oplkVersion_p, uint32_t oplkFeature_p,
+                       uint32_t timeStamp_p, const char* pszImage_p)
+{
+    int                     ret = 1;
+    tImageInput             bitstream;
+    tImageInput             application;
+    tFwImageHeader          header;
+    tFwImageSectionTable    table;
+    uint8_t*                pImage = NULL;
+    size_t                  bitstreamLength;
+    size_t                  imageLength;
+    FILE*                   pFile;
+
+    memset(&bitstream, 0, sizeof(bitstream));
+    memset(&application, 0, sizeof(application));
+
+    if ((loadInput(pszBitstream_p, &bitstream) != 0) ||
+        (loadInput(pszApplication_p, &application) != 0))
+        goto Exit;
+
+    // The bitstream section covers the gap up to the application
+    bitstreamLength = bitstream.length;
+    if (bitstream.fSrec && application.fSrec)
+    {
+        if ((application.address < bitstream.address) ||
+            ((application.address - bitstream.address) < bitstream.length))
+        {
+            fprintf(stderr, "Application overlaps the bitstream!\n");
+            goto Exit;
+        }
+
+        bitstreamLength = application.address - bitstream.address;
+    }
+
+    imageLength = FWIMAGE_HEADER_SIZE + bitstreamLength + application.length +
+                  sizeof(tFwImageSectionTable);
+    pImage = (uint8_t*)malloc(imageLength);
+    if (pImage == NULL)
+        goto Exit;
+
+    memset(pImage + FWIMAGE_HEADER_SIZE, SREC_GAP_FILL, bitstreamLength);
+    memcpy(pImage + FWIMAGE_HEADER_SIZE, bitstream.pData, bitstream.length);
+    memcpy(pImage + FWIMAGE_HEADER_SIZE + bitstreamLength, application.pData,
+           application.length);
+
+    memset(&table, 0, sizeof(table));
+    table.magic = FWIMAGE_SECTION_TABLE_MAGIC;
+    table.sectionCount = FWIMAGE_SECTION_COUNT;
+    table.aSection[FWIMAGE_SECTION_BITSTREAM].offset = 0;
+    table.aSection[FWIMAGE_SECTION_BITSTREAM].length = (uint32_t)bitstreamLength;
+    table.aSection[FWIMAGE_SECTION_BITSTREAM].crc =
+        crc32_calc(CRC32_INIT, pImage + FWIMAGE_HEADER_SIZE, bitstreamLength);
+    table.aSection[FWIMAGE_SECTION_APPLICATION].offset = (uint32_t)bitstreamLength;
+    table.aSection[FWIMAGE_SECTION_APPLICATION].length = (uint32_t)application.length;
+    table.aSection[FWIMAGE_SECTION_APPLICATION].crc =
+        crc32_calc(CRC32_INIT, application.pData, application.length);
+    table.tableCrc = crc32_calc(CRC32_INIT, (const uint8_t*)&table,
+                                sizeof(table) - sizeof(table.tableCrc));
+    memcpy(pImage + imageLength - sizeof(table), &table, sizeof(table));
+
+    memset(&header, 0, sizeof(header));
+    header.signature = FWIMAGE_HEADER_SIGNATURE;
+    header.version = FWIMAGE_HEADER_VERSION;
+    header.timeStamp = timeStamp_p;
+    header.length = (uint32_t)(imageLength - FWIMAGE_HEADER_SIZE);
+    header.crc = crc32_calc(CRC32_INIT, pImage + FWIMAGE_HEADER_SIZE, header.length);
+    header.oplkVersion = oplkVersion_p;
+    header.oplkFeature = oplkFeature_p;
+    header.headerCrc = crc32_calc(CRC32_INIT, (const uint8_t*)&header,
+                                  sizeof(header) - sizeof(header.headerCrc));
+    memcpy(pImage, &header, sizeof(header));
+
+    pFile = fopen(pszImage_p, "wb");
+    if (pFile == NULL)
+    {
+        fprintf(stderr, "Unable to create file %s\n", pszImage_p);
+        goto Exit;
+    }
+
+    if (fwrite(pImage, 1, imageLength, pFile) != imageLength)
+        fprintf(stderr, "Unable to write file %s\n", pszImage_p);
+    else
+        ret = 0;
+
+    if (fclose(pFile) != 0)
+        ret = 1;
+
+    if (ret == 0)
+    {
+        printf("Created %s with %lu bytes (bitstream %lu, application %lu bytes)\n",
+               pszImage_p, (unsigned long)imageLength, (unsigned long)bitstreamLength,
+               (unsigned long)application.length);
+    }
+
+Exit:
+    free(bitstream.pData);
+    free(application.pData);
+    free(pImage);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Show update image
+
+The function prints the firmware header and the section table of an update
+image. If verification is requested, the image and section CRCs are checked.
+
+\param  pszImage_p      Update image file
+\param  fVerify_p       Verify the image
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int showImage(const char* pszImage_p, int fVerify_p)
+{
+    int                     ret = 1;
+    int                     retImage;
+    uint8_t*                pImage;
+    size_t                  length;
+    tFwImageHeader          header;
+    tFwImageSectionTable    table;
+    const uint8_t*          pData;
+    uint32_t                crc;
+    uint32_t                i;
+    int                     fSectionError = 0;
+    time_t                  timeStamp;
+    char                    aTime[32];
+
+    pImage = readFile(pszImage_p, &length);
+    if (pImage == NULL)
+        return 1;
+
+    retImage = fwimage_getHeader(pImage, length, &header);
+    if (retImage != FWIMAGE_OK)
+    {
+        fprintf(stderr, "%s\n", (retImage == FWIMAGE_ERR_CRC) ? "Firmware header CRC is wrong!" :
+                                                               "File is no update image!");
+        goto Exit;
+    }
+
+    timeStamp = (time_t)header.timeStamp;
+    if (strftime(aTime, sizeof(aTime), "%Y-%m-%d %H:%M:%S UTC", gmtime(&timeStamp)) == 0)
+        aTime[0] = '\0';
+
+    printf("Firmware header:\n");
+    printf(" Signature      0x%08X\n", header.signature);
+    printf(" Version        0x%08X\n", header.version);
+    printf(" Time stamp     0x%08X (%s)\n", header.timeStamp, aTime);
+    printf(" Length         0x%08X\n", header.length);
+    printf(" CRC            0x%08X\n", header.crc);
+    printf(" OPLK Version   0x%08X\n", header.oplkVersion);
+    printf(" OPLK Feature   0x%08X\n", header.oplkFeature);
+    printf(" Header CRC     0x%08X\n", header.headerCrc);
+
+    if (header.length != (length - FWIMAGE_HEADER_SIZE))
+    {
+        fprintf(stderr, "Image length does not match the file size (%lu bytes)!\n",
+                (unsigned long)length);
+        goto Exit;
+    }
+
+    pData = pImage + FWIMAGE_HEADER_SIZE;
+
+    if (fwimage_getSectionTable(pData, header.length, &table) == FWIMAGE_OK)
+    {
+        printf("Section table:\n");
+        for (i = 0; i < table.sectionCount; i++)
+        {
+            printf(" %-14s offset 0x%08X length 0x%08X CRC 0x%08X",
+                   (i == FWIMAGE_SECTION_BITSTREAM) ? "Bitstream" : "Application",
+                   table.aSection[i].offset, table.aSection[i].length, table.aSection[i].crc);
+
+            if (fVerify_p)
+            {
+                crc = crc32_calc(CRC32_INIT, pData + table.aSection[i].offset,
+                                 table.aSection[i].length);
+                printf(" %s", (crc == table.aSection[i].crc) ? "ok" : "WRONG");
+                if (crc != table.aSection[i].crc)
+                    fSectionError = 1;
+            }
+
+            printf("\n");
+        }
+    }
+    else
+        printf("No section table\n");
+
+    if (fVerify_p)
+    {
+        crc = crc32_calc(CRC32_INIT, pData, header.length);
+        if (crc != header.crc)
+        {
+            fprintf(stderr, "Image CRC is wrong (0x%08X)!\n", crc);
+            goto Exit;
+        }
+
+        if (fSectionError)
+        {
+            fprintf(stderr, "Section CRC is wrong!\n");
+            goto Exit;
+        }
+
+        printf("Image verified successfully (%s)\n", crc32_getImplementation());
+    }
+
+    ret = 0;
+
+Exit:
+    free(pImage);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Predict update duration
+
+The function places an update image in the flash layout of firmware-info.h and
+reports the flash areas touched by the update. The duration of a full update
+and, if the image has a section table, of an application section update is
+predicted from the timing model.
+
+\param  pszImage_p      Update image file
+\param  pszModel_p      Timing model file (NULL for the default model)
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int predictUpdate(const char* pszImage_p, const char* pszModel_p)
+{
+    int                     ret = 1;
+    uint8_t*                pImage;
+    size_t                  length;
+    tFwImageHeader          header;
+    tFwImageSectionTable    table;
+    tTimingModel            model = defaultModel_l;
+    tFlashWork              work;
+    uint32_t                regionEnd;
+    uint32_t                imageEnd;
+
+    if ((pszModel_p != NULL) && (loadModel(pszModel_p, &model) != 0))
+        return 1;
+
+    if ((model.sectorSize == 0) || (model.chunkSize == 0) ||
+        ((FIRMWARE_UPDATE_IMAGE_BASE % model.sectorSize) != 0))
+    {
+        fprintf(stderr, "Timing model has an invalid flash geometry!\n");
+        return 1;
+    }
+
+    pImage = readFile(pszImage_p, &length);
+    if (pImage == NULL)
+        return 1;
+
+    if ((fwimage_getHeader(pImage, length, &header) != FWIMAGE_OK) ||
+        (header.length != (length - FWIMAGE_HEADER_SIZE)))
+    {
+        fprintf(stderr, "File is no valid update image!\n");
+        goto Exit;
+    }
+
+    regionEnd = getUpdateRegionEnd(&model);
+    imageEnd = FIRMWARE_UPDATE_IMAGE_BASE + (uint32_t)length;
+
+    printf("Flash layout (%u KB, %u KB sectors):\n",
+           model.flashSize / 1024U, model.sectorSize / 1024U);
+    printf(" Factory image  0x%08X - 0x%08X\n",
+           FIRMWARE_FACTORY_IMAGE_BASE, FIRMWARE_DEVICE_HEADER_BASE - 1);
+    printf(" Device header  0x%08X - 0x%08X\n",
+           FIRMWARE_DEVICE_HEADER_BASE, FIRMWARE_UPDATE_IMAGE_BASE - 1);
+    printf(" Update region  0x%08X - 0x%08X\n", FIRMWARE_UPDATE_IMAGE_BASE, regionEnd - 1);
+    if (regionEnd < model.flashSize)
+    {
+        printf(" Header backup  0x%08X - 0x%08X\n",
+               regionEnd, regionEnd + model.sectorSize - 1);
+        printf(" Journal        0x%08X - 0x%08X\n",
+               regionEnd + model.sectorSize, model.flashSize - 1);
+    }
+
+    printf("Update image:\n");
+    printf(" Location       0x%08X - 0x%08X\n", FIRMWARE_UPDATE_IMAGE_BASE, imageEnd - 1);
+
+    if (imageEnd > regionEnd)
+    {
+        fprintf(stderr, "Update image exceeds the update region by %u bytes!\n",
+                imageEnd - regionEnd);
+        goto Exit;
+    }
+
+    printf(" Sectors        %u of %u (%u bytes free)\n",
+           (uint32_t)((length + model.sectorSize - 1) / model.sectorSize),
+           (regionEnd - FIRMWARE_UPDATE_IMAGE_BASE) / model.sectorSize, regionEnd - imageEnd);
+
+    getFullUpdateWork((uint32_t)length, &model, &work);
+    printPrediction("Full update", &work, &model);
+
+    if (fwimage_getSectionTable(pImage + FWIMAGE_HEADER_SIZE, header.length,
+                                &table) == FWIMAGE_OK)
+    {
+        getSectionUpdateWork(&header, &table, &model, &work);
+        printPrediction("Application section update (same bitstream stored)", &work, &model);
+    }
+
+    ret = 0;
+
+Exit:
+    free(pImage);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Update timing model
+
+The function sets parameters of a timing model file. An existing model is
+loaded first, otherwise the default model is used. Each argument may contain
+several parameters separated by white space. Words without '=' are ignored, so
+the timing model line printed by the daemon can be passed as it is.
+
+\param  pszModel_p      Timing model file
+\param  argc_p          Number of parameter arguments
+\param  argv_p          Parameter arguments
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int calibrateModel(const char* pszModel_p, int argc_p, char** argv_p)
+{
+    tTimingModel    model = defaultModel_l;
+    FILE*           pFile;
+    char*           pszParam;
+    int             i;
+
+    // A missing model file is created from the default model
+    pFile = fopen(pszModel_p, "r");
+    if (pFile != NULL)
+    {
+        fclose(pFile);
+        if (loadModel(pszModel_p, &model) != 0)
+            return 1;
+    }
+
+    for (i = 0; i < argc_p; i++)
+    {
+        for (pszParam = strtok(argv_p[i], " \t\r\n"); pszParam != NULL;
+             pszParam = strtok(NULL, " \t\r\n"))
+        {
+            if ((strchr(pszParam, '=') != NULL) && (setModelParam(&model, pszParam) != 0))
+                return 1;
+        }
+    }
+
+    if (saveModel(pszModel_p, &model) != 0)
+        return 1;
+
+    for (i = 0; i < (int)(sizeof(aTimingParam_l) / sizeof(aTimingParam_l[0])); i++)
+    {
+        printf(" %-20s %10u  %s\n", aTimingParam_l[i].pszKey,
+               *(const uint32_t*)((const uint8_t*)&model + aTimingParam_l[i].offset),
+               aTimingParam_l[i].pszDescription);
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get flash work of full update
+
+The function determines the flash work of the download of a plain update image.
+The daemon erases all sectors of the image and clears the journal sector. The
+data is read back once after programming, which also yields the CRC for the
+journal commit of every sector, and once more for the image check before the
+reconfiguration.
+
+\param  fileLength_p    Length of the update image file
+\param  pModel_p        Timing model
+\param  pWork_p         Pointer to store the flash work
+*/
+//------------------------------------------------------------------------------
+static void getFullUpdateWork(uint32_t fileLength_p, const tTimingModel* pModel_p,
+                              tFlashWork* pWork_p)
+{
+    uint32_t    sectorCount = (fileLength_p + pModel_p->sectorSize - 1) / pModel_p->sectorSize;
+
+    pWork_p->transferLength = fileLength_p;
+    pWork_p->eraseCount = sectorCount + 1;
+    pWork_p->programLength = fileLength_p;
+    pWork_p->verifyLength = fileLength_p + (fileLength_p - FWIMAGE_HEADER_SIZE);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get flash work of section update
+
+The function determines the flash work of the replacement of the application
+section. The daemon rewrites the first sector without the header and the sector
+shared with the bitstream, then it programs the application section and the
+section table. The data is read back after programming, for the section check
+and for the image check before the reconfiguration.
+
+\param  pHeader_p       Firmware header of the update image
+\param  pTable_p        Section table of the update image
+\param  pModel_p        Timing model
+\param  pWork_p         Pointer to store the flash work
+*/
+//------------------------------------------------------------------------------
+static void getSectionUpdateWork(const tFwImageHeader* pHeader_p,
+                                 const tFwImageSectionTable* pTable_p,
+                                 const tTimingModel* pModel_p, tFlashWork* pWork_p)
+{
+    const uint32_t  imageBase = FIRMWARE_UPDATE_IMAGE_BASE;
+    uint32_t        sectorSize = pModel_p->sectorSize;
+    uint32_t        startOffset;
+    uint32_t        sectorOffset;
+    uint32_t        imageEnd;
+    uint32_t        dataLength;
+    uint32_t        keepLength;
+
+    startOffset = imageBase + FWIMAGE_HEADER_SIZE +
+                  pTable_p->aSection[FWIMAGE_SECTION_APPLICATION].offset;
+    sectorOffset = startOffset - ((startOffset - imageBase) % sectorSize);
+    imageEnd = imageBase + FWIMAGE_HEADER_SIZE + pHeader_p->length;
+    dataLength = imageEnd - startOffset;
+
+    // First sector, kept data behind the header
+    if (startOffset < (imageBase + sectorSize))
+        keepLength = startOffset - (imageBase + FWIMAGE_HEADER_SIZE);
+    else
+        keepLength = sectorSize - FWIMAGE_HEADER_SIZE;
+
+    pWork_p->eraseCount = 2 + ((imageEnd - sectorOffset - 1) / sectorSize);
+
+    // Sector shared by bitstream and application
+    if (sectorOffset != imageBase)
+    {
+        keepLength += startOffset - sectorOffset;
+        pWork_p->eraseCount++;
+    }
+
+    pWork_p->transferLength = (uint32_t)sizeof(tFwImageSectionUpdate) + dataLength;
+    pWork_p->programLength = keepLength + dataLength + FWIMAGE_HEADER_SIZE;
+    pWork_p->verifyLength = pWork_p->programLength + dataLength + pHeader_p->length;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print update prediction
+
+The function prints the flash work of an update and its predicted duration.
+The phases are executed one after the other, as the daemon processes a file
+chunk completely before the host sends the next one.
+
+\param  pszTitle_p      Title of the prediction
+\param  pWork_p         Flash work of the update
+\param  pModel_p        Timing model
+*/
+//------------------------------------------------------------------------------
+static void printPrediction(const char* pszTitle_p, const tFlashWork* pWork_p,
+                            const tTimingModel* pModel_p)
+{
+    uint32_t    chunkCount = (pWork_p->transferLength + pModel_p->chunkSize - 1) /
+                             pModel_p->chunkSize;
+    double      transferMs;
+    double      eraseMs;
+    double      programMs;
+    double      verifyMs;
+
+    transferMs = ((double)chunkCount * pModel_p->chunkUs +
+                  (pWork_p->transferLength / 1024.0) * pModel_p->transferUsPerKb) / 1000.0;
+    eraseMs = (double)pWork_p->eraseCount * pModel_p->eraseMs;
+    programMs = ((pWork_p->programLength / 1024.0) * pModel_p->programUsPerKb) / 1000.0;
+    verifyMs = ((pWork_p->verifyLength / 1024.0) * pModel_p->verifyUsPerKb) / 1000.0;
+
+    printf("%s:\n", pszTitle_p);
+    printf(" Transfer       %10u bytes   %6u chunks %8.1f s\n",
+           pWork_p->transferLength, chunkCount, transferMs / 1000.0);
+    printf(" Erase          %10u sectors               %8.1f s\n",
+           pWork_p->eraseCount, eraseMs / 1000.0);
+    printf(" Program        %10u bytes                 %8.1f s\n",
+           pWork_p->programLength, programMs / 1000.0);
+    printf(" Verify         %10u bytes                 %8.1f s\n",
+           pWork_p->verifyLength, verifyMs / 1000.0);
+    printf(" Total                                           %8.1f s\n",
+           (transferMs + eraseMs + programMs + verifyMs) / 1000.0);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get end of update region
+
+The function returns the end of the flash region available for the update
+image. The download journal occupies the last sector of the flash, the device
+header backup sector is located before it.
+
+\param  pModel_p        Timing model
+
+\return The function returns the end offset of the update region.
+*/
+//------------------------------------------------------------------------------
+static uint32_t getUpdateRegionEnd(const tTimingModel* pModel_p)
+{
+#ifdef FIRMWARE_JOURNAL_BITMAP_SIZE
+    return pModel_p->flashSize - (2 * pModel_p->sectorSize);
+#else
+    return pModel_p->flashSize;
+#endif
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Load timing model
+
+The function reads a timing model file. It consists of lines with
+<KEY>=<VALUE>, empty lines and comment lines starting with '#' are skipped.
+Parameters missing in the file keep their value.
+
+\param  pszModel_p      Timing model file
+\param  pModel_p        Pointer to the timing model
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int loadModel(const char* pszModel_p, tTimingModel* pModel_p)
+{
+    FILE*   pFile;
+    char    aLine[MODEL_LINE_SIZE];
+    char*   pszParam;
+    int     ret = 0;
+
+    pFile = fopen(pszModel_p, "r");
+    if (pFile == NULL)
+    {
+        fprintf(stderr, "Unable to open %s!\n", pszModel_p);
+        return 1;
+    }
+
+    while ((ret == 0) && (fgets(aLine, sizeof(aLine), pFile) != NULL))
+    {
+        pszParam = strtok(aLine, " \t\r\n");
+        if ((pszParam == NULL) || (pszParam[0] == '#'))
+            continue;
+
+        ret = setModelParam(pModel_p, pszParam);
+    }
+
+    fclose(pFile);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Save timing model
+
+The function writes a timing model file.
+
+\param  pszModel_p      Timing model file
+\param  pModel_p        Timing model
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int saveModel(const char* pszModel_p, const tTimingModel* pModel_p)
+{
+    FILE*   pFile;
+    size_t  i;
+
+    pFile = fopen(pszModel_p, "w");
+    if (pFile == NULL)
+    {
+        fprintf(stderr, "Unable to create %s!\n", pszModel_p);
+        return 1;
+    }
+
+    fprintf(pFile, "# Timing model of the update time predictor\n");
+    for (i = 0; i < (sizeof(aTimingParam_l) / sizeof(aTimingParam_l[0])); i++)
+    {
+        fprintf(pFile, "# %s\n%s=%u\n", aTimingParam_l[i].pszDescription,
+                aTimingParam_l[i].pszKey,
+                *(const uint32_t*)((const uint8_t*)pModel_p + aTimingParam_l[i].offset));
+    }
+
+    if (fclose(pFile) != 0)
+    {
+        fprintf(stderr, "Unable to write %s!\n", pszModel_p);
+        return 1;
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Set timing model parameter
+
+The function sets a parameter of the timing model given as <KEY>=<VALUE>.
+
+\param  pModel_p        Pointer to the timing model
+\param  pszParam_p      Parameter string
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int setModelParam(tTimingModel* pModel_p, const char* pszParam_p)
+{
+    const char* pszValue = strchr(pszParam_p, '=');
+    char*       pszEnd;
+    uint32_t    value;
+    size_t      keyLength;
+    size_t      i;
+
+    if (pszValue == NULL)
+    {
+        fprintf(stderr, "Invalid timing model parameter %s!\n", pszParam_p);
+        return 1;
+    }
+
+    keyLength = (size_t)(pszValue - pszParam_p);
+    value = (uint32_t)strtoul(pszValue + 1, &pszEnd, 0);
+    if ((pszValue[1] == '\0') || (*pszEnd != '\0'))
+    {
+        fprintf(stderr, "Invalid value of timing model parameter %s!\n", pszParam_p);
+        return 1;
+    }
+
+    for (i = 0; i < (sizeof(aTimingParam_l) / sizeof(aTimingParam_l[0])); i++)
+    {
+        if ((strlen(aTimingParam_l[i].pszKey) == keyLength) &&
+            (strncmp(aTimingParam_l[i].pszKey, pszParam_p, keyLength) == 0))
+        {
+            *(uint32_t*)((uint8_t*)pModel_p + aTimingParam_l[i].offset) = value;
+            return 0;
+        }
+    }
+
+    fprintf(stderr, "Unknown timing model parameter %s!\n", pszParam_p);
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Load input file
+
+The function loads a bitstream or application file. S-record files are
+converted to their binary content.
+
+\param  pszFile_p       File name
+\param  pInput_p        Pointer to store the content
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int loadInput(const char* pszFile_p, tImageInput* pInput_p)
+{
+    uint8_t*    pText;
+    size_t      length;
+
+    pText = readFile(pszFile_p, &length);
+    if (pText == NULL)
+        return 1;
+
+    if (!isSrec(pText, length))
+    {
+        pInput_p->pData = pText;
+        pInput_p->length = length;
+        pInput_p->address = 0;
+        pInput_p->fSrec = 0;
+        return 0;
+    }
+
+    if (parseSrec(pText, length, pInput_p) != 0)
+    {
+        fprintf(stderr, "Invalid S-record file %s\n", pszFile_p);
+        free(pText);
+        return 1;
+    }
+
+    free(pText);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Check for S-record file
+
+\param  pText_p         File content
+\param  length_p        Length of file content
+
+\return The function returns 1 if the file starts with an S-record, otherwise 0.
+*/
+//------------------------------------------------------------------------------
+static int isSrec(const uint8_t* pText_p, size_t length_p)
+{
+    return (length_p >= 4) && (pText_p[0] == 'S') &&
+           (pText_p[1] >= '0') && (pText_p[1] <= '9');
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Parse S-record file
+
+The function converts the data records of an S-record file to a binary. The
+binary starts at the lowest address, gaps are filled with SREC_GAP_FILL. The
+file is parsed twice, first to get the address range, then to copy the data.
+
+\param  pText_p         File content
+\param  length_p        Length of file content
+\param  pInput_p        Pointer to store the binary content
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int parseSrec(const uint8_t* pText_p, size_t length_p, tImageInput* pInput_p)
+{
+    char*       pszText;
+    char*       pszLine;
+    char*       pszNext;
+    uint8_t     aData[256];
+    size_t      dataLength;
+    uint32_t    address;
+    uint32_t    lowAddress = 0xFFFFFFFF;
+    uint32_t    highAddress = 0;
+    int         pass;
+    int         ret = 1;
+
+    // Copy the text to terminate lines in place
+    pszText = (char*)malloc(length_p + 1);
+    if (pszText == NULL)
+        return 1;
+
+    for (pass = 0; pass < 2; pass++)
+    {
+        memcpy(pszText, pText_p, length_p);
+        pszText[length_p] = '\0';
+
+        for (pszLine = pszText; *pszLine != '\0'; pszLine = pszNext)
+        {
+            pszNext = pszLine + strcspn(pszLine, "\r\n");
+            if (*pszNext != '\0')
+                *pszNext++ = '\0';
+
+            if (*pszLine == '\0')
+                continue;
+
+            if (parseSrecRecord(pszLine, &address, aData, &dataLength) != 0)
+                goto Exit;
+
+            if (dataLength == 0)
+                continue;
+
+            if (pass == 0)
+            {
+                if (address < lowAddress)
+                    lowAddress = address;
+
+                if ((address + dataLength) > highAddress)
+                    highAddress = address + (uint32_t)dataLength;
+            }
+            else
+                memcpy(pInput_p->pData + (address - lowAddress), aData, dataLength);
+        }
+
+        if (pass == 0)
+        {
+            if (highAddress <= lowAddress)
+                goto Exit;
+
+            pInput_p->address = lowAddress;
+            pInput_p->length = highAddress - lowAddress;
+            pInput_p->fSrec = 1;
+            pInput_p->pData = (uint8_t*)malloc(pInput_p->length);
+            if (pInput_p->pData == NULL)
+                goto Exit;
+
+            memset(pInput_p->pData, SREC_GAP_FILL, pInput_p->length);
+        }
+    }
+
+    ret = 0;
+
+Exit:
+    free(pszText);
+
+    return ret;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Parse S-record
+
+The function parses a single S-record and checks its checksum. Only S1, S2
+and S3 records carry data, all other records are returned without data.
+
+\param  pszLine_p       S-record
+\param  pAddress_p      Pointer to store the address
+\param  pData_p         Pointer to store the data (255 bytes at most)
+\param  pLength_p       Pointer to store the data length
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int parseSrecRecord(const char* pszLine_p, uint32_t* pAddress_p,
+                           uint8_t* pData_p, size_t* pLength_p)
+{
+    uint32_t    count;
+    uint32_t    value;
+    uint32_t    sum;
+    size_t      addressSize;
+    size_t      i;
+
+    if ((pszLine_p[0] != 'S') || (parseHex(pszLine_p + 2, 2, &count) != 0) ||
+        (strlen(pszLine_p) != (4 + (count * 2))))
+        return 1;
+
+    switch (pszLine_p[1])
+    {
+        case '1':
+        case '9':
+            addressSize = 2;
+            break;
+
+        case '2':
+        case '8':
+            addressSize = 3;
+            break;
+
+        case '3':
+        case '7':
+            addressSize = 4;
+            break;
+
+        default:
+            addressSize = 2;
+            break;
+    }
+
+    if (count < (addressSize + 1))
+        return 1;
+
+    // Checksum is the complement of the sum of count, address and data
+    sum = count;
+    for (i = 0; i < count; i++)
+    {
+        if (parseHex(pszLine_p + 4 + (i * 2), 2, &value) != 0)
+            return 1;
+
+        if (i < (count - 1))
+            sum += value;
+        else if ((~sum & 0xFF) != value)
+            return 1;
+    }
+
+    parseHex(pszLine_p + 4, addressSize * 2, pAddress_p);
+
+    *pLength_p = 0;
+    if ((pszLine_p[1] >= '1') && (pszLine_p[1] <= '3'))
+    {
+        *pLength_p = count - addressSize - 1;
+        for (i = 0; i < *pLength_p; i++)
+        {
+            parseHex(pszLine_p + 4 + ((addressSize + i) * 2), 2, &value);
+            pData_p[i] = (uint8_t)value;
+        }
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Parse hex number
+
+\param  pszText_p       Text
+\param  digits_p        Number of hex digits
+\param  pValue_p        Pointer to store the value
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int parseHex(const char* pszText_p, size_t digits_p, uint32_t* pValue_p)
+{
+    uint32_t    value = 0;
+    char        digit;
+    size_t      i;
+
+    for (i = 0; i < digits_p; i++)
+    {
+        digit = pszText_p[i];
+        value <<= 4;
+
+        if ((digit >= '0') && (digit <= '9'))
+            value |= (uint32_t)(digit - '0');
+        else if ((digit >= 'A') && (digit <= 'F'))
+            value |= (uint32_t)(digit - 'A' + 10);
+        else if ((digit >= 'a') && (digit <= 'f'))
+            value |= (uint32_t)(digit - 'a' + 10);
+        else
+            return 1;
+    }
+
+    *pValue_p = value;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Read file
+
+\param  pszFile_p       File name
+\param  pLength_p       Pointer to store the file length
+
+\return The function returns the allocated file content, or NULL on error.
+*/
+//------------------------------------------------------------------------------
+static uint8_t* readFile(const char* pszFile_p, size_t* pLength_p)
+{
+    FILE*       pFile;
+    uint8_t*    pData = NULL;
+    long        fileSize;
+
+    pFile = fopen(pszFile_p, "rb");
+    if (pFile == NULL)
+    {
+        fprintf(stderr, "Unable to open file %s\n", pszFile_p);
+        return NULL;
+    }
+
+    fseek(pFile, 0, SEEK_END);
+    fileSize = ftell(pFile);
+    rewind(pFile);
+
+    if (fileSize >= 0)
+        pData = (uint8_t*)malloc((fileSize > 0) ? (size_t)fileSize : 1);
+
+    if ((pData == NULL) || (fread(pData, 1, (size_t)fileSize, pFile) != (size_t)fileSize))
+    {
+        fprintf(stderr, "Unable to read file %s\n", pszFile_p);
+        free(pData);
+        pData = NULL;
+    }
+    else
+        *pLength_p = (size_t)fileSize;
+
+    fclose(pFile);
+
+    return pData;
+}
+
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print usage
+
+\param  pszName_p       Name of the tool
+*/
+//------------------------------------------------------------------------------
+static void printUsage(const char* pszName_p)
+{
+    printf("Usage: %s create [-t <TIME_STAMP>] <BITSTREAM> <APPLICATION> <OPLK_VERSION> "
+           "<OPLK_FEATURE> <IMAGE>\n"
+           "       %s info <IMAGE>\n"
+           "       %s verify <IMAGE>\n"
+           "       %s predict [-m <MODEL>] <IMAGE>\n"
+           "       %s calibrate <MODEL> [<KEY>=<VALUE> ...]\n"
+           "create    : Create update image from bitstream and application (S-record or binary)\n"
+           "info      : Show firmware header and section table of update image\n"
+           "verify    : Verify firmware header, image and section CRCs of update image\n"
+           "predict   : Show flash layout and predict the update duration of update image\n"
+           "calibrate : Update timing model with measured values (e.g. the \"Timing model\"\n"
+           "            line printed by the daemon after a file transfer)\n"
+           "-t        : Time stamp of the firmware header (default current time)\n"
+           "-m        : Timing model file of the card (default EPCS128 datasheet values)\n",
+           pszName_p, pszName_p, pszName_p, pszName_p, pszName_p);
+}
+
+/// \}
@@ -0,0 +1,509 @@
+/**
+********************************************************************************
+\file   main.c
+
+\brief  Main file of VETH queue benchmark
+
+This file contains the main file of the VETH queue benchmark. It runs a bulk
+transfer through a host-side stand-in of the virtual Ethernet Tx queue of the
+dualprocshm DLL CAL and reports throughput and queueing latency. It is used to
+choose CONFIG_DLLCAL_VETH_TX_FRAME_COUNT in dualprocshm-mem.h.
+
+\ingroup module_vethbench_tool
+*******************************************************************************/
+
+/*------------------------------------------------------------------------------
+Copyright (c) 2015, Bernecker+Rainer Industrie-Elektronik Ges.m.b.H. (B&R)
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions are met:
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in the
+      documentation and/or other materials provided with the distribution.
+    * Neither the name of the copyright holders nor the
+      names of its contributors may be used to endorse or promote products
+      derived from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+DISCLAIMED. IN NO EVENT SHALL COPYRIGHT HOLDERS BE LIABLE FOR ANY
+DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+(INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+(INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+------------------------------------------------------------------------------*/
+
+//------------------------------------------------------------------------------
+// includes
+//------------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+//============================================================================//
+//            G L O B A L   D E F I N I T I O N S                             //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// module global vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// global function prototypes
+//------------------------------------------------------------------------------
+
+//============================================================================//
+//            P R I V A T E   D E F I N I T I O N S                           //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+// const defines
+//------------------------------------------------------------------------------
+// Queue layout, see DLLCAL_VETH_TX_FRAME_SIZE in dualprocshm-mem.h
+#define QUEUE_FRAME_SIZE            1536            // Queue space reserved per frame
+#define QUEUE_BLOCK_HEADER_SIZE     8               // Circular buffer block header
+#define QUEUE_BLOCK_ALIGNMENT       8               // Circular buffer block alignment
+
+#define DEFAULT_FRAME_COUNT         4               // CONFIG_DLLCAL_VETH_TX_FRAME_COUNT
+#define DEFAULT_FRAME_LENGTH        1514            // Maximum Ethernet frame w/o CRC
+#define DEFAULT_CYCLE_TIME          1000            // POWERLINK cycle time [us]
+#define DEFAULT_SLOT_COUNT          1               // VETH frames sent per cycle
+#define DEFAULT_HOST_LATENCY        3000            // Host refill latency [us]
+#define DEFAULT_TRANSFER_FRAMES     1000            // Frames of the bulk transfer
+
+#define SWEEP_MAX_FRAME_COUNT       8               // Largest queue depth of a sweep
+
+//------------------------------------------------------------------------------
+// local types
+//------------------------------------------------------------------------------
+
+/**
+\brief Benchmark parameters
+
+The struct describes the queue and the traffic of a benchmark run. The MN sends
+at most slotCount VETH frames in the asynchronous phase of each cycle. The host
+posts frames until the queue is full and then waits for the frame sent event,
+which reaches it hostLatency after the PCP has sent the next frame.
+*/
+typedef struct
+{
+    uint32_t    queueSize;          ///< Size of the Tx queue [byte]
+    uint32_t    frameLength;        ///< Length of the transferred frames [byte]
+    uint32_t    cycleTime;          ///< Cycle time [us]
+    uint32_t    slotCount;          ///< VETH frames sent per cycle
+    uint32_t    hostLatency;        ///< Latency of the host to refill the queue [us]
+    uint32_t    transferFrames;     ///< Number of frames to transfer
+} tBenchParam;
+
+/**
+\brief Benchmark result
+*/
+typedef struct
+{
+    uint64_t    sentBytes;          ///< Sent frame data [byte]
+    uint64_t    duration;           ///< Duration of the transfer [us]
+    uint32_t    idleSlots;          ///< Send slots lost on an empty queue
+    uint32_t    fullCount;          ///< Number of posts refused on a full queue
+    uint64_t    latencySum;         ///< Sum of the queueing latencies [us]
+    uint64_t    latencyMax;         ///< Maximum queueing latency [us]
+} tBenchResult;
+
+/**
+\brief Queued frame
+*/
+typedef struct
+{
+    uint32_t    blockSize;          ///< Queue space used by the frame [byte]
+    uint64_t    postTime;           ///< Time the frame was posted [us]
+} tQueueEntry;
+
+/**
+\brief VETH Tx queue stand-in
+
+The struct models the occupancy of the circular buffer of the VETH Tx queue.
+Each frame takes its length plus the block header, aligned to the block
+alignment. Only the occupancy is modeled, the frame data is not copied.
+*/
+typedef struct
+{
+    uint32_t        size;           ///< Size of the queue [byte]
+    uint32_t        used;           ///< Occupied queue space [byte]
+    tQueueEntry*    paEntry;        ///< Ring of queued frames
+    uint32_t        entryCount;     ///< Size of the ring
+    uint32_t        readIndex;      ///< Oldest queued frame
+    uint32_t        fillCount;      ///< Number of queued frames
+} tQueue;
+
+//------------------------------------------------------------------------------
+// local vars
+//------------------------------------------------------------------------------
+
+//------------------------------------------------------------------------------
+// local function prototypes
+//------------------------------------------------------------------------------
+static int  runBenchmark(const tBenchParam* pParam_p, tBenchResult* pResult_p);
+static void printResult(const tBenchParam* pParam_p, const tBenchResult* pResult_p);
+static int  runSweep(const tBenchParam* pParam_p);
+static int  queuePost(tQueue* pQueue_p, uint32_t length_p, uint64_t time_p);
+static int  queueGet(tQueue* pQueue_p, tQueueEntry* pEntry_p);
+static void printUsage(const char* pszName_p);
+
+//============================================================================//
+//            P U B L I C   F U N C T I O N S                                 //
+//============================================================================//
+
+//------------------------------------------------------------------------------
+/**
+\brief  main function
+
+This is the main function of the VETH queue benchmark.
+
+\param  argc                    Number of arguments
+\param  argv                    Pointer to argument strings
+
+\return Returns an exit code
+
+\ingroup module_vethbench_tool
+*/
+//------------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+    tBenchParam     param;
+    tBenchResult    result;
+    int             fSweep = 0;
+    int             i;
+
+    param.queueSize = DEFAULT_FRAME_COUNT * QUEUE_FRAME_SIZE;
+    param.frameLength = DEFAULT_FRAME_LENGTH;
+    param.cycleTime = DEFAULT_CYCLE_TIME;
+    param.slotCount = DEFAULT_SLOT_COUNT;
+    param.hostLatency = DEFAULT_HOST_LATENCY;
+    param.transferFrames = DEFAULT_TRANSFER_FRAMES;
+
+    for (i = 1; i < argc; i++)
+    {
+        uint32_t*   pValue = NULL;
+
+        if (strcmp(argv[i], "-S") == 0)
+        {
+            fSweep = 1;
+            continue;
+        }
+
+        if (strcmp(argv[i], "-q") == 0)
+            pValue = &param.queueSize;
+        else if (strcmp(argv[i], "-l") == 0)
+            pValue = &param.frameLength;
+        else if (strcmp(argv[i], "-c") == 0)
+            pValue = &param.cycleTime;
+        else if (strcmp(argv[i], "-a") == 0)
+            pValue = &param.slotCount;
+        else if (strcmp(argv[i], "-r") == 0)
+            pValue = &param.hostLatency;
+        else if (strcmp(argv[i], "-n") == 0)
+            pValue = &param.transferFrames;
+
+        if ((pValue == NULL) || ((i + 1) >= argc))
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+
+        *pValue = (uint32_t)strtoul(argv[++i], NULL, 0);
+    }
+
+    if ((param.frameLength == 0) || (param.cycleTime == 0) ||
+        (param.slotCount == 0) || (param.transferFrames == 0))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    if (fSweep)
+        return runSweep(&param);
+
+    if (runBenchmark(&param, &result) != 0)
+        return 1;
+
+    printResult(&param, &result);
+
+    return 0;
+}
+
+//============================================================================//
+//            P R I V A T E   F U N C T I O N S                               //
+//============================================================================//
+/// \name Private Functions
+/// \{
+
+//------------------------------------------------------------------------------
+/**
+\brief  Run benchmark
+
+The function transfers the frames of a bulk transfer through the queue
+stand-in cycle by cycle. At the start of each cycle the host posts frames if it
+is awake, then the PCP sends up to the configured number of frames.
+
+\param  pParam_p        Benchmark parameters
+\param  pResult_p       Returns the benchmark result
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int runBenchmark(const tBenchParam* pParam_p, tBenchResult* pResult_p)
+{
+    tQueue      queue;
+    tQueueEntry entry;
+    uint32_t    posted = 0;
+    uint32_t    sent = 0;
+    uint64_t    time = 0;
+    uint64_t    hostWakeTime = 0;
+    int         fHostStopped = 0;
+
+    memset(pResult_p, 0, sizeof(tBenchResult));
+    memset(&queue, 0, sizeof(tQueue));
+
+    queue.size = pParam_p->queueSize;
+    queue.entryCount = (pParam_p->queueSize / QUEUE_BLOCK_ALIGNMENT) + 1;
+    queue.paEntry = (tQueueEntry*)malloc(queue.entryCount * sizeof(tQueueEntry));
+    if (queue.paEntry == NULL)
+        return 1;
+
+    if (queuePost(&queue, pParam_p->frameLength, 0) != 0)
+    {
+        fprintf(stderr, "A frame of %lu bytes does not fit into the queue of %lu bytes!\n",
+                (unsigned long)pParam_p->frameLength, (unsigned long)pParam_p->queueSize);
+        free(queue.paEntry);
+        return 1;
+    }
+
+    posted++;
+
+    while (sent < pParam_p->transferFrames)
+    {
+        uint32_t    slots = pParam_p->slotCount;
+
+        // The queue only changes at the cycle start, so the frames the host
+        // posts when it wakes up within the last cycle are posted now.
+        if (!fHostStopped && (hostWakeTime <= time))
+        {
+            while (posted < pParam_p->transferFrames)
+            {
+                if (queuePost(&queue, pParam_p->frameLength, hostWakeTime) != 0)
+                {
+                    pResult_p->fullCount++;
+                    fHostStopped = 1;
+                    break;
+                }
+
+                posted++;
+            }
+        }
+
+        while ((slots > 0) && (queueGet(&queue, &entry) == 0))
+        {
+            uint64_t    latency = time - entry.postTime;
+
+            pResult_p->latencySum += latency;
+            if (latency > pResult_p->latencyMax)
+                pResult_p->latencyMax = latency;
+
+            pResult_p->sentBytes += pParam_p->frameLength;
+            sent++;
+            slots--;
+
+            // The sent event of the first frame wakes up the host
+            if (fHostStopped)
+            {
+                fHostStopped = 0;
+                hostWakeTime = time + pParam_p->hostLatency;
+            }
+        }
+
+        if (sent < pParam_p->transferFrames)
+            pResult_p->idleSlots += slots;
+
+        time += pParam_p->cycleTime;
+    }
+
+    pResult_p->duration = time;
+
+    free(queue.paEntry);
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print benchmark result
+
+\param  pParam_p        Benchmark parameters
+\param  pResult_p       Benchmark result
+*/
+//------------------------------------------------------------------------------
+static void printResult(const tBenchParam* pParam_p, const tBenchResult* pResult_p)
+{
+    double  slotRate;
+    double  throughput;
+
+    // Frame data the async slots can carry in the transfer time
+    slotRate = ((double)pParam_p->slotCount * pParam_p->frameLength * 1000000.0) /
+               pParam_p->cycleTime;
+    throughput = ((double)pResult_p->sentBytes * 1000000.0) / (double)pResult_p->duration;
+
+    printf("Queue          %lu bytes\n", (unsigned long)pParam_p->queueSize);
+    printf("Frame          %lu bytes\n", (unsigned long)pParam_p->frameLength);
+    printf("Cycle          %lu us, %lu VETH frame(s) per cycle\n",
+           (unsigned long)pParam_p->cycleTime, (unsigned long)pParam_p->slotCount);
+    printf("Host latency   %lu us\n", (unsigned long)pParam_p->hostLatency);
+    printf("Transfer       %lu frames in %.1f ms\n", (unsigned long)pParam_p->transferFrames,
+           pResult_p->duration / 1000.0);
+    printf("Throughput     %.0f bytes/s (%.1f%% of the VETH slots)\n",
+           throughput, (throughput * 100.0) / slotRate);
+    printf("Idle slots     %lu\n", (unsigned long)pResult_p->idleSlots);
+    printf("Queue full     %lu times\n", (unsigned long)pResult_p->fullCount);
+    printf("Latency        avg %.0f us, max %lu us\n",
+           (double)pResult_p->latencySum / pParam_p->transferFrames,
+           (unsigned long)pResult_p->latencyMax);
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Run queue depth sweep
+
+The function runs the benchmark for queues of 1 to SWEEP_MAX_FRAME_COUNT full
+frames and prints a line per queue depth. The smallest depth which reaches
+100% of the VETH slots is the one to configure for the given host latency.
+
+\param  pParam_p        Benchmark parameters, the queue size is ignored
+
+\return The function returns 0 on success, otherwise 1.
+*/
+//------------------------------------------------------------------------------
+static int runSweep(const tBenchParam* pParam_p)
+{
+    tBenchParam     param = *pParam_p;
+    tBenchResult    result;
+    uint32_t        frameCount;
+    double          slotRate;
+
+    slotRate = ((double)param.slotCount * param.frameLength * 1000000.0) / param.cycleTime;
+
+    printf("Cycle %lu us, %lu VETH frame(s) per cycle, host latency %lu us, frame %lu bytes\n",
+           (unsigned long)param.cycleTime, (unsigned long)param.slotCount,
+           (unsigned long)param.hostLatency, (unsigned long)param.frameLength);
+    printf("Frames  Queue   Throughput [bytes/s]  Slots   Latency avg/max [us]\n");
+
+    for (frameCount = 1; frameCount <= SWEEP_MAX_FRAME_COUNT; frameCount++)
+    {
+        double  throughput;
+
+        param.queueSize = frameCount * QUEUE_FRAME_SIZE;
+        if (runBenchmark(&param, &result) != 0)
+            return 1;
+
+        throughput = ((double)result.sentBytes * 1000000.0) / (double)result.duration;
+
+        printf("%6lu  %5lu  %20.0f  %5.1f%%  %8.0f/%-8lu\n",
+               (unsigned long)frameCount, (unsigned long)param.queueSize, throughput,
+               (throughput * 100.0) / slotRate,
+               (double)result.latencySum / param.transferFrames,
+               (unsigned long)result.latencyMax);
+    }
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Post frame to queue
+
+\param  pQueue_p        Queue stand-in
+\param  length_p        Frame length
+\param  time_p          Time of the post [us]
+
+\return The function returns 0 on success, or 1 if the queue is full.
+*/
+//------------------------------------------------------------------------------
+static int queuePost(tQueue* pQueue_p, uint32_t length_p, uint64_t time_p)
+{
+    uint32_t        blockSize;
+    tQueueEntry*    pEntry;
+
+    blockSize = (length_p + QUEUE_BLOCK_HEADER_SIZE + QUEUE_BLOCK_ALIGNMENT - 1) &
+                ~(uint32_t)(QUEUE_BLOCK_ALIGNMENT - 1);
+
+    if (((pQueue_p->size - pQueue_p->used) < blockSize) ||
+        (pQueue_p->fillCount >= pQueue_p->entryCount))
+        return 1;
+
+    pEntry = &pQueue_p->paEntry[(pQueue_p->readIndex + pQueue_p->fillCount) %
+                                pQueue_p->entryCount];
+    pEntry->blockSize = blockSize;
+    pEntry->postTime = time_p;
+
+    pQueue_p->used += blockSize;
+    pQueue_p->fillCount++;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Get oldest frame from queue
+
+\param  pQueue_p        Queue stand-in
+\param  pEntry_p        Returns the removed frame
+
+\return The function returns 0 on success, or 1 if the queue is empty.
+*/
+//------------------------------------------------------------------------------
+static int queueGet(tQueue* pQueue_p, tQueueEntry* pEntry_p)
+{
+    if (pQueue_p->fillCount == 0)
+        return 1;
+
+    *pEntry_p = pQueue_p->paEntry[pQueue_p->readIndex];
+
+    pQueue_p->used -= pEntry_p->blockSize;
+    pQueue_p->readIndex = (pQueue_p->readIndex + 1) % pQueue_p->entryCount;
+    pQueue_p->fillCount--;
+
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+/**
+\brief  Print usage
+
+\param  pszName_p       Name of the executable
+*/
+//------------------------------------------------------------------------------
+static void printUsage(const char* pszName_p)
+{
+    printf("Usage: %s [-S] [-q <QUEUE_SIZE>] [-l <FRAME_LENGTH>] [-c <CYCLE_TIME>]\n"
+           "          [-a <FRAMES_PER_CYCLE>] [-r <HOST_LATENCY>] [-n <FRAMES>]\n"
+           "-S : Sweep queue depths of 1 to %d full frames\n"
+           "-q : Size of the VETH Tx queue in bytes (default %d)\n"
+           "-l : Frame length in bytes (default %d)\n"
+           "-c : Cycle time in us (default %d)\n"
+           "-a : VETH frames sent per cycle (default %d)\n"
+           "-r : Latency of the host to refill the queue in us (default %d)\n"
+           "-n : Number of frames to transfer (default %d)\n",
+           pszName_p, SWEEP_MAX_FRAME_COUNT, DEFAULT_FRAME_COUNT * QUEUE_FRAME_SIZE,
+           DEFAULT_FRAME_LENGTH, DEFAULT_CYCLE_TIME, DEFAULT_SLOT_COUNT,
+           DEFAULT_HOST_LATENCY, DEFAULT_TRANSFER_FRAMES);
+}
+
+/// \}